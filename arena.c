@@ -0,0 +1,399 @@
+// Arena: many snakes and many pieces of food on one board, everyone
+// moves at the same time.
+//
+// A tick resolves like this:
+//
+//   1. Every snake picks its direction from Inputs, with the same
+//      opposite direction guard as a game.
+//   2. Tails that aren't growing leave the board, a head may move into a
+//      cell a tail leaves on the same tick.
+//   3. Heads claim their new cells in the Claimed bitmap, a second claim
+//      on a cell marks it in Contested.
+//   4. A snake dies if its new cell is a wall or a body (Occupied), is
+//      contested (head-on), or if it and another snake trade cells
+//      (swap). Swaps are found through HeadOwner, the snake whose head
+//      was on a cell when the tick started.
+//   5. Dead snakes leave the board and survivors move in, eating any
+//      food they land on.
+//
+// All collisions are bit tests on the board, nothing is checked pair by
+// pair, so a tick costs the same per snake whatever the crowd. Dead
+// snakes come back as a single piece on a random free cell.
+//
+// ArenaInit leaves the board empty, ArenaPopulate (which every tick ends
+// with) brings in the snakes and the food. A board that only mirrors
+// another one, like a network client's, never calls it.
+
+#include <string.h>
+
+typedef struct {
+    uint32_t* Body; // Ring buffer, Body[BodyHead] is the head
+    int BodyCapacity;
+    int BodyHead;
+    int BodyLength;
+    int Growing;
+    int Direction;
+    int Alive;
+    uint32_t NewHead;
+    int Dies; // This tick
+} arenaSnake;
+
+typedef struct {
+    int XTiles;
+    int YTiles;
+    int Stride;
+    int Cells;
+    int Steps[KEYSAMOUNT];
+
+    // Bitmaps over the padded board, like game. Claimed and Contested are
+    // only set during a tick.
+
+    uint64_t* Occupied;
+    uint64_t* Food;
+    uint64_t* Claimed;
+    uint64_t* Contested;
+    int32_t* HeadOwner; // -1 when no head starts the tick there
+
+    int SnakeCount;
+    arenaSnake* Snakes;
+    int8_t* Inputs; // Set by the caller, a direction or -1
+
+    int FoodTarget;
+    int FoodCount;
+    uint32_t* Placed; // Food cells placed by the last ArenaPopulate
+    int PlacedCount;
+    rng Rng;
+    uint64_t Tick;
+
+    // Counters
+
+    uint64_t Moves;
+    uint64_t Eaten;
+    uint64_t HitBody;
+    uint64_t HeadOn;
+    uint64_t Swaps;
+} arena;
+
+int ArenaTest(uint64_t* Bits, uint32_t Cell) {
+    return (Bits[Cell >> 6] >> (Cell & 63)) & 1;
+}
+
+void ArenaSet(uint64_t* Bits, uint32_t Cell) {
+    Bits[Cell >> 6] |= 1ull << (Cell & 63);
+}
+
+void ArenaClear(uint64_t* Bits, uint32_t Cell) {
+    Bits[Cell >> 6] &= ~(1ull << (Cell & 63));
+}
+
+uint32_t ArenaRandomCell(arena* Arena) {
+    int X = (int)RngBelow(&Arena->Rng, Arena->XTiles);
+    int Y = (int)RngBelow(&Arena->Rng, Arena->YTiles);
+    return (uint32_t)((Y + 1) * Arena->Stride + X + 1);
+}
+
+// A cell with neither snake nor food, NO_CELL if a few tries didn't find
+// one so a crowded board can't stall the tick
+
+#define ARENA_PLACE_TRIES 64
+
+uint32_t ArenaFreeCell(arena* Arena) {
+    for(int Try = 0; Try < ARENA_PLACE_TRIES; ++Try) {
+        uint32_t Cell = ArenaRandomCell(Arena);
+        if(!ArenaTest(Arena->Occupied, Cell) && !ArenaTest(Arena->Food, Cell)) return Cell;
+    }
+    return NO_CELL;
+}
+
+void ArenaPlaceFood(arena* Arena) {
+    while(Arena->FoodCount < Arena->FoodTarget) {
+        uint32_t Cell = ArenaFreeCell(Arena);
+        if(Cell == NO_CELL) break;
+        ArenaSet(Arena->Food, Cell);
+        ++Arena->FoodCount;
+        Arena->Placed[Arena->PlacedCount++] = Cell;
+    }
+}
+
+// Snake bodies
+
+uint32_t ArenaGetPieceCell(arenaSnake* Snake, int Index) {
+    return Snake->Body[(Snake->BodyHead + Index) & (Snake->BodyCapacity - 1)];
+}
+
+void ArenaPushHead(arenaSnake* Snake, uint32_t Cell) {
+    if(Snake->BodyLength == Snake->BodyCapacity) {
+        int Capacity = Snake->BodyCapacity * 2;
+        uint32_t* Body = malloc(Capacity * sizeof(uint32_t));
+        assert(Body);
+        for(int Index = 0; Index < Snake->BodyLength; ++Index) {
+            Body[Index] = ArenaGetPieceCell(Snake, Index);
+        }
+        free(Snake->Body);
+        Snake->Body = Body;
+        Snake->BodyCapacity = Capacity;
+        Snake->BodyHead = 0;
+    }
+    Snake->BodyHead = (Snake->BodyHead - 1) & (Snake->BodyCapacity - 1);
+    Snake->Body[Snake->BodyHead] = Cell;
+    ++Snake->BodyLength;
+}
+
+void ArenaSpawn(arena* Arena, arenaSnake* Snake) {
+    uint32_t Cell = ArenaFreeCell(Arena);
+    if(Cell == NO_CELL) return;
+
+    Snake->BodyLength = 0;
+    Snake->Growing = 0;
+    Snake->Direction = (int)RngBelow(&Arena->Rng, KEYSAMOUNT);
+    Snake->Alive = 1;
+    ArenaPushHead(Snake, Cell);
+    ArenaSet(Arena->Occupied, Cell);
+}
+
+void ArenaKill(arena* Arena, arenaSnake* Snake) {
+    for(int Index = 0; Index < Snake->BodyLength; ++Index) {
+        ArenaClear(Arena->Occupied, ArenaGetPieceCell(Snake, Index));
+    }
+    Snake->BodyLength = 0;
+    Snake->Alive = 0;
+}
+
+void ArenaInit(arena* Arena, int XTiles, int YTiles, int SnakeCount, int FoodTarget, uint64_t Seed) {
+    assert(XTiles > 0 && XTiles <= MAX_TILES);
+    assert(YTiles > 0 && YTiles <= MAX_TILES);
+
+    int Stride = XTiles + 2;
+    int Cells = Stride * (YTiles + 2);
+    int Words = (Cells + 63) / 64;
+
+    *Arena = (arena){
+        .XTiles = XTiles,
+        .YTiles = YTiles,
+        .Stride = Stride,
+        .Cells = Cells,
+        .Steps = {
+            [UP] = Stride,
+            [LEFT] = -1,
+            [DOWN] = -Stride,
+            [RIGHT] = 1,
+        },
+        .SnakeCount = SnakeCount,
+        .FoodTarget = FoodTarget,
+    };
+
+    Arena->Occupied = calloc(Words, sizeof(uint64_t));
+    Arena->Food = calloc(Words, sizeof(uint64_t));
+    Arena->Claimed = calloc(Words, sizeof(uint64_t));
+    Arena->Contested = calloc(Words, sizeof(uint64_t));
+    Arena->HeadOwner = malloc(Cells * sizeof(int32_t));
+    Arena->Snakes = calloc(SnakeCount, sizeof(arenaSnake));
+    Arena->Inputs = calloc(SnakeCount, sizeof(int8_t));
+    Arena->Placed = malloc((FoodTarget + 1) * sizeof(uint32_t));
+    assert(Arena->Occupied && Arena->Food && Arena->Claimed && Arena->Contested &&
+           Arena->HeadOwner && Arena->Snakes && Arena->Inputs && Arena->Placed);
+
+    memset(Arena->HeadOwner, 0xff, Cells * sizeof(int32_t));
+
+    for(int X = 0; X < XTiles + 2; ++X) {
+        ArenaSet(Arena->Occupied, X);
+        ArenaSet(Arena->Occupied, (YTiles + 1) * Stride + X);
+    }
+    for(int Y = 0; Y < YTiles + 2; ++Y) {
+        ArenaSet(Arena->Occupied, Y * Stride);
+        ArenaSet(Arena->Occupied, Y * Stride + XTiles + 1);
+    }
+
+    RngInit(&Arena->Rng, Seed, STREAM_FOOD);
+
+    for(int Index = 0; Index < SnakeCount; ++Index) {
+        arenaSnake* Snake = &Arena->Snakes[Index];
+        Snake->BodyCapacity = 4;
+        Snake->Body = malloc(Snake->BodyCapacity * sizeof(uint32_t));
+        assert(Snake->Body);
+        Arena->Inputs[Index] = -1;
+    }
+}
+
+// Brings back dead snakes and tops up the food
+
+void ArenaPopulate(arena* Arena) {
+    for(int Index = 0; Index < Arena->SnakeCount; ++Index) {
+        if(!Arena->Snakes[Index].Alive) ArenaSpawn(Arena, &Arena->Snakes[Index]);
+    }
+
+    Arena->PlacedCount = 0;
+    ArenaPlaceFood(Arena);
+}
+
+void ArenaFree(arena* Arena) {
+    for(int Index = 0; Index < Arena->SnakeCount; ++Index) {
+        free(Arena->Snakes[Index].Body);
+    }
+    free(Arena->Occupied);
+    free(Arena->Food);
+    free(Arena->Claimed);
+    free(Arena->Contested);
+    free(Arena->HeadOwner);
+    free(Arena->Snakes);
+    free(Arena->Inputs);
+    free(Arena->Placed);
+    *Arena = (arena){0};
+}
+
+void ArenaUpdate(arena* Arena) {
+    ++Arena->Tick;
+
+    int Count = Arena->SnakeCount;
+    arenaSnake* Snakes = Arena->Snakes;
+
+    // Directions, new heads, tails
+
+    for(int Index = 0; Index < Count; ++Index) {
+        arenaSnake* Snake = &Snakes[Index];
+        if(!Snake->Alive) continue;
+
+        int Direction = Arena->Inputs[Index];
+        if(Direction >= 0 && Direction < KEYSAMOUNT) {
+            if(Snake->BodyLength + Snake->Growing == 1 || !IsOppositeDirection(Snake->Direction, Direction)) {
+                Snake->Direction = Direction;
+            }
+        }
+
+        uint32_t Head = ArenaGetPieceCell(Snake, 0);
+        Snake->NewHead = Head + Arena->Steps[Snake->Direction];
+        Snake->Dies = 0;
+        Arena->HeadOwner[Head] = Index;
+
+        if(Snake->Growing) {
+            --Snake->Growing;
+        } else {
+            ArenaClear(Arena->Occupied, ArenaGetPieceCell(Snake, Snake->BodyLength - 1));
+            --Snake->BodyLength;
+        }
+    }
+
+    // Claims
+
+    for(int Index = 0; Index < Count; ++Index) {
+        arenaSnake* Snake = &Snakes[Index];
+        if(!Snake->Alive) continue;
+
+        if(ArenaTest(Arena->Claimed, Snake->NewHead)) {
+            ArenaSet(Arena->Contested, Snake->NewHead);
+        } else {
+            ArenaSet(Arena->Claimed, Snake->NewHead);
+        }
+    }
+
+    // Collisions, all decided before anything moves
+
+    for(int Index = 0; Index < Count; ++Index) {
+        arenaSnake* Snake = &Snakes[Index];
+        if(!Snake->Alive) continue;
+
+        uint32_t NewHead = Snake->NewHead;
+
+        if(ArenaTest(Arena->Occupied, NewHead)) {
+            Snake->Dies = 1;
+            ++Arena->HitBody;
+        } else if(ArenaTest(Arena->Contested, NewHead)) {
+            Snake->Dies = 1;
+            ++Arena->HeadOn;
+        } else {
+            int32_t Other = Arena->HeadOwner[NewHead];
+            if(Other >= 0 && Other != Index &&
+               Snakes[Other].NewHead == ArenaGetPieceCell(Snake, 0)) {
+                Snake->Dies = 1;
+                ++Arena->Swaps;
+            }
+        }
+    }
+
+    // Move
+
+    for(int Index = 0; Index < Count; ++Index) {
+        arenaSnake* Snake = &Snakes[Index];
+        if(!Snake->Alive) continue;
+
+        uint32_t NewHead = Snake->NewHead;
+        Arena->HeadOwner[ArenaGetPieceCell(Snake, 0)] = -1;
+        ArenaClear(Arena->Claimed, NewHead);
+        ArenaClear(Arena->Contested, NewHead);
+
+        if(Snake->Dies) {
+            ArenaKill(Arena, Snake);
+            continue;
+        }
+
+        ArenaPushHead(Snake, NewHead);
+        ArenaSet(Arena->Occupied, NewHead);
+        ++Arena->Moves;
+
+        if(ArenaTest(Arena->Food, NewHead)) {
+            ArenaClear(Arena->Food, NewHead);
+            --Arena->FoodCount;
+            ++Snake->Growing;
+            ++Arena->Eaten;
+        }
+    }
+
+    ArenaPopulate(Arena);
+}
+
+// Hash of the board and every live snake, for checking that two arenas
+// agree. Dead snakes only count as dead.
+
+uint64_t ArenaHash(arena* Arena) {
+    int Words = (Arena->Cells + 63) / 64;
+    uint64_t Hash = 0xcbf29ce484222325ull;
+    Hash = HashBytes(Hash, &Arena->Tick, sizeof(Arena->Tick));
+    Hash = HashBytes(Hash, Arena->Occupied, Words * sizeof(uint64_t));
+    Hash = HashBytes(Hash, Arena->Food, Words * sizeof(uint64_t));
+
+    for(int Index = 0; Index < Arena->SnakeCount; ++Index) {
+        arenaSnake* Snake = &Arena->Snakes[Index];
+        Hash = HashBytes(Hash, &Snake->Alive, sizeof(Snake->Alive));
+        if(!Snake->Alive) continue;
+
+        Hash = HashBytes(Hash, &Snake->Direction, sizeof(Snake->Direction));
+        Hash = HashBytes(Hash, &Snake->Growing, sizeof(Snake->Growing));
+        Hash = HashBytes(Hash, &Snake->BodyLength, sizeof(Snake->BodyLength));
+        for(int Piece = 0; Piece < Snake->BodyLength; ++Piece) {
+            uint32_t Cell = ArenaGetPieceCell(Snake, Piece);
+            Hash = HashBytes(Hash, &Cell, sizeof(Cell));
+        }
+    }
+    return Hash;
+}
+
+// Wanders, turns towards food next to the head and away from anything
+// that blocks. It can't see where the others are going.
+
+int ArenaBotDirection(arena* Arena, int Index, rng* Rng) {
+    arenaSnake* Snake = &Arena->Snakes[Index];
+    if(!Snake->Alive) return -1;
+
+    uint32_t Head = ArenaGetPieceCell(Snake, 0);
+    int Turn = RngBelow(Rng, 8) == 0;
+    int Best = -1;
+    int BestScore = 0;
+
+    for(int Direction = 0; Direction < KEYSAMOUNT; ++Direction) {
+        if(Snake->BodyLength + Snake->Growing > 1 && IsOppositeDirection(Snake->Direction, Direction)) continue;
+
+        uint32_t Cell = Head + Arena->Steps[Direction];
+        if(ArenaTest(Arena->Occupied, Cell)) continue;
+
+        int Score = 1 + (int)RngBelow(Rng, 4);
+        if(Direction == Snake->Direction && !Turn) Score += 4;
+        if(ArenaTest(Arena->Food, Cell)) Score += 8;
+
+        if(Score > BestScore) {
+            Best = Direction;
+            BestScore = Score;
+        }
+    }
+
+    return Best;
+}
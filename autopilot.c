@@ -0,0 +1,250 @@
+// Autopilot: a bot that goes for length on boards of any size. Like the
+// ones in bots.c it returns a direction for InputQueueAdd or -1.
+//
+// It follows a distance field that counts steps to the food around the
+// snake's body. The field is built once per food. After that the only
+// change made to it is the tail freeing a cell, which can only shorten
+// distances, so that cell is relaxed into the field and nothing is
+// recomputed. The head blocking cells can make the field too
+// optimistic. When no neighbor of the head is closer than the head was,
+// the field is rebuilt, at most once every AUTOPILOT_REBUILD_TICKS.
+//
+// Before committing to a move the autopilot flood fills from the cell it
+// would move to. The move is safe if the fill reaches the tail, or finds
+// room for the whole snake, or visits Budget cells. If no move is safe,
+// it takes the one with the most room.
+//
+// Budget also caps how far one relaxation spreads, a cut short one only
+// leaves some distances longer than they could be. It is counted in
+// cells rather than time so runs stay reproducible.
+
+#include <string.h>
+
+#define AUTOPILOT_FAR UINT32_MAX
+#define AUTOPILOT_REBUILD_TICKS 64
+
+typedef struct {
+    int Cells;
+    uint32_t* Distance; // Steps to FieldFood, AUTOPILOT_FAR if unreachable
+    uint32_t* Queue;
+    uint32_t* Visited; // Flood fills mark cells with VisitMark
+    uint32_t VisitMark;
+
+    int Valid;
+    uint32_t FieldFood;
+    uint64_t LastTick;
+    uint64_t BuiltTick;
+    int Budget;
+
+    // Counters
+
+    uint64_t Decisions;
+    uint64_t Rebuilds;
+    uint64_t Relaxed;
+    uint64_t Flooded;
+    uint64_t Cornered; // No safe move was found
+} autopilot;
+
+void AutopilotInit(autopilot* Autopilot, game* Game, int Budget) {
+    int Cells = Game->Stride * (Game->YTiles + 2);
+
+    *Autopilot = (autopilot){
+        .Cells = Cells,
+        .Budget = Budget,
+    };
+
+    Autopilot->Distance = malloc(Cells * sizeof(uint32_t));
+    Autopilot->Queue = malloc(Cells * sizeof(uint32_t));
+    Autopilot->Visited = calloc(Cells, sizeof(uint32_t));
+    assert(Autopilot->Distance && Autopilot->Queue && Autopilot->Visited);
+}
+
+void AutopilotFree(autopilot* Autopilot) {
+    free(Autopilot->Distance);
+    free(Autopilot->Queue);
+    free(Autopilot->Visited);
+    *Autopilot = (autopilot){0};
+}
+
+// Breadth first from the food over free cells
+
+void AutopilotBuildField(autopilot* Autopilot, game* Game) {
+    uint32_t* Distance = Autopilot->Distance;
+    uint32_t* Queue = Autopilot->Queue;
+
+    memset(Distance, 0xff, Autopilot->Cells * sizeof(uint32_t));
+    Autopilot->FieldFood = Game->Food;
+    Autopilot->BuiltTick = Game->Tick;
+    Autopilot->Valid = 1;
+    ++Autopilot->Rebuilds;
+
+    if(Game->Food == NO_FOOD) return;
+
+    int Read = 0;
+    int Write = 0;
+    Distance[Game->Food] = 0;
+    Queue[Write++] = Game->Food;
+
+    while(Read < Write) {
+        uint32_t Cell = Queue[Read++];
+        uint32_t Next = Distance[Cell] + 1;
+        for(int Direction = 0; Direction < KEYSAMOUNT; ++Direction) {
+            uint32_t Neighbor = Cell + Game->Steps[Direction];
+            if(Distance[Neighbor] != AUTOPILOT_FAR || IsCellBlocked(Game, Neighbor)) continue;
+            Distance[Neighbor] = Next;
+            Queue[Write++] = Neighbor;
+        }
+    }
+}
+
+// A cell became free, pull it into the field and spread whatever got
+// shorter. Visiting in queue order settles every cell the first time its
+// distance drops.
+
+void AutopilotRelax(autopilot* Autopilot, game* Game, uint32_t Freed) {
+    uint32_t* Distance = Autopilot->Distance;
+    uint32_t* Queue = Autopilot->Queue;
+
+    if(IsCellBlocked(Game, Freed)) return;
+
+    uint32_t Best = Distance[Freed];
+    for(int Direction = 0; Direction < KEYSAMOUNT; ++Direction) {
+        uint32_t Neighbor = Freed + Game->Steps[Direction];
+        if(IsCellBlocked(Game, Neighbor) || Distance[Neighbor] == AUTOPILOT_FAR) continue;
+        if(Distance[Neighbor] + 1 < Best) Best = Distance[Neighbor] + 1;
+    }
+    if(Best >= Distance[Freed]) return;
+
+    int Read = 0;
+    int Write = 0;
+    Distance[Freed] = Best;
+    Queue[Write++] = Freed;
+
+    while(Read < Write && Write < Autopilot->Budget) {
+        uint32_t Cell = Queue[Read++];
+        uint32_t Next = Distance[Cell] + 1;
+        for(int Direction = 0; Direction < KEYSAMOUNT; ++Direction) {
+            uint32_t Neighbor = Cell + Game->Steps[Direction];
+            if(Distance[Neighbor] <= Next || IsCellBlocked(Game, Neighbor)) continue;
+            Distance[Neighbor] = Next;
+            Queue[Write++] = Neighbor;
+        }
+    }
+
+    Autopilot->Relaxed += Write;
+}
+
+// Free cells reachable from Start, counting stops at Enough. Reaching
+// the tail counts as Enough since it keeps moving out of the way.
+
+int AutopilotFlood(autopilot* Autopilot, game* Game, uint32_t Start, uint32_t Tail, int Enough) {
+    uint32_t* Visited = Autopilot->Visited;
+    uint32_t* Queue = Autopilot->Queue;
+
+    if(Start == Tail) return Enough;
+
+    if(++Autopilot->VisitMark == 0) {
+        memset(Visited, 0, Autopilot->Cells * sizeof(uint32_t));
+        Autopilot->VisitMark = 1;
+    }
+    uint32_t Mark = Autopilot->VisitMark;
+
+    int Read = 0;
+    int Write = 0;
+    Visited[Start] = Mark;
+    Queue[Write++] = Start;
+
+    while(Read < Write && Write < Enough) {
+        uint32_t Cell = Queue[Read++];
+        for(int Direction = 0; Direction < KEYSAMOUNT; ++Direction) {
+            uint32_t Neighbor = Cell + Game->Steps[Direction];
+            if(Neighbor == Tail) {
+                Autopilot->Flooded += Write;
+                return Enough;
+            }
+            if(Visited[Neighbor] == Mark || IsCellBlocked(Game, Neighbor)) continue;
+            Visited[Neighbor] = Mark;
+            Queue[Write++] = Neighbor;
+        }
+    }
+
+    Autopilot->Flooded += Write;
+    return Write < Enough ? Write : Enough;
+}
+
+// Call once per tick before GameUpdate
+
+int AutopilotDirection(autopilot* Autopilot, game* Game) {
+    ++Autopilot->Decisions;
+
+    if(!Autopilot->Valid || Game->Food != Autopilot->FieldFood ||
+       Game->Tick != Autopilot->LastTick + 1) {
+        AutopilotBuildField(Autopilot, Game);
+    } else if(Game->Vacated != NO_CELL) {
+        AutopilotRelax(Autopilot, Game, Game->Vacated);
+    }
+    Autopilot->LastTick = Game->Tick;
+
+    uint32_t Head = GetPieceCell(Game, 0);
+    uint32_t Tail = GetPieceCell(Game, Game->BodyLength - 1);
+    int TailMoves = !Game->Growing;
+
+    int Enough = Game->BodyLength + 1;
+    if(Enough > Autopilot->Budget) Enough = Autopilot->Budget;
+
+    for(int Attempt = 0; Attempt < 2; ++Attempt) {
+
+        // Moves the head can make, closest to the food first
+
+        int Moves[KEYSAMOUNT];
+        uint32_t Distances[KEYSAMOUNT];
+        int MoveCount = 0;
+
+        for(int Direction = 0; Direction < KEYSAMOUNT; ++Direction) {
+            if(Game->TailLength > 0 && IsOppositeDirection(Game->Direction, Direction)) continue;
+
+            uint32_t Cell = Head + Game->Steps[Direction];
+            if(IsCellBlocked(Game, Cell) && !(Cell == Tail && TailMoves)) continue;
+
+            int Index = MoveCount++;
+            while(Index > 0 && Distances[Index - 1] > Autopilot->Distance[Cell]) {
+                Moves[Index] = Moves[Index - 1];
+                Distances[Index] = Distances[Index - 1];
+                --Index;
+            }
+            Moves[Index] = Direction;
+            Distances[Index] = Autopilot->Distance[Cell];
+        }
+
+        if(MoveCount == 0) return -1;
+
+        // Nothing leads downhill, the body has cut the field off somewhere
+
+        int Stalled = Distances[0] == AUTOPILOT_FAR ||
+                      (Autopilot->Distance[Head] != AUTOPILOT_FAR && Distances[0] >= Autopilot->Distance[Head]);
+        if(Attempt == 0 && Stalled && Game->Food != NO_FOOD &&
+           Game->Tick >= Autopilot->BuiltTick + AUTOPILOT_REBUILD_TICKS) {
+            AutopilotBuildField(Autopilot, Game);
+            continue;
+        }
+
+        int Best = -1;
+        int BestRoom = -1;
+
+        for(int Index = 0; Index < MoveCount; ++Index) {
+            uint32_t Cell = Head + Game->Steps[Moves[Index]];
+
+            int Room = AutopilotFlood(Autopilot, Game, Cell, Tail, Enough);
+            if(Room >= Enough) return Moves[Index];
+            if(Room > BestRoom) {
+                Best = Moves[Index];
+                BestRoom = Room;
+            }
+        }
+
+        ++Autopilot->Cornered;
+        return Best;
+    }
+
+    return -1;
+}
@@ -0,0 +1,144 @@
+// Batch of independent games stepped in parallel on a pool. Finished
+// games are counted and replaced with a fresh game in the same slot.
+//
+// Every slot draws its seeds and policy randomness from its own streams,
+// so the outcome doesn't depend on the number of threads or how the
+// slots got scheduled.
+
+typedef int batchPolicy(game* Game, rng* Rng);
+
+int GreedyPolicy(game* Game, rng* Rng) {
+    return GreedyDirection(Game);
+}
+
+int RandomPolicy(game* Game, rng* Rng) {
+    return RandomDirection(Rng);
+}
+
+// Slots are written by one worker at a time, keep them off each other's
+// cache lines
+
+typedef struct {
+    _Alignas(64) game Game;
+    rng Seeds;
+    rng Policy;
+
+    uint64_t Ticks;
+    uint64_t Finished;
+    uint64_t ScoreSum;
+    int MaxLength;
+} batchSlot;
+
+typedef struct {
+    int Count;
+    int XTiles;
+    int YTiles;
+    batchSlot* Slots;
+    batchPolicy* Policy;
+    pool* Pool;
+
+    int StepTicks; // For the current BatchStep
+} batch;
+
+typedef struct {
+    uint64_t Ticks;
+    uint64_t Finished;
+    uint64_t ScoreSum;
+    int MaxLength;
+    uint64_t Hash; // Of all games as they are now, order independent
+} batchStats;
+
+enum {
+    STREAM_BATCH_SEEDS,
+    STREAM_BATCH_POLICY,
+};
+
+void BatchInit(batch* Batch, pool* Pool, int Count, int XTiles, int YTiles,
+               uint64_t Seed, batchPolicy* Policy) {
+    *Batch = (batch){
+        .Count = Count,
+        .XTiles = XTiles,
+        .YTiles = YTiles,
+        .Policy = Policy,
+        .Pool = Pool,
+    };
+
+    Batch->Slots = aligned_alloc(64, sizeof(batchSlot) * Count);
+    assert(Batch->Slots);
+
+    for(int Index = 0; Index < Count; ++Index) {
+        batchSlot* Slot = &Batch->Slots[Index];
+        *Slot = (batchSlot){0};
+
+        rng Streams;
+        RngInit(&Streams, Seed, Index);
+        RngInit(&Slot->Seeds, RngNext(&Streams), STREAM_BATCH_SEEDS);
+        RngInit(&Slot->Policy, RngNext(&Streams), STREAM_BATCH_POLICY);
+
+        GameInit(&Slot->Game, XTiles, YTiles, RngNext(&Slot->Seeds));
+    }
+}
+
+void BatchFree(batch* Batch) {
+    for(int Index = 0; Index < Batch->Count; ++Index) {
+        GameFree(&Batch->Slots[Index].Game);
+    }
+    free(Batch->Slots);
+    Batch->Slots = 0;
+}
+
+void BatchSlotFinish(batch* Batch, batchSlot* Slot) {
+    game* Game = &Slot->Game;
+    int Length = Game->TailLength + 1;
+
+    ++Slot->Finished;
+    Slot->ScoreSum += Game->TailLength;
+    if(Length > Slot->MaxLength) Slot->MaxLength = Length;
+
+    GameReset(Game, RngNext(&Slot->Seeds));
+}
+
+void BatchStepTask(void* Context, int Begin, int End, int Worker) {
+    batch* Batch = Context;
+
+    for(int Index = Begin; Index < End; ++Index) {
+        batchSlot* Slot = &Batch->Slots[Index];
+        game* Game = &Slot->Game;
+
+        for(int Tick = 0; Tick < Batch->StepTicks; ++Tick) {
+            int Direction = Batch->Policy(Game, &Slot->Policy);
+            if(Direction >= 0) InputQueueAdd(&Game->InputQueue, Direction);
+
+            GameUpdate(Game);
+            ++Slot->Ticks;
+
+            if(!Game->Running) BatchSlotFinish(Batch, Slot);
+        }
+    }
+}
+
+// Advances every game by Ticks ticks
+
+void BatchStep(batch* Batch, int Ticks) {
+    Batch->StepTicks = Ticks;
+
+    // A few chunks per worker so stealing has something to take
+
+    int Chunk = Batch->Count / (Batch->Pool->WorkerCount * 8);
+    if(Chunk < 1) Chunk = 1;
+
+    PoolRun(Batch->Pool, BatchStepTask, Batch, Batch->Count, Chunk);
+}
+
+batchStats BatchGetStats(batch* Batch) {
+    batchStats Stats = {0};
+    for(int Index = 0; Index < Batch->Count; ++Index) {
+        batchSlot* Slot = &Batch->Slots[Index];
+        Stats.Ticks += Slot->Ticks;
+        Stats.Finished += Slot->Finished;
+        Stats.ScoreSum += Slot->ScoreSum;
+        if(Slot->MaxLength > Stats.MaxLength) Stats.MaxLength = Slot->MaxLength;
+        Stats.Hash ^= GameHash(&Slot->Game) * (2 * (uint64_t)Index + 1);
+    }
+    return Stats;
+}
@@ -0,0 +1,431 @@
+// Microbenchmarks of the simulation and draw list hot paths, for
+// catching regressions. Build with build.sh.
+//
+//   bench [case|all] [boards] [lengths] [repetitions] [warm-up] [text|csv]
+//
+// Boards and lengths are comma separated, a board is N for NxN or WxH:
+//
+//   bench tick 20,256,4096 1,1000,100000 50 5 csv
+//
+// Every case runs for every board and snake length that fits on it,
+// except the ones that don't care about one or both. A repetition runs
+// the case's operation a batch of times and counts nanoseconds per
+// operation; the warm-up repetitions pick the batch, doubling it until a
+// repetition takes BENCH_MIN_NANOS, and are thrown away. The rest are
+// reported as min, percentiles and max. csv prints one line per case,
+// board and length with a header, for feeding into something that
+// compares runs.
+//
+// Cases, a snake of the given length follows a Hamiltonian tour so it
+// never dies:
+//
+//   tick         GameUpdate, with the steering input
+//   collision    IsCellBlocked on body and free cells, the self-collision test
+//   food         GetRandomFreeCell, past half the board the dense free list
+//   grow         a tick that grows the snake by one
+//   input        an event through the input ring and into InputQueue
+//   build        DrawListBuild right after a tick
+//   frame        DrawListBuild between ticks, moving the head and tail
+//   floor        building the floor instances for a new board
+//   zone         one trace zone, which is nothing unless built with
+//                -DSNAKE_TRACE
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "snake.c"
+#include "hamilton.c"
+#include "input.c"
+#include "drawlist.c"
+#include "trace.c"
+
+#define BENCH_MIN_NANOS 200000
+#define BENCH_MAX_BATCH (1 << 24)
+#define BENCH_PROBES 4096 // Cells the collision case tests, a power of two
+#define BENCH_MAX_CONFIGS 32
+
+uint64_t GetNanoseconds() {
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return (uint64_t)Time.tv_sec * 1000000000ull + (uint64_t)Time.tv_nsec;
+}
+
+// State of the case being run
+
+typedef struct {
+    int XTiles;
+    int YTiles;
+    int Length;
+
+    game Game;
+    hamilton Hamilton;
+    uint8_t* Steer; // Direction to the next tile on the tour, by cell
+
+    uint32_t Probes[BENCH_PROBES];
+    inputRing Ring;
+    inputMetrics Metrics;
+    drawList List;
+    uint64_t Frame;
+} bench;
+
+volatile uint64_t Sink; // Results go here so the work can't be left out
+
+typedef void benchFunction(bench* Bench, int Count);
+
+enum {
+    BENCH_BOARD = 1, // Depends on the board size
+    BENCH_LENGTH = 2, // and on the snake's length
+};
+
+typedef struct {
+    char* Name;
+    int Flags;
+    benchFunction* Setup; // Count unused
+    benchFunction* Run;
+    benchFunction* Reset; // Before every repetition, not timed, 0 for none
+} benchCase;
+
+// Game on the tour with a snake of Bench->Length
+
+void SetupGame(bench* Bench, int Count) {
+    (void)Count;
+    GameInit(&Bench->Game, Bench->XTiles, Bench->YTiles, 1);
+
+    if(!Bench->Steer) {
+        HamiltonInit(&Bench->Hamilton, &Bench->Game);
+        int Cells = Bench->Game.Stride * (Bench->YTiles + 2);
+        Bench->Steer = malloc((size_t)Cells);
+        assert(Bench->Steer);
+        uint32_t* Order = Bench->Hamilton.Order;
+        for(int Cell = 0; Cell < Cells; ++Cell) {
+            if(Order[Cell] == HAMILTON_OFF) continue;
+            uint32_t Next = (Order[Cell] + 1) % (uint32_t)Bench->Hamilton.Length;
+            for(int Direction = 0; Direction < KEYSAMOUNT; ++Direction) {
+                if(Order[Cell + Bench->Game.Steps[Direction]] == Next) Bench->Steer[Cell] = (uint8_t)Direction;
+            }
+        }
+    }
+
+    // The head starts in the middle and the tour may go back the way it
+    // came, which only a one piece snake can do
+
+    InputQueueAdd(&Bench->Game.InputQueue, Bench->Steer[GetPieceCell(&Bench->Game, 0)]);
+    GameUpdate(&Bench->Game);
+    for(int Piece = 1; Piece < Bench->Length; ++Piece) GrowSnake(&Bench->Game);
+    while(Bench->Game.Growing) {
+        InputQueueAdd(&Bench->Game.InputQueue, Bench->Steer[GetPieceCell(&Bench->Game, 0)]);
+        GameUpdate(&Bench->Game);
+    }
+    assert(Bench->Game.Running);
+}
+
+void Steer(bench* Bench) {
+    int Direction = Bench->Steer[GetPieceCell(&Bench->Game, 0)];
+    if(Direction != Bench->Game.Direction) InputQueueAdd(&Bench->Game.InputQueue, Direction);
+}
+
+// Food eaten on the way makes the snake longer, start over once that
+// adds up
+
+void ResetGame(bench* Bench, int Count) {
+    (void)Count;
+    if(Bench->Game.BodyLength > Bench->Length + Bench->Length / 8 + 64 || !Bench->Game.Running) {
+        GameFree(&Bench->Game);
+        SetupGame(Bench, 0);
+    }
+}
+
+void RunTick(bench* Bench, int Count) {
+    for(int Index = 0; Index < Count; ++Index) {
+        Steer(Bench);
+        GameUpdate(&Bench->Game);
+    }
+    Sink += Bench->Game.Tick;
+}
+
+void SetupCollision(bench* Bench, int Count) {
+    SetupGame(Bench, Count);
+    rng Rng;
+    RngInit(&Rng, 2, 0);
+    for(int Index = 0; Index < BENCH_PROBES; ++Index) {
+        Bench->Probes[Index] = Index % 2 ? GetPieceCell(&Bench->Game, (int)RngBelow(&Rng, Bench->Game.BodyLength))
+                                         : GetRandomCell(&Bench->Game);
+    }
+}
+
+void RunCollision(bench* Bench, int Count) {
+    uint64_t Blocked = 0;
+    for(int Index = 0; Index < Count; ++Index) {
+        Blocked += IsCellBlocked(&Bench->Game, Bench->Probes[Index & (BENCH_PROBES - 1)]);
+    }
+    Sink += Blocked;
+}
+
+void RunFood(bench* Bench, int Count) {
+    uint64_t Cells = 0;
+    for(int Index = 0; Index < Count; ++Index) {
+        Cells += GetRandomFreeCell(&Bench->Game);
+    }
+    Sink += Cells;
+}
+
+void ResetGrow(bench* Bench, int Count) {
+    (void)Count;
+    if(Bench->Game.BodyLength > 2 * Bench->Length + 4096 || !Bench->Game.Running) {
+        GameFree(&Bench->Game);
+        SetupGame(Bench, 0);
+    }
+}
+
+void RunGrow(bench* Bench, int Count) {
+    for(int Index = 0; Index < Count; ++Index) {
+        GrowSnake(&Bench->Game);
+        Steer(Bench);
+        GameUpdate(&Bench->Game);
+    }
+    Sink += (uint64_t)Bench->Game.BodyLength;
+}
+
+// Pressed keys go around in a square, so every event gets queued
+
+void SetupInput(bench* Bench, int Count) {
+    Bench->XTiles = 20;
+    Bench->YTiles = 20;
+    SetupGame(Bench, Count);
+    InputRingInit(&Bench->Ring);
+    Bench->Metrics = (inputMetrics){0};
+}
+
+void RunInput(bench* Bench, int Count) {
+    static int Turns[KEYSAMOUNT] = {UP, LEFT, DOWN, RIGHT};
+    inputQueue* Q = &Bench->Game.InputQueue;
+    for(int Index = 0; Index < Count; ++Index) {
+        InputRingPush(&Bench->Ring, Turns[Index % KEYSAMOUNT], (uint64_t)Index);
+        if(Index % INPUT_QUEUE_SIZE == INPUT_QUEUE_SIZE - 1) {
+            InputDrain(&Bench->Ring, &Bench->Game, INPUT_COALESCE | INPUT_REJECT_OPPOSITE | INPUT_DROP_OLDEST,
+                       &Bench->Metrics);
+            while(Q->Length) Sink += (uint64_t)InputQueuePop(Q);
+        }
+    }
+}
+
+void SetupDraw(bench* Bench, int Count) {
+    SetupGame(Bench, Count);
+    Bench->List = (drawList){0};
+    DrawListBuild(&Bench->List, &Bench->Game, 0.0f, 0);
+}
+
+void RunBuild(bench* Bench, int Count) {
+    for(int Index = 0; Index < Count; ++Index) {
+        Bench->List.Built = 0;
+        Sink += (uint64_t)DrawListBuild(&Bench->List, &Bench->Game, 0.0f, 0);
+    }
+}
+
+void RunFrame(bench* Bench, int Count) {
+    for(int Index = 0; Index < Count; ++Index) {
+        float Alpha = (float)(Bench->Frame++ % 16) / 16.0f;
+        Sink += (uint64_t)DrawListBuild(&Bench->List, &Bench->Game, Alpha, 0);
+    }
+}
+
+void RunFloor(bench* Bench, int Count) {
+    for(int Index = 0; Index < Count; ++Index) {
+        BuildFloor(&Bench->List, &Bench->Game);
+    }
+    Sink += Bench->List.FloorVersion;
+}
+
+void SetupZone(bench* Bench, int Count) {
+    (void)Bench;
+    (void)Count;
+    TraceInit(GetNanoseconds());
+    TraceThread("bench");
+}
+
+void RunZone(bench* Bench, int Count) {
+    (void)Bench;
+    for(int Index = 0; Index < Count; ++Index) {
+        TRACE_START(Start);
+        TRACE_ZONE(TRACE_UPDATE, Start);
+    }
+    Sink += (uint64_t)Count;
+}
+
+benchCase Cases[] = {
+    {"tick", BENCH_BOARD | BENCH_LENGTH, SetupGame, RunTick, ResetGame},
+    {"collision", BENCH_BOARD | BENCH_LENGTH, SetupCollision, RunCollision, 0},
+    {"food", BENCH_BOARD | BENCH_LENGTH, SetupGame, RunFood, 0},
+    {"grow", BENCH_BOARD | BENCH_LENGTH, SetupGame, RunGrow, ResetGrow},
+    {"input", 0, SetupInput, RunInput, 0},
+    {"build", BENCH_BOARD | BENCH_LENGTH, SetupDraw, RunBuild, 0},
+    {"frame", BENCH_BOARD | BENCH_LENGTH, SetupDraw, RunFrame, 0},
+    {"floor", BENCH_BOARD, SetupDraw, RunFloor, 0},
+    {"zone", 0, SetupZone, RunZone, 0},
+};
+
+#define BENCH_CASES (int)(sizeof(Cases) / sizeof(Cases[0]))
+
+void BenchFree(bench* Bench) {
+    DrawListFree(&Bench->List);
+    if(Bench->Steer) HamiltonFree(&Bench->Hamilton);
+    free(Bench->Steer);
+    GameFree(&Bench->Game);
+}
+
+int CompareDouble(const void* A, const void* B) {
+    double X = *(const double*)A;
+    double Y = *(const double*)B;
+    return (X > Y) - (X < Y);
+}
+
+// Nearest rank of a sorted list
+
+double Percentile(double* Sorted, int Count, double Fraction) {
+    int Rank = (int)(Fraction * Count + 0.999999);
+    if(Rank < 1) Rank = 1;
+    if(Rank > Count) Rank = Count;
+    return Sorted[Rank - 1];
+}
+
+// Runs a case on one board and length and prints a line
+
+void RunCase(benchCase* Case, int XTiles, int YTiles, int Length, int Repetitions, int WarmUp, int Csv) {
+    bench Bench = {.XTiles = XTiles, .YTiles = YTiles, .Length = Length};
+    Case->Setup(&Bench, 0);
+
+    int Batch = 1;
+    for(int Round = 0; Round < WarmUp; ++Round) {
+        for(;;) {
+            if(Case->Reset) Case->Reset(&Bench, Batch);
+            uint64_t Start = GetNanoseconds();
+            Case->Run(&Bench, Batch);
+            uint64_t Nanos = GetNanoseconds() - Start;
+            if(Nanos >= BENCH_MIN_NANOS || Batch >= BENCH_MAX_BATCH) break;
+            Batch *= 2;
+        }
+    }
+
+    double* PerOperation = malloc((size_t)Repetitions * sizeof(double));
+    assert(PerOperation);
+    double Sum = 0.0;
+    for(int Repetition = 0; Repetition < Repetitions; ++Repetition) {
+        if(Case->Reset) Case->Reset(&Bench, Batch);
+        uint64_t Start = GetNanoseconds();
+        Case->Run(&Bench, Batch);
+        uint64_t Nanos = GetNanoseconds() - Start;
+        PerOperation[Repetition] = (double)Nanos / Batch;
+        Sum += PerOperation[Repetition];
+    }
+    qsort(PerOperation, (size_t)Repetitions, sizeof(double), CompareDouble);
+
+    double Mean = Sum / Repetitions;
+    double Min = PerOperation[0];
+    double P50 = Percentile(PerOperation, Repetitions, 0.50);
+    double P90 = Percentile(PerOperation, Repetitions, 0.90);
+    double P99 = Percentile(PerOperation, Repetitions, 0.99);
+    double Max = PerOperation[Repetitions - 1];
+
+    if(!(Case->Flags & BENCH_BOARD)) XTiles = YTiles = 0;
+    if(!(Case->Flags & BENCH_LENGTH)) Length = 0;
+
+    if(Csv) {
+        printf("%s,%d,%d,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", Case->Name, XTiles, YTiles, Length,
+               Batch, Repetitions, Mean, Min, P50, P90, P99, Max);
+    } else {
+        char Board[32] = "-";
+        if(XTiles) snprintf(Board, sizeof(Board), "%dx%d", XTiles, YTiles);
+        char Pieces[16] = "-";
+        if(Length) snprintf(Pieces, sizeof(Pieces), "%d", Length);
+        printf("%-10s %11s %8s %9d %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", Case->Name, Board, Pieces,
+               Batch, Mean, Min, P50, P90, P99, Max);
+    }
+    fflush(stdout);
+
+    free(PerOperation);
+    BenchFree(&Bench);
+}
+
+// "20,64x32" into sizes, returns how many
+
+int ParseList(char* Text, int* Widths, int* Heights) {
+    int Count = 0;
+    while(*Text && Count < BENCH_MAX_CONFIGS) {
+        char* End;
+        long Width = strtol(Text, &End, 10);
+        long Height = Width;
+        if(Heights && *End == 'x') Height = strtol(End + 1, &End, 10);
+        if(End == Text || Width < 1 || Height < 1) return 0;
+        Widths[Count] = (int)Width;
+        if(Heights) Heights[Count] = (int)Height;
+        ++Count;
+        Text = *End == ',' ? End + 1 : End;
+        if(*End && *End != ',') return 0;
+    }
+    return Count;
+}
+
+int main(int ArgumentCount, char** Arguments) {
+
+    char* Only = ArgumentCount > 1 ? Arguments[1] : "all";
+    char* Boards = ArgumentCount > 2 ? Arguments[2] : "20,64,256,1024,4096";
+    char* Lengths = ArgumentCount > 3 ? Arguments[3] : "1,16,256,4096,65536";
+    int Repetitions = ArgumentCount > 4 ? atoi(Arguments[4]) : 30;
+    int WarmUp = ArgumentCount > 5 ? atoi(Arguments[5]) : 3;
+    int Csv = ArgumentCount > 6 && !strcmp(Arguments[6], "csv");
+
+    int Widths[BENCH_MAX_CONFIGS];
+    int Heights[BENCH_MAX_CONFIGS];
+    int Pieces[BENCH_MAX_CONFIGS];
+    int BoardCount = ParseList(Boards, Widths, Heights);
+    int LengthCount = ParseList(Lengths, Pieces, 0);
+
+    int Known = !strcmp(Only, "all");
+    for(int Index = 0; Index < BENCH_CASES; ++Index) Known |= !strcmp(Only, Cases[Index].Name);
+
+    int BoardsFit = BoardCount > 0;
+    for(int Board = 0; Board < BoardCount; ++Board) {
+        BoardsFit &= Widths[Board] <= MAX_TILES && Heights[Board] <= MAX_TILES &&
+                     HamiltonSupported(Widths[Board], Heights[Board]);
+    }
+
+    if(!Known || !BoardsFit || !LengthCount || Repetitions < 1 || WarmUp < 1) {
+        fprintf(stderr, "usage: bench [case|all] [boards] [lengths] [repetitions] [warm-up] [text|csv]\n");
+        fprintf(stderr, "cases:");
+        for(int Index = 0; Index < BENCH_CASES; ++Index) fprintf(stderr, " %s", Cases[Index].Name);
+        fprintf(stderr, "\nboards need an even side and at most %d tiles a side\n", MAX_TILES);
+        return 1;
+    }
+
+    InitPalette();
+
+    if(Csv) {
+        printf("case,xtiles,ytiles,length,batch,repetitions,mean_ns,min_ns,p50_ns,p90_ns,p99_ns,max_ns\n");
+    } else {
+        printf("%-10s %11s %8s %9s %10s %10s %10s %10s %10s %10s\n", "case", "board", "length", "batch",
+               "mean ns", "min", "p50", "p90", "p99", "max");
+    }
+
+    for(int Index = 0; Index < BENCH_CASES; ++Index) {
+        benchCase* Case = &Cases[Index];
+        if(strcmp(Only, "all") && strcmp(Only, Case->Name)) continue;
+
+        int Boards = Case->Flags & BENCH_BOARD ? BoardCount : 1;
+        for(int Board = 0; Board < Boards; ++Board) {
+            int Runs = Case->Flags & BENCH_LENGTH ? LengthCount : 1;
+            for(int Run = 0; Run < Runs; ++Run) {
+
+                // A snake as long as the board has nowhere to go
+
+                int Length = Case->Flags & BENCH_LENGTH ? Pieces[Run] : 1;
+                if(Length >= Widths[Board] * Heights[Board]) continue;
+                RunCase(Case, Widths[Board], Heights[Board], Length, Repetitions, WarmUp, Csv);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,35 @@
+// Simple stand-ins for the keyboard, they return a direction to feed to
+// InputQueueAdd or -1 for no input.
+
+// Turn towards the food, avoid walls and tail
+
+int GreedyDirection(game* Game) {
+    uint32_t Head = GetPieceCell(Game, 0);
+    int FoodX = CellX(Game, Game->Food);
+    int FoodY = CellY(Game, Game->Food);
+
+    int Best = -1;
+    int BestDistance = 0;
+
+    for(int Direction = 0; Direction < KEYSAMOUNT; ++Direction) {
+        if(Game->TailLength > 0 && IsOppositeDirection(Game->Direction, Direction)) continue;
+
+        uint32_t Cell = Head + Game->Steps[Direction];
+        if(IsCellBlocked(Game, Cell)) continue;
+
+        int Distance = abs(FoodX - CellX(Game, Cell)) + abs(FoodY - CellY(Game, Cell));
+        if(Best < 0 || Distance < BestDistance) {
+            Best = Direction;
+            BestDistance = Distance;
+        }
+    }
+
+    return Best;
+}
+
+// Turn now and then, mostly keep going
+
+int RandomDirection(rng* Rng) {
+    if(RngBelow(Rng, 8) != 0) return -1;
+    return (int)RngBelow(Rng, KEYSAMOUNT);
+}
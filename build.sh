@@ -0,0 +1,7 @@
+#!/bin/sh
+cc headless.c \
+-o headless -O2 -g -std=c11 -Wall \
+-lm -pthread
+cc bench.c \
+-o bench -O2 -g -std=c11 -Wall \
+-lm
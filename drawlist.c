@@ -0,0 +1,451 @@
+// Draw list: everything a frame shows, as packed instances of a unit
+// square, built from a game and handed to a backend in one go. Instances
+// are grouped by pass and every pass is one primitive type, so a backend
+// draws each pass with one instanced draw. In drawing order:
+//
+//   DRAW_FLOOR            filled floor tiles
+//   DRAW_FLOOR_WIREFRAME  floor tiles drawn as wireframe, when it's on
+//   DRAW_FILL             filled food and snake pieces
+//   DRAW_BORDER           outlines of the snake pieces
+//   DRAW_WIREFRAME        food and snake pieces drawn as wireframe, when it's on
+//
+// Within a pass instances are in drawing order, later ones on top. Layer
+// says what an instance belongs to. The view-projection goes to the
+// backend once per frame and the palette once up front, an instance only
+// carries an index into it.
+//
+// The floor passes come from the floor layer, which only changes with
+// the board: it is built once per game and FloorVersion tells backends
+// when to take it again. Both floor passes come before anything else, so
+// a backend can keep them as one image. The rest is built once per tick,
+// frames in between only move the head and the tail slide.
+//
+// The null backend counts what the D3D11 backend in main.c does per
+// frame, DrawCountPerEntity what drawing entity by entity used to cost,
+// so the difference shows without a GPU.
+
+enum {
+    DRAW_FLOOR,
+    DRAW_FLOOR_WIREFRAME,
+    DRAW_FILL,
+    DRAW_BORDER,
+    DRAW_WIREFRAME,
+    DRAW_PASSES,
+};
+
+enum {
+    DRAW_LAYER_FLOOR,
+    DRAW_LAYER_FOOD,
+    DRAW_LAYER_SNAKE,
+};
+
+typedef struct { float X, Y, Z; } v3;
+typedef struct { float M[4][4]; } matrix;
+
+// The unit square every instance is drawn with, as a triangle list for
+// the filled passes and a line list for the borders
+
+float DrawSquareVertices[6][3] = {
+    {-0.5f, -0.5f, 0.0f},
+    {-0.5f, 0.5f, 0.0f},
+    {0.5f, 0.5f, 0.0f},
+    {-0.5f, -0.5f, 0.0f},
+    {0.5f, 0.5f, 0.0f},
+    {0.5f, -0.5f, 0.0f},
+};
+
+float DrawOutlineVertices[8][3] = {
+    {-0.5f, -0.5f, 0.0f},
+    {-0.5f, 0.5f, 0.0f},
+    {-0.5f, 0.5f, 0.0f},
+    {0.5f, 0.5f, 0.0f},
+    {0.5f, 0.5f, 0.0f},
+    {0.5f, -0.5f, 0.0f},
+    {0.5f, -0.5f, 0.0f},
+    {-0.5f, -0.5f, 0.0f},
+};
+
+// 12 bytes, the per-instance input layout in main.c follows it
+
+typedef struct {
+    float X, Y; // Tile coordinates, between tiles while sliding
+    uint16_t Palette;
+    uint16_t Layer;
+} drawInstance;
+
+typedef struct {
+    // Floor layer: the tiles, then the same tiles for the wireframe
+
+    drawInstance* Floor;
+    int FloorCapacity;
+    int FloorTiles;
+    uint64_t FloorVersion; // Goes up every time the floor is rebuilt
+    uint32_t FloorSeed;
+    int FloorXTiles;
+    int FloorYTiles;
+
+    // Everything else, every pass one after the other
+
+    drawInstance* Instances;
+    int Capacity;
+    int Total;
+
+    // What the instances were built from
+
+    int Built;
+    uint64_t Seed;
+    uint64_t Tick;
+    uint64_t DirtyCount;
+    int Wireframe;
+
+    // Floor passes index Floor, the others Instances
+
+    int First[DRAW_PASSES];
+    int Count[DRAW_PASSES];
+} drawList;
+
+int IsFloorPass(int Pass) {
+    return Pass == DRAW_FLOOR || Pass == DRAW_FLOOR_WIREFRAME;
+}
+
+drawInstance* GetPassInstances(drawList* List, int Pass) {
+    return (IsFloorPass(Pass) ? List->Floor : List->Instances) + List->First[Pass];
+}
+
+typedef void drawSubmit(void* Backend, drawList* List, matrix* ViewProjection);
+
+typedef struct {
+    void* Backend;
+    drawSubmit* Submit;
+} drawBackend;
+
+// Positions
+
+v3 CellToV3(game* Game, uint32_t Cell) {
+    return (v3){(float)CellX(Game, Cell), (float)CellY(Game, Cell), 0.0f};
+}
+
+v3 LerpV3(v3 A, v3 B, float T) {
+    return (v3){
+        A.X + (B.X - A.X) * T,
+        A.Y + (B.Y - A.Y) * T,
+        A.Z + (B.Z - A.Z) * T,
+    };
+}
+
+// Drawing lags one tick behind the simulation: at Alpha 0 the snake is
+// where it was before the last tick and it slides to where it is now as
+// Alpha goes to 1. Only the head and the tail actually move.
+
+v3 GetPieceRenderPosition(game* Game, int Index, float Alpha) {
+    v3 Position = CellToV3(Game, GetPieceCell(Game, Index));
+    if(Index == 0) {
+        uint32_t From = Game->BodyLength > 1 ? GetPieceCell(Game, 1) : Game->Vacated;
+        if(From != NO_CELL) Position = LerpV3(CellToV3(Game, From), Position, Alpha);
+    }
+    return Position;
+}
+
+int HasTailSlide(game* Game) {
+    return Game->Vacated != NO_CELL && Game->BodyLength > 1;
+}
+
+v3 GetTailSlidePosition(game* Game, float Alpha) {
+    v3 Tail = CellToV3(Game, GetPieceCell(Game, Game->BodyLength - 1));
+    return LerpV3(CellToV3(Game, Game->Vacated), Tail, Alpha);
+}
+
+// Camera
+
+matrix MatrixMultiply(matrix* A, matrix* B) {
+    matrix Result;
+    for(int Row = 0; Row < 4; ++Row) {
+        for(int Column = 0; Column < 4; ++Column) {
+            Result.M[Row][Column] = A->M[Row][0] * B->M[0][Column] + A->M[Row][1] * B->M[1][Column] +
+                                    A->M[Row][2] * B->M[2][Column] + A->M[Row][3] * B->M[3][Column];
+        }
+    }
+    return Result;
+}
+
+// Row vectors, position * ViewProjection. The camera looks at the board
+// from a distance that fits it, {8, 9, -22} for the default 20x20 board.
+// The view is 1 high a unit in front of the camera whatever the board.
+// Near and far grow with the board so it stays between them, and their
+// ratio stays the same so depth precision does too: 1 and 42 on 20x20.
+
+matrix DrawViewProjection(int XTiles, int YTiles, float AspectRatio) {
+    float Extent = (float)(XTiles > YTiles ? XTiles : YTiles);
+    v3 Camera = {XTiles * 0.4f, YTiles * 0.45f, -1.1f * Extent};
+
+    float Height = 1.0f;
+    float Near = Extent / 20.0f;
+    float Far = -Camera.Z + Extent;
+
+    matrix Projection = {{
+        {2.0f / AspectRatio, 0.0f, 0.0f, 0.0f},
+        {0.0f, 2.0f / Height, 0.0f, 0.0f},
+        {0.0f, 0.0f, Far / (Far - Near), 1.0f},
+        {0.0f, 0.0f, Near * Far / (Near - Far), 0.0f},
+    }};
+
+    matrix View = {{
+        {1.0f, 0.0f, 0.0f, 0.0f},
+        {0.0f, 1.0f, 0.0f, 0.0f},
+        {0.0f, 0.0f, 1.0f, 0.0f},
+        {-Camera.X, -Camera.Y, -Camera.Z, 1.0f},
+    }};
+
+    return MatrixMultiply(&View, &Projection);
+}
+
+// Building
+
+void DrawListFree(drawList* List) {
+    free(List->Floor);
+    free(List->Instances);
+    *List = (drawList){0};
+}
+
+void BuildFloor(drawList* List, game* Game) {
+    int Tiles = Game->XTiles * Game->YTiles;
+    if(2 * Tiles > List->FloorCapacity) {
+        free(List->Floor);
+        List->FloorCapacity = 2 * Tiles;
+        List->Floor = malloc(List->FloorCapacity * sizeof(drawInstance));
+        assert(List->Floor);
+    }
+
+    drawInstance* Fill = List->Floor;
+    drawInstance* Frame = List->Floor + Tiles;
+    for(int Y = 0; Y < Game->YTiles; ++Y) {
+        for(int X = 0; X < Game->XTiles; ++X) {
+            int Palette = GetTilePalette(Game, CellIndex(Game, X, Y));
+            *Fill++ = (drawInstance){(float)X, (float)Y, (uint16_t)Palette, DRAW_LAYER_FLOOR};
+            *Frame++ = (drawInstance){(float)X, (float)Y, PALETTE_WIREFRAME, DRAW_LAYER_FLOOR};
+        }
+    }
+
+    List->FloorTiles = Tiles;
+    List->FloorSeed = Game->FloorSeed;
+    List->FloorXTiles = Game->XTiles;
+    List->FloorYTiles = Game->YTiles;
+    ++List->FloorVersion;
+
+    List->First[DRAW_FLOOR] = 0;
+    List->Count[DRAW_FLOOR] = Tiles;
+    List->First[DRAW_FLOOR_WIREFRAME] = Tiles;
+}
+
+// Food, then the snake from the head back, with the head where the tick
+// left it. PlaceMoving puts it where it is at Alpha.
+
+void BuildTick(drawList* List, game* Game, int Wireframe) {
+    int Slide = HasTailSlide(Game);
+    int Pieces = Game->BodyLength + Slide;
+
+    List->Count[DRAW_FILL] = (Game->Food != NO_FOOD) + Pieces;
+    List->Count[DRAW_BORDER] = Pieces;
+    List->Count[DRAW_WIREFRAME] = Wireframe ? (Game->Food != NO_FOOD) + Game->BodyLength : 0;
+
+    List->First[DRAW_FILL] = 0;
+    List->First[DRAW_BORDER] = List->Count[DRAW_FILL];
+    List->First[DRAW_WIREFRAME] = List->First[DRAW_BORDER] + List->Count[DRAW_BORDER];
+    List->Total = List->First[DRAW_WIREFRAME] + List->Count[DRAW_WIREFRAME];
+
+    if(List->Total > List->Capacity) {
+        free(List->Instances);
+        List->Capacity = List->Total * 2;
+        List->Instances = malloc(List->Capacity * sizeof(drawInstance));
+        assert(List->Instances);
+    }
+
+    drawInstance* Fill = GetPassInstances(List, DRAW_FILL);
+    drawInstance* Border = GetPassInstances(List, DRAW_BORDER);
+    drawInstance* Frame = GetPassInstances(List, DRAW_WIREFRAME);
+
+    if(Game->Food != NO_FOOD) {
+        float X = (float)CellX(Game, Game->Food);
+        float Y = (float)CellY(Game, Game->Food);
+        *Fill++ = (drawInstance){X, Y, PALETTE_FOOD, DRAW_LAYER_FOOD};
+        if(Wireframe) *Frame++ = (drawInstance){X, Y, PALETTE_WIREFRAME, DRAW_LAYER_FOOD};
+    }
+
+    for(int Index = 0; Index < Game->BodyLength; ++Index) {
+        v3 Position = CellToV3(Game, GetPieceCell(Game, Index));
+        *Fill++ = (drawInstance){Position.X, Position.Y, (uint16_t)GetPiecePalette(Index), DRAW_LAYER_SNAKE};
+        *Border++ = (drawInstance){Position.X, Position.Y, PALETTE_BORDER, DRAW_LAYER_SNAKE};
+        if(Wireframe) *Frame++ = (drawInstance){Position.X, Position.Y, PALETTE_WIREFRAME, DRAW_LAYER_SNAKE};
+    }
+
+    if(Slide) {
+        *Fill++ = (drawInstance){0.0f, 0.0f, (uint16_t)GetPiecePalette(Game->BodyLength - 1), DRAW_LAYER_SNAKE};
+        *Border++ = (drawInstance){0.0f, 0.0f, PALETTE_BORDER, DRAW_LAYER_SNAKE};
+    }
+
+    List->Built = 1;
+    List->Seed = Game->Seed;
+    List->Tick = Game->Tick;
+    List->DirtyCount = Game->DirtyCount;
+    List->Wireframe = Wireframe;
+}
+
+void PlaceMoving(drawList* List, game* Game, float Alpha) {
+    drawInstance* Fill = GetPassInstances(List, DRAW_FILL);
+    drawInstance* Border = GetPassInstances(List, DRAW_BORDER);
+    drawInstance* Frame = GetPassInstances(List, DRAW_WIREFRAME);
+
+    v3 Head = GetPieceRenderPosition(Game, 0, Alpha);
+    int HeadFill = Game->Food != NO_FOOD;
+    Fill[HeadFill].X = Border[0].X = Head.X;
+    Fill[HeadFill].Y = Border[0].Y = Head.Y;
+    if(List->Count[DRAW_WIREFRAME]) {
+        Frame[HeadFill].X = Head.X;
+        Frame[HeadFill].Y = Head.Y;
+    }
+
+    if(HasTailSlide(Game)) {
+        v3 Slide = GetTailSlidePosition(Game, Alpha);
+        int Last = List->Count[DRAW_BORDER] - 1;
+        Fill[HeadFill + Last].X = Border[Last].X = Slide.X;
+        Fill[HeadFill + Last].Y = Border[Last].Y = Slide.Y;
+    }
+}
+
+// Returns 1 if the game ticked since the last build, 0 if only the head
+// and the tail slide moved
+
+int DrawListBuild(drawList* List, game* Game, float Alpha, int Wireframe) {
+    if(!List->FloorVersion || List->FloorSeed != Game->FloorSeed ||
+       List->FloorXTiles != Game->XTiles || List->FloorYTiles != Game->YTiles) {
+        BuildFloor(List, Game);
+    }
+    List->Count[DRAW_FLOOR_WIREFRAME] = Wireframe ? List->FloorTiles : 0;
+
+    int Ticked = !List->Built || List->Seed != Game->Seed || List->Tick != Game->Tick ||
+                 List->DirtyCount != Game->DirtyCount || List->Wireframe != Wireframe;
+    if(Ticked) BuildTick(List, Game, Wireframe);
+
+    PlaceMoving(List, Game, Alpha);
+    return Ticked;
+}
+
+void DrawListSubmit(drawList* List, drawBackend* Backend, matrix* ViewProjection) {
+    Backend->Submit(Backend->Backend, List, ViewProjection);
+}
+
+// Null backend
+
+typedef struct {
+    uint64_t Frames;
+    uint64_t Instances;
+    uint64_t Maps; // Map and Unmap pairs
+    uint64_t Draws;
+    uint64_t Bytes; // Written through maps or uploaded
+    uint64_t FloorUploads;
+    uint64_t FloorVersion; // Last one uploaded
+} drawCounts;
+
+// A new floor is one upload, then one map for the view-projection, one
+// for the other instances and an instanced draw per pass that has any
+
+void NullSubmit(void* Backend, drawList* List, matrix* ViewProjection) {
+    drawCounts* Counts = Backend;
+    ++Counts->Frames;
+
+    if(Counts->FloorVersion != List->FloorVersion) {
+        Counts->FloorVersion = List->FloorVersion;
+        ++Counts->FloorUploads;
+        Counts->Bytes += 2 * (uint64_t)List->FloorTiles * sizeof(drawInstance);
+    }
+
+    Counts->Maps += 2;
+    Counts->Bytes += sizeof(matrix) + (uint64_t)List->Total * sizeof(drawInstance);
+    for(int Pass = 0; Pass < DRAW_PASSES; ++Pass) {
+        if(!List->Count[Pass]) continue;
+        Counts->Instances += (uint64_t)List->Count[Pass];
+        ++Counts->Draws;
+    }
+}
+
+// Before the draw list every instance was a map of model, view,
+// projection and color followed by its own draw
+
+void DrawCountPerEntity(drawCounts* Counts, drawList* List) {
+    ++Counts->Frames;
+    for(int Pass = 0; Pass < DRAW_PASSES; ++Pass) {
+        uint64_t Count = (uint64_t)List->Count[Pass];
+        Counts->Instances += Count;
+        Counts->Maps += Count;
+        Counts->Draws += Count;
+        Counts->Bytes += Count * (3 * sizeof(matrix) + sizeof(color));
+    }
+}
+
+// Dirty cells, for renderers that keep the last frame and repaint cells:
+// the game's dirty cells plus the pieces whose shade moved along the
+// body, which are the first PIECE_SHADES now and the first PIECE_SHADES
+// last time. A cell may be listed twice. All is set instead when the
+// board is new or the game added more than GAME_DIRTY cells in between.
+
+typedef struct {
+    int All;
+    int Count;
+    uint32_t Cells[GAME_DIRTY + 2 * PIECE_SHADES];
+
+    // What the last update saw
+
+    int Valid;
+    uint64_t Seed;
+    int XTiles;
+    int YTiles;
+    uint64_t Tick;
+    uint64_t DirtyCount;
+    int ShadedCount;
+    uint32_t Shaded[PIECE_SHADES];
+} drawDirty;
+
+void DrawDirtyUpdate(drawDirty* Dirty, game* Game) {
+    Dirty->Count = 0;
+    Dirty->All = !Dirty->Valid || Dirty->Seed != Game->Seed ||
+                 Dirty->XTiles != Game->XTiles || Dirty->YTiles != Game->YTiles ||
+                 Game->Tick < Dirty->Tick || Game->DirtyCount < Dirty->DirtyCount ||
+                 Game->DirtyCount - Dirty->DirtyCount > GAME_DIRTY;
+
+    if(!Dirty->All && Game->Tick != Dirty->Tick) {
+        for(uint64_t Index = Dirty->DirtyCount; Index < Game->DirtyCount; ++Index) {
+            Dirty->Cells[Dirty->Count++] = Game->Dirty[Index & (GAME_DIRTY - 1)];
+        }
+        for(int Index = 0; Index < Dirty->ShadedCount; ++Index) {
+            Dirty->Cells[Dirty->Count++] = Dirty->Shaded[Index];
+        }
+        for(int Index = 0; Index < Game->BodyLength && Index < PIECE_SHADES; ++Index) {
+            Dirty->Cells[Dirty->Count++] = GetPieceCell(Game, Index);
+        }
+    }
+
+    Dirty->Valid = 1;
+    Dirty->Seed = Game->Seed;
+    Dirty->XTiles = Game->XTiles;
+    Dirty->YTiles = Game->YTiles;
+    Dirty->Tick = Game->Tick;
+    Dirty->DirtyCount = Game->DirtyCount;
+    Dirty->ShadedCount = 0;
+    for(int Index = 0; Index < Game->BodyLength && Index < PIECE_SHADES; ++Index) {
+        Dirty->Shaded[Dirty->ShadedCount++] = GetPieceCell(Game, Index);
+    }
+}
+
+// Palette of a tile as of the last update, the game has to be the real
+// one since a snapshot has no board
+
+int DrawDirtyTilePalette(drawDirty* Dirty, game* Game, uint32_t Cell) {
+    if(Cell == Game->Food) return PALETTE_FOOD;
+    if(IsCellBlocked(Game, Cell)) {
+        for(int Index = 0; Index < Dirty->ShadedCount; ++Index) {
+            if(Dirty->Shaded[Index] == Cell) return GetPiecePalette(Index);
+        }
+        return GetPiecePalette(PIECE_SHADES - 1);
+    }
+    return GetTilePalette(Game, Cell);
+}
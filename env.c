@@ -0,0 +1,341 @@
+// Training interface: a batch of games stepped with one action each, the
+// observations are written straight into buffers the caller owns.
+//
+// An observation is ENV_PLANES planes of bytes that are 0 or 1, each row
+// by row from the bottom (Y = 0) up. With Window 0 the planes cover the
+// board; otherwise they are a Window x Window square centered on the
+// head (Window is odd) and cells off the board read as walls. The
+// observations of consecutive games follow each other in one buffer of
+// Count * EnvObservationSize() bytes.
+//
+// Occupancy rows come straight from the game's bitmap, 64 cells at a
+// time, and are widened to bytes with AVX-512BW, AVX2 or a table.
+//
+// Rewards are 1 for eating, -1 for dying and 0 otherwise. A game that
+// ends is restarted right away: its done flag tells why and its
+// observation is of the new game.
+
+#include <immintrin.h>
+#include <string.h>
+
+enum {
+    ENV_PLANE_OCCUPIED, // Snake pieces, and walls in a window
+    ENV_PLANE_HEAD,
+    ENV_PLANE_FOOD,
+    ENV_PLANES,
+};
+
+enum {
+    ENV_RUNNING,
+    ENV_DIED,
+    ENV_TRUNCATED, // Hit MaxTicks
+};
+
+enum {
+    EXPAND_TABLE,
+    EXPAND_AVX2,
+    EXPAND_AVX512,
+    EXPAND_KERNELS,
+};
+
+char* ExpandKernelNames[EXPAND_KERNELS] = {"table", "avx2", "avx512"};
+
+#define ENV_TARGET(Target) __attribute__((target(Target)))
+
+typedef struct {
+    _Alignas(64) game Game;
+    rng Seeds;
+} envSlot;
+
+typedef struct {
+    int Count;
+    int XTiles;
+    int YTiles;
+    int Window;
+    int Width;
+    int Height;
+    uint64_t MaxTicks; // 0 for no limit
+    int Kernel;
+    envSlot* Slots;
+    pool* Pool;
+
+    // For the current EnvStep
+
+    int32_t* Actions;
+    float* Rewards;
+    uint8_t* Dones;
+    uint8_t* Observations;
+} env;
+
+enum {
+    STREAM_ENV_SEEDS,
+};
+
+// Widening bits to bytes, Count <= 64
+
+uint64_t ExpandTable[256];
+
+void InitExpandTable() {
+    for(int Byte = 0; Byte < 256; ++Byte) {
+        uint64_t Bytes = 0;
+        for(int Bit = 0; Bit < 8; ++Bit) {
+            if(Byte & (1 << Bit)) Bytes |= 1ull << (Bit * 8);
+        }
+        ExpandTable[Byte] = Bytes;
+    }
+}
+
+void ExpandBitsTable(uint64_t Bits, int Count, uint8_t* Out) {
+    for(int Index = 0; Index < Count; Index += 8) {
+        uint64_t Bytes = ExpandTable[(Bits >> Index) & 0xff];
+        int Left = Count - Index;
+        memcpy(Out + Index, &Bytes, Left < 8 ? Left : 8);
+    }
+}
+
+// 32 cells a store, then 16 if that many are left. Less than 16 isn't
+// worth a vector, the table does those, and rows that short never get
+// here.
+
+ENV_TARGET("avx2")
+__m256i ExpandWordAvx2(uint32_t Word) {
+    __m256i Spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                      2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    __m256i Select = _mm256_set1_epi64x(0x8040201008040201ll);
+    __m256i Bytes = _mm256_and_si256(_mm256_shuffle_epi8(_mm256_set1_epi32((int)Word), Spread), Select);
+    return _mm256_and_si256(_mm256_cmpeq_epi8(Bytes, Select), _mm256_set1_epi8(1));
+}
+
+ENV_TARGET("avx2")
+void ExpandBitsAvx2(uint64_t Bits, int Count, uint8_t* Out) {
+    int Index = 0;
+    for(; Count - Index >= 32; Index += 32) {
+        _mm256_storeu_si256((__m256i*)(Out + Index), ExpandWordAvx2((uint32_t)(Bits >> Index)));
+    }
+    if(Count - Index >= 16) {
+        _mm_storeu_si128((__m128i*)(Out + Index), _mm256_castsi256_si128(ExpandWordAvx2((uint32_t)(Bits >> Index))));
+        Index += 16;
+    }
+    if(Index < Count) ExpandBitsTable(Bits >> Index, Count - Index, Out + Index);
+}
+
+ENV_TARGET("avx512f,avx512bw")
+void ExpandBitsAvx512(uint64_t Bits, int Count, uint8_t* Out) {
+    __mmask64 Store = Count >= 64 ? ~0ull : (1ull << Count) - 1;
+    _mm512_mask_storeu_epi8(Out, Store, _mm512_maskz_mov_epi8(Bits, _mm512_set1_epi8(1)));
+}
+
+int ExpandKernelSupported(int Kernel) {
+    if(Kernel == EXPAND_AVX512) return __builtin_cpu_supports("avx512bw");
+    if(Kernel == EXPAND_AVX2) return __builtin_cpu_supports("avx2");
+    return 1;
+}
+
+void ExpandBits(int Kernel, uint64_t Bits, int Count, uint8_t* Out) {
+    switch(Kernel) {
+        case EXPAND_AVX512: ExpandBitsAvx512(Bits, Count, Out); break;
+        case EXPAND_AVX2: {
+            if(Count >= 16) ExpandBitsAvx2(Bits, Count, Out);
+            else ExpandBitsTable(Bits, Count, Out);
+        } break;
+        default: ExpandBitsTable(Bits, Count, Out); break;
+    }
+}
+
+// Observations
+
+int EnvObservationSize(env* Env) {
+    return ENV_PLANES * Env->Width * Env->Height;
+}
+
+// 64 bits of the occupancy bitmap starting at Bit
+
+uint64_t GetOccupiedBits(game* Game, int Words, int Bit) {
+    int Word = Bit >> 6;
+    int Shift = Bit & 63;
+    uint64_t Result = Game->Occupied[Word] >> Shift;
+    if(Shift && Word + 1 < Words) Result |= Game->Occupied[Word + 1] << (64 - Shift);
+    return Result;
+}
+
+// One row of the occupancy plane, X and Y are board coordinates and may
+// be off the board
+
+void ObserveRow(game* Game, int Kernel, int X, int Y, int Width, uint8_t* Out) {
+    int Stride = Game->Stride;
+    int Words = ((Game->YTiles + 2) * Stride + 63) / 64;
+
+    // Padded coordinates, the border row and column are in the bitmap
+
+    int Row = Y + 1;
+    int First = X + 1;
+    int Last = X + Width;
+
+    if(Row < 0 || Row > Game->YTiles + 1) {
+        memset(Out, 1, Width);
+        return;
+    }
+
+    int Begin = First < 0 ? 0 : First;
+    int End = Last > Stride - 1 ? Stride - 1 : Last;
+
+    if(Begin > End) {
+        memset(Out, 1, Width);
+        return;
+    }
+
+    if(Begin > First) memset(Out, 1, Begin - First);
+    if(End < Last) memset(Out + (End + 1 - First), 1, Last - End);
+
+    for(int Column = Begin; Column <= End; Column += 64) {
+        int Count = End + 1 - Column;
+        if(Count > 64) Count = 64;
+        uint64_t Bits = GetOccupiedBits(Game, Words, Row * Stride + Column);
+        ExpandBits(Kernel, Bits, Count, Out + (Column - First));
+    }
+}
+
+void EnvObserveGame(env* Env, game* Game, uint8_t* Out) {
+    int Width = Env->Width;
+    int Height = Env->Height;
+    int Plane = Width * Height;
+
+    uint32_t Head = GetPieceCell(Game, 0);
+    int X = 0;
+    int Y = 0;
+    if(Env->Window) {
+        X = CellX(Game, Head) - Env->Window / 2;
+        Y = CellY(Game, Head) - Env->Window / 2;
+    }
+
+    uint8_t* Occupied = Out + ENV_PLANE_OCCUPIED * Plane;
+    for(int Row = 0; Row < Height; ++Row) {
+        ObserveRow(Game, Env->Kernel, X, Y + Row, Width, Occupied + Row * Width);
+    }
+
+    // One hot planes
+
+    memset(Out + ENV_PLANE_HEAD * Plane, 0, 2 * Plane);
+
+    int HeadX = CellX(Game, Head) - X;
+    int HeadY = CellY(Game, Head) - Y;
+    Out[ENV_PLANE_HEAD * Plane + HeadY * Width + HeadX] = 1;
+
+    if(Game->Food != NO_FOOD) {
+        int FoodX = CellX(Game, Game->Food) - X;
+        int FoodY = CellY(Game, Game->Food) - Y;
+        if(FoodX >= 0 && FoodX < Width && FoodY >= 0 && FoodY < Height) {
+            Out[ENV_PLANE_FOOD * Plane + FoodY * Width + FoodX] = 1;
+        }
+    }
+}
+
+void EnvObserveTask(void* Context, int Begin, int End, int Worker) {
+    env* Env = Context;
+    size_t Size = EnvObservationSize(Env);
+    for(int Index = Begin; Index < End; ++Index) {
+        EnvObserveGame(Env, &Env->Slots[Index].Game, Env->Observations + Index * Size);
+    }
+}
+
+int EnvChunkSize(env* Env) {
+    int Chunk = Env->Count / (Env->Pool->WorkerCount * 8);
+    return Chunk < 1 ? 1 : Chunk;
+}
+
+// Observations of every game as they are now, without stepping
+
+void EnvObserve(env* Env, uint8_t* Observations) {
+    Env->Observations = Observations;
+    PoolRun(Env->Pool, EnvObserveTask, Env, Env->Count, EnvChunkSize(Env));
+}
+
+// Stepping
+
+void EnvStepTask(void* Context, int Begin, int End, int Worker) {
+    env* Env = Context;
+    size_t Size = EnvObservationSize(Env);
+
+    for(int Index = Begin; Index < End; ++Index) {
+        envSlot* Slot = &Env->Slots[Index];
+        game* Game = &Slot->Game;
+
+        int Action = Env->Actions[Index];
+        if(Action >= 0 && Action < KEYSAMOUNT) InputQueueAdd(&Game->InputQueue, Action);
+
+        int TailLength = Game->TailLength;
+        GameUpdate(Game);
+
+        float Reward = Game->TailLength > TailLength ? 1.0f : 0.0f;
+        int Done = ENV_RUNNING;
+
+        if(!Game->Running) {
+            Reward = -1.0f;
+            Done = ENV_DIED;
+        } else if(Env->MaxTicks && Game->Tick >= Env->MaxTicks) {
+            Done = ENV_TRUNCATED;
+        }
+
+        if(Done != ENV_RUNNING) {
+            GameReset(Game, RngNext(&Slot->Seeds));
+        }
+
+        Env->Rewards[Index] = Reward;
+        Env->Dones[Index] = (uint8_t)Done;
+        if(Env->Observations) EnvObserveGame(Env, Game, Env->Observations + Index * Size);
+    }
+}
+
+// Actions are directions, anything else is no input. Observations may be
+// 0 to skip writing them.
+
+void EnvStep(env* Env, int32_t* Actions, float* Rewards, uint8_t* Dones, uint8_t* Observations) {
+    Env->Actions = Actions;
+    Env->Rewards = Rewards;
+    Env->Dones = Dones;
+    Env->Observations = Observations;
+    PoolRun(Env->Pool, EnvStepTask, Env, Env->Count, EnvChunkSize(Env));
+}
+
+void EnvInit(env* Env, pool* Pool, int Count, int XTiles, int YTiles, int Window, uint64_t Seed) {
+    assert(Window == 0 || (Window > 0 && Window % 2 == 1));
+
+    *Env = (env){
+        .Count = Count,
+        .XTiles = XTiles,
+        .YTiles = YTiles,
+        .Window = Window,
+        .Width = Window ? Window : XTiles,
+        .Height = Window ? Window : YTiles,
+        .Pool = Pool,
+    };
+
+    InitExpandTable();
+    for(int Kernel = EXPAND_KERNELS - 1; Kernel >= 0; --Kernel) {
+        if(ExpandKernelSupported(Kernel)) {
+            Env->Kernel = Kernel;
+            break;
+        }
+    }
+
+    Env->Slots = aligned_alloc(64, sizeof(envSlot) * Count);
+    assert(Env->Slots);
+
+    for(int Index = 0; Index < Count; ++Index) {
+        envSlot* Slot = &Env->Slots[Index];
+        *Slot = (envSlot){0};
+
+        rng Streams;
+        RngInit(&Streams, Seed, Index);
+        RngInit(&Slot->Seeds, RngNext(&Streams), STREAM_ENV_SEEDS);
+        GameInit(&Slot->Game, XTiles, YTiles, RngNext(&Slot->Seeds));
+    }
+}
+
+void EnvFree(env* Env) {
+    for(int Index = 0; Index < Env->Count; ++Index) {
+        GameFree(&Env->Slots[Index].Game);
+    }
+    free(Env->Slots);
+    Env->Slots = 0;
+}
@@ -0,0 +1,452 @@
+// Frame export: writes successive states of a game as an animated GIF,
+// every tile a square of CellSize pixels in its palette color, the top
+// row is the highest Y like in the window.
+//
+// Only the first frame is a whole picture. After that a frame is the
+// rectangle around the tiles whose color changed since the frame before,
+// with everything else in it transparent so the old picture shows
+// through. The tiles come from DrawDirtyUpdate and what the file already
+// has, so building a frame costs what changed, not the board.
+//
+// The caller's thread only lists the changed tiles. Turning them into
+// pixels and LZW runs on worker threads, EXPORT_FRAMES frames can be in
+// flight and they are written in order as they come back. The caller
+// waits only when all of them are still being encoded. Every buffer is
+// reused from frame to frame, so memory depends on the board and the
+// cell size but not on how long the game goes.
+//
+// The palette fits a 32 color table, the index after it is transparent.
+
+#define EXPORT_FRAMES 16
+#define EXPORT_COLOR_BITS 5
+#define EXPORT_COLORS (1 << EXPORT_COLOR_BITS)
+#define EXPORT_TRANSPARENT PALETTE_AMOUNT
+#define EXPORT_CODES 4096 // LZW code space of a GIF
+#define EXPORT_UNKNOWN 0xff // Tile not in the file yet
+
+typedef struct {
+    uint16_t X; // In tiles, Y goes down like the image
+    uint16_t Y;
+    uint8_t Palette;
+} exportTile;
+
+enum {
+    EXPORT_FREE,
+    EXPORT_QUEUED,
+    EXPORT_ENCODED,
+};
+
+typedef struct {
+    int State;
+
+    exportTile* Tiles;
+    int TileCount;
+    int TileCapacity;
+
+    // Rectangle in tiles
+
+    int Left;
+    int Top;
+    int Right;
+    int Bottom;
+
+    // The frame as it goes in the file
+
+    uint8_t* Data;
+    size_t Size;
+    size_t Capacity;
+} exportFrame;
+
+typedef struct exporter exporter;
+
+typedef struct {
+    exporter* Exporter;
+    pthread_t Thread;
+    uint8_t* Pixels;
+    size_t PixelCapacity;
+    uint16_t (*Next)[EXPORT_COLORS]; // LZW: code of a code followed by a pixel, 0 for none
+} exportWorker;
+
+struct exporter {
+    FILE* File;
+    int Failed;
+    int XTiles;
+    int YTiles;
+    int CellSize;
+    int Delay; // Centiseconds a frame is shown
+
+    drawDirty Dirty;
+    uint8_t* Shown; // Palette of every tile as the file has it
+
+    exportFrame Frames[EXPORT_FRAMES]; // Frame N is in N % EXPORT_FRAMES
+    uint64_t Submitted;
+    uint64_t Taken; // By the workers
+    uint64_t Written;
+
+    int WorkerCount;
+    exportWorker Workers[MAX_WORKERS];
+    pthread_mutex_t Mutex;
+    pthread_cond_t Queued;
+    pthread_cond_t Encoded;
+    int Quit;
+
+    uint64_t Tiles; // Sent
+    uint64_t Stalls; // Times the caller waited for a worker
+    uint64_t Bytes;
+};
+
+// Encoding, on the workers
+
+void ExportPush(exportFrame* Frame, void* Data, size_t Size) {
+    if(Frame->Size + Size > Frame->Capacity) {
+        Frame->Capacity = (Frame->Size + Size) * 2;
+        Frame->Data = realloc(Frame->Data, Frame->Capacity);
+        assert(Frame->Data);
+    }
+    memcpy(Frame->Data + Frame->Size, Data, Size);
+    Frame->Size += Size;
+}
+
+void ExportPushShort(exportFrame* Frame, int Value) {
+    uint8_t Bytes[2] = {(uint8_t)Value, (uint8_t)(Value >> 8)};
+    ExportPush(Frame, Bytes, 2);
+}
+
+// Codes go out least significant bit first, in blocks of up to 255
+// bytes that each start with their size
+
+typedef struct {
+    exportFrame* Frame;
+    uint32_t Bits;
+    int BitCount;
+    uint8_t Block[256];
+} exportBits;
+
+void ExportFlushBlock(exportBits* Bits) {
+    if(Bits->Block[0]) {
+        ExportPush(Bits->Frame, Bits->Block, (size_t)Bits->Block[0] + 1);
+        Bits->Block[0] = 0;
+    }
+}
+
+void ExportCode(exportBits* Bits, int Code, int CodeSize) {
+    Bits->Bits |= (uint32_t)Code << Bits->BitCount;
+    Bits->BitCount += CodeSize;
+    while(Bits->BitCount >= 8) {
+        Bits->Block[++Bits->Block[0]] = (uint8_t)Bits->Bits;
+        Bits->Bits >>= 8;
+        Bits->BitCount -= 8;
+        if(Bits->Block[0] == 255) ExportFlushBlock(Bits);
+    }
+}
+
+void ExportLzw(exportWorker* Worker, exportFrame* Frame, uint8_t* Pixels, size_t Count) {
+    int Clear = EXPORT_COLORS;
+    int CodeSize = EXPORT_COLOR_BITS + 1;
+    int LastCode = Clear + 1;
+    memset(Worker->Next, 0, EXPORT_CODES * sizeof(*Worker->Next));
+
+    uint8_t MinimumCodeSize = EXPORT_COLOR_BITS;
+    ExportPush(Frame, &MinimumCodeSize, 1);
+
+    exportBits Bits = {Frame};
+    ExportCode(&Bits, Clear, CodeSize);
+
+    int Code = Pixels[0];
+    for(size_t Index = 1; Index < Count; ++Index) {
+        int Pixel = Pixels[Index];
+        if(Worker->Next[Code][Pixel]) {
+            Code = Worker->Next[Code][Pixel];
+            continue;
+        }
+
+        ExportCode(&Bits, Code, CodeSize);
+        Worker->Next[Code][Pixel] = (uint16_t)++LastCode;
+        if(LastCode >= (1 << CodeSize)) ++CodeSize;
+        if(LastCode == EXPORT_CODES - 1) {
+            ExportCode(&Bits, Clear, CodeSize);
+            memset(Worker->Next, 0, EXPORT_CODES * sizeof(*Worker->Next));
+            CodeSize = EXPORT_COLOR_BITS + 1;
+            LastCode = Clear + 1;
+        }
+        Code = Pixel;
+    }
+
+    // The decoder adds a code for the last one too, which can widen the
+    // end code
+
+    ExportCode(&Bits, Code, CodeSize);
+    if(LastCode + 1 >= (1 << CodeSize) && CodeSize < 12) ++CodeSize;
+    ExportCode(&Bits, Clear + 1, CodeSize);
+    if(Bits.BitCount) ExportCode(&Bits, 0, 8 - Bits.BitCount);
+    ExportFlushBlock(&Bits);
+
+    uint8_t End = 0;
+    ExportPush(Frame, &End, 1);
+}
+
+void ExportEncode(exportWorker* Worker, exportFrame* Frame) {
+    exporter* Exporter = Worker->Exporter;
+    int Cell = Exporter->CellSize;
+    int Width = (Frame->Right - Frame->Left) * Cell;
+    int Height = (Frame->Bottom - Frame->Top) * Cell;
+
+    size_t Count = (size_t)Width * Height;
+    if(Count > Worker->PixelCapacity) {
+        free(Worker->Pixels);
+        Worker->Pixels = malloc(Count);
+        assert(Worker->Pixels);
+        Worker->PixelCapacity = Count;
+    }
+    memset(Worker->Pixels, EXPORT_TRANSPARENT, Count);
+
+    for(int Index = 0; Index < Frame->TileCount; ++Index) {
+        exportTile* Tile = &Frame->Tiles[Index];
+        uint8_t* Row = Worker->Pixels + (size_t)(Tile->Y - Frame->Top) * Cell * Width + (Tile->X - Frame->Left) * Cell;
+        for(int Y = 0; Y < Cell; ++Y, Row += Width) {
+            memset(Row, Tile->Palette, (size_t)Cell);
+        }
+    }
+
+    // Graphic control: keep the frame under the next one, transparent
+    // index on
+
+    Frame->Size = 0;
+    uint8_t Control[4] = {0x21, 0xf9, 4, (1 << 2) | 1};
+    ExportPush(Frame, Control, 4);
+    ExportPushShort(Frame, Exporter->Delay);
+    uint8_t ControlEnd[2] = {EXPORT_TRANSPARENT, 0};
+    ExportPush(Frame, ControlEnd, 2);
+
+    uint8_t Descriptor = 0x2c;
+    ExportPush(Frame, &Descriptor, 1);
+    ExportPushShort(Frame, Frame->Left * Cell);
+    ExportPushShort(Frame, Frame->Top * Cell);
+    ExportPushShort(Frame, Width);
+    ExportPushShort(Frame, Height);
+    uint8_t Flags = 0;
+    ExportPush(Frame, &Flags, 1);
+
+    ExportLzw(Worker, Frame, Worker->Pixels, Count);
+}
+
+void* ExportThread(void* Parameter) {
+    exportWorker* Worker = Parameter;
+    exporter* Exporter = Worker->Exporter;
+
+    pthread_mutex_lock(&Exporter->Mutex);
+    for(;;) {
+        while(Exporter->Taken == Exporter->Submitted && !Exporter->Quit) {
+            pthread_cond_wait(&Exporter->Queued, &Exporter->Mutex);
+        }
+        if(Exporter->Taken == Exporter->Submitted) break;
+
+        exportFrame* Frame = &Exporter->Frames[Exporter->Taken++ % EXPORT_FRAMES];
+        pthread_mutex_unlock(&Exporter->Mutex);
+
+        ExportEncode(Worker, Frame);
+
+        pthread_mutex_lock(&Exporter->Mutex);
+        Frame->State = EXPORT_ENCODED;
+        pthread_cond_broadcast(&Exporter->Encoded);
+    }
+    pthread_mutex_unlock(&Exporter->Mutex);
+
+    return 0;
+}
+
+// Writing, on the caller's thread
+
+void ExportWrite(exporter* Exporter, void* Data, size_t Size) {
+    if(fwrite(Data, 1, Size, Exporter->File) != Size) Exporter->Failed = 1;
+    Exporter->Bytes += Size;
+}
+
+// Writes encoded frames in order until Until are out, waiting for the
+// workers if they haven't got that far
+
+void ExportWriteUntil(exporter* Exporter, uint64_t Until) {
+    pthread_mutex_lock(&Exporter->Mutex);
+    for(;;) {
+        exportFrame* Frame = &Exporter->Frames[Exporter->Written % EXPORT_FRAMES];
+        if(Exporter->Written == Exporter->Submitted || Frame->State != EXPORT_ENCODED) {
+            if(Exporter->Written >= Until) break;
+            ++Exporter->Stalls;
+            while(Frame->State != EXPORT_ENCODED) pthread_cond_wait(&Exporter->Encoded, &Exporter->Mutex);
+        }
+        pthread_mutex_unlock(&Exporter->Mutex);
+
+        ExportWrite(Exporter, Frame->Data, Frame->Size);
+
+        pthread_mutex_lock(&Exporter->Mutex);
+        Frame->State = EXPORT_FREE;
+        ++Exporter->Written;
+    }
+    pthread_mutex_unlock(&Exporter->Mutex);
+}
+
+// Workers 0 encodes on the caller's thread. Path "-" is stdout, for
+// piping into something else.
+
+int ExportBegin(exporter* Exporter, char* Path, int XTiles, int YTiles, int CellSize, int Delay, int WorkerCount) {
+    memset(Exporter, 0, sizeof(*Exporter));
+    if(XTiles * CellSize > 0xffff || YTiles * CellSize > 0xffff) return 0;
+
+    Exporter->File = strcmp(Path, "-") ? fopen(Path, "wb") : stdout;
+    if(!Exporter->File) return 0;
+
+    Exporter->XTiles = XTiles;
+    Exporter->YTiles = YTiles;
+    Exporter->CellSize = CellSize;
+    Exporter->Delay = Delay;
+    Exporter->Shown = malloc((size_t)XTiles * YTiles);
+    assert(Exporter->Shown);
+    memset(Exporter->Shown, EXPORT_UNKNOWN, (size_t)XTiles * YTiles);
+
+    if(WorkerCount > MAX_WORKERS) WorkerCount = MAX_WORKERS;
+    Exporter->WorkerCount = WorkerCount;
+    pthread_mutex_init(&Exporter->Mutex, 0);
+    pthread_cond_init(&Exporter->Queued, 0);
+    pthread_cond_init(&Exporter->Encoded, 0);
+    for(int Index = 0; Index < (WorkerCount > 0 ? WorkerCount : 1); ++Index) {
+        exportWorker* Worker = &Exporter->Workers[Index];
+        Worker->Exporter = Exporter;
+        Worker->Next = malloc(EXPORT_CODES * sizeof(*Worker->Next));
+        assert(Worker->Next);
+        if(Index < WorkerCount) pthread_create(&Worker->Thread, 0, ExportThread, Worker);
+    }
+
+    // Header, screen, color table and a loop forever extension
+
+    uint8_t Header[13] = {'G', 'I', 'F', '8', '9', 'a',
+                          (uint8_t)(XTiles * CellSize), (uint8_t)(XTiles * CellSize >> 8),
+                          (uint8_t)(YTiles * CellSize), (uint8_t)(YTiles * CellSize >> 8),
+                          0x80 | 0x70 | (EXPORT_COLOR_BITS - 1), 0, 0};
+    ExportWrite(Exporter, Header, sizeof(Header));
+
+    uint8_t Colors[EXPORT_COLORS][3] = {{0}};
+    for(int Index = 0; Index < PALETTE_AMOUNT; ++Index) {
+        Colors[Index][0] = (uint8_t)(Saturate(Palette[Index].R) * 255.0f + 0.5f);
+        Colors[Index][1] = (uint8_t)(Saturate(Palette[Index].G) * 255.0f + 0.5f);
+        Colors[Index][2] = (uint8_t)(Saturate(Palette[Index].B) * 255.0f + 0.5f);
+    }
+    ExportWrite(Exporter, Colors, sizeof(Colors));
+
+    uint8_t Loop[19] = {0x21, 0xff, 11, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 3, 1, 0, 0, 0};
+    ExportWrite(Exporter, Loop, sizeof(Loop));
+
+    return !Exporter->Failed;
+}
+
+void ExportTile(exporter* Exporter, exportFrame* Frame, game* Game, uint32_t Cell) {
+    int X = CellX(Game, Cell);
+    int Y = Exporter->YTiles - 1 - CellY(Game, Cell);
+    uint8_t Shade = (uint8_t)DrawDirtyTilePalette(&Exporter->Dirty, Game, Cell);
+
+    uint8_t* Shown = &Exporter->Shown[(size_t)Y * Exporter->XTiles + X];
+    if(*Shown == Shade) return;
+    *Shown = Shade;
+
+    if(Frame->TileCount == Frame->TileCapacity) {
+        Frame->TileCapacity = Frame->TileCapacity ? Frame->TileCapacity * 2 : 64;
+        Frame->Tiles = realloc(Frame->Tiles, Frame->TileCapacity * sizeof(exportTile));
+        assert(Frame->Tiles);
+    }
+    Frame->Tiles[Frame->TileCount++] = (exportTile){(uint16_t)X, (uint16_t)Y, Shade};
+
+    if(X < Frame->Left) Frame->Left = X;
+    if(Y < Frame->Top) Frame->Top = Y;
+    if(X + 1 > Frame->Right) Frame->Right = X + 1;
+    if(Y + 1 > Frame->Bottom) Frame->Bottom = Y + 1;
+    ++Exporter->Tiles;
+}
+
+// Adds what changed since the last frame as a frame. The game has to
+// have the board size given to ExportBegin.
+
+void ExportFrame(exporter* Exporter, game* Game) {
+    assert(Game->XTiles == Exporter->XTiles && Game->YTiles == Exporter->YTiles);
+
+    uint64_t Number = Exporter->Submitted;
+    if(Number >= EXPORT_FRAMES) ExportWriteUntil(Exporter, Number - EXPORT_FRAMES + 1);
+    exportFrame* Frame = &Exporter->Frames[Number % EXPORT_FRAMES];
+
+    Frame->TileCount = 0;
+    Frame->Left = Exporter->XTiles;
+    Frame->Top = Exporter->YTiles;
+    Frame->Right = 0;
+    Frame->Bottom = 0;
+
+    DrawDirtyUpdate(&Exporter->Dirty, Game);
+    if(Exporter->Dirty.All) {
+        for(int Y = 0; Y < Game->YTiles; ++Y) {
+            for(int X = 0; X < Game->XTiles; ++X) {
+                ExportTile(Exporter, Frame, Game, CellIndex(Game, X, Y));
+            }
+        }
+    } else {
+        for(int Index = 0; Index < Exporter->Dirty.Count; ++Index) {
+            ExportTile(Exporter, Frame, Game, Exporter->Dirty.Cells[Index]);
+        }
+    }
+
+    // Nothing changed, one transparent tile still takes up the time
+
+    if(!Frame->TileCount) {
+        Frame->Left = 0;
+        Frame->Top = 0;
+        Frame->Right = 1;
+        Frame->Bottom = 1;
+    }
+
+    if(!Exporter->WorkerCount) {
+        ExportEncode(&Exporter->Workers[0], Frame);
+        ExportWrite(Exporter, Frame->Data, Frame->Size);
+        ++Exporter->Submitted;
+        ++Exporter->Taken;
+        ++Exporter->Written;
+        return;
+    }
+
+    pthread_mutex_lock(&Exporter->Mutex);
+    Frame->State = EXPORT_QUEUED;
+    ++Exporter->Submitted;
+    pthread_cond_signal(&Exporter->Queued);
+    pthread_mutex_unlock(&Exporter->Mutex);
+}
+
+// Writes the rest and closes the file, 0 if something didn't get written
+
+int ExportEnd(exporter* Exporter) {
+    ExportWriteUntil(Exporter, Exporter->Submitted);
+
+    pthread_mutex_lock(&Exporter->Mutex);
+    Exporter->Quit = 1;
+    pthread_cond_broadcast(&Exporter->Queued);
+    pthread_mutex_unlock(&Exporter->Mutex);
+
+    for(int Index = 0; Index < (Exporter->WorkerCount > 0 ? Exporter->WorkerCount : 1); ++Index) {
+        exportWorker* Worker = &Exporter->Workers[Index];
+        if(Index < Exporter->WorkerCount) pthread_join(Worker->Thread, 0);
+        free(Worker->Pixels);
+        free(Worker->Next);
+    }
+    for(int Index = 0; Index < EXPORT_FRAMES; ++Index) {
+        free(Exporter->Frames[Index].Tiles);
+        free(Exporter->Frames[Index].Data);
+    }
+    free(Exporter->Shown);
+
+    uint8_t Trailer = 0x3b;
+    ExportWrite(Exporter, &Trailer, 1);
+    if(Exporter->File == stdout) {
+        if(fflush(stdout)) Exporter->Failed = 1;
+    } else if(fclose(Exporter->File)) {
+        Exporter->Failed = 1;
+    }
+
+    pthread_mutex_destroy(&Exporter->Mutex);
+    pthread_cond_destroy(&Exporter->Queued);
+    pthread_cond_destroy(&Exporter->Encoded);
+    return !Exporter->Failed;
+}
@@ -0,0 +1,117 @@
+// Hamiltonian cycle solver: a fixed tour through every tile that the
+// snake can follow forever, so it always ends up filling the board.
+// Used to drive the game at full length, which no player gets to.
+//
+// The tour needs a side with an even number of tiles. With an even
+// number of rows it goes along row 0, snakes back and forth over the
+// rows leaving column 0 out, and comes back down column 0; with an odd
+// number of rows the same tour is laid out with rows and columns
+// swapped. The position of every cell on the tour comes from a formula,
+// so building it is one linear pass and one uint32_t per cell.
+//
+// Shortcuts: the body always lies on the tour between the tail and the
+// head, so the head may jump to any neighbor further along the tour as
+// long as it doesn't pass the food or come close to the tail. That only
+// pays off while the board is mostly empty, past half full the snake
+// just follows the tour.
+
+#define HAMILTON_OFF UINT32_MAX // Border cells
+#define HAMILTON_MARGIN 4 // Cells kept between head and tail on a shortcut
+
+typedef struct {
+    int Length; // Tiles on the tour
+    uint32_t* Order; // Position on the tour by cell
+    uint64_t Shortcuts;
+} hamilton;
+
+int HamiltonSupported(int XTiles, int YTiles) {
+    return XTiles >= 2 && YTiles >= 2 && (XTiles % 2 == 0 || YTiles % 2 == 0);
+}
+
+// Position of tile (X, Y) on the tour of a Width x Height board with an
+// even Height
+
+uint32_t HamiltonPosition(int X, int Y, int Width, int Height) {
+    uint32_t Row = (uint32_t)(Width - 1);
+    if(X == 0) {
+        return Y == 0 ? 0 : (uint32_t)Height * Row + 1 + (uint32_t)(Height - 1 - Y);
+    }
+    uint32_t Start = 1 + (uint32_t)Y * Row;
+    return Start + (Y % 2 == 0 ? (uint32_t)(X - 1) : (uint32_t)(Width - 1 - X));
+}
+
+void HamiltonInit(hamilton* Hamilton, game* Game) {
+    int XTiles = Game->XTiles;
+    int YTiles = Game->YTiles;
+    assert(HamiltonSupported(XTiles, YTiles));
+
+    int Cells = Game->Stride * (YTiles + 2);
+    *Hamilton = (hamilton){
+        .Length = XTiles * YTiles,
+    };
+    Hamilton->Order = malloc(Cells * sizeof(uint32_t));
+    assert(Hamilton->Order);
+
+    for(int Cell = 0; Cell < Cells; ++Cell) {
+        Hamilton->Order[Cell] = HAMILTON_OFF;
+    }
+
+    for(int Y = 0; Y < YTiles; ++Y) {
+        for(int X = 0; X < XTiles; ++X) {
+            Hamilton->Order[CellIndex(Game, X, Y)] = YTiles % 2 == 0
+                ? HamiltonPosition(X, Y, XTiles, YTiles)
+                : HamiltonPosition(Y, X, YTiles, XTiles);
+        }
+    }
+}
+
+void HamiltonFree(hamilton* Hamilton) {
+    free(Hamilton->Order);
+    Hamilton->Order = 0;
+}
+
+// Steps from the head to Cell along the tour
+
+uint32_t HamiltonDistance(hamilton* Hamilton, uint32_t From, uint32_t To) {
+    uint32_t Length = (uint32_t)Hamilton->Length;
+    return (Hamilton->Order[To] + Length - Hamilton->Order[From]) % Length;
+}
+
+// Call once per tick before GameUpdate, returns the direction to take
+
+int HamiltonDirection(hamilton* Hamilton, game* Game) {
+    uint32_t Head = GetPieceCell(Game, 0);
+    uint32_t Tail = GetPieceCell(Game, Game->BodyLength - 1);
+
+    // Farthest the head may get this tick, 1 is the next tile on the tour
+
+    uint32_t Reach = 1;
+
+    if(Game->Food != NO_FOOD && Game->BodyLength * 2 < Hamilton->Length) {
+        uint32_t TailDistance = Game->BodyLength == 1 ? (uint32_t)Hamilton->Length : HamiltonDistance(Hamilton, Head, Tail);
+        uint32_t FoodDistance = HamiltonDistance(Hamilton, Head, Game->Food);
+        uint32_t Margin = Game->Growing + HAMILTON_MARGIN;
+
+        Reach = FoodDistance;
+        if(TailDistance < Margin + Reach) Reach = TailDistance > Margin ? TailDistance - Margin : 1;
+        if(Reach < 1) Reach = 1;
+    }
+
+    int Best = -1;
+    uint32_t BestDistance = 0;
+
+    for(int Direction = 0; Direction < KEYSAMOUNT; ++Direction) {
+        uint32_t Cell = Head + Game->Steps[Direction];
+        if(Hamilton->Order[Cell] == HAMILTON_OFF) continue;
+
+        uint32_t Distance = HamiltonDistance(Hamilton, Head, Cell);
+        if(Distance > Reach || Distance <= BestDistance) continue;
+        if(Distance > 1 && IsCellBlocked(Game, Cell)) continue;
+
+        Best = Direction;
+        BestDistance = Distance;
+    }
+
+    if(BestDistance > 1) ++Hamilton->Shortcuts;
+    return Best;
+}
@@ -0,0 +1,2088 @@
+// Headless driver: runs the simulation without a window and reports how
+// it went. Build with build.sh.
+//
+//   headless bench [ticks] [seed] [xtiles] [ytiles]
+//   headless realtime [seconds] [tick microseconds]
+//   headless clocktest
+//   headless record file [ticks] [seed] [xtiles] [ytiles]
+//   headless replay file [repeat]
+//   headless batch [games] [ticks] [threads] [xtiles] [ytiles] [greedy|random]
+//   headless lockstep [games] [ticks] [xtiles] [ytiles]
+//   headless env [games] [steps] [window] [threads] [xtiles] [ytiles]
+//   headless autopilot [ticks] [xtiles] [ytiles] [budget] [seed]
+//   headless hamilton [xtiles] [ytiles] [max ticks] [seed]
+//   headless arena [snakes] [ticks] [xtiles] [ytiles] [food] [seed]
+//   headless server [port] [seconds] [tick hz] [snakes] [xtiles] [ytiles] [food]
+//   headless clients [host] [port] [count] [seed]
+//   headless nettest [clients] [seconds] [tick hz] [snakes] [xtiles] [ytiles] [food]
+//   headless input [seconds] [turns per second] [delay]
+//   headless snapshot [seconds] [tick microseconds] [frame microseconds] [xtiles] [ytiles] [trace.json]
+//   headless drawlist [frames] [xtiles] [ytiles] [wireframe]
+//   headless raster [frames] [xtiles] [ytiles] [width] [height] [threads] [wireframe] [file.ppm]
+//   headless watch [seconds] [ticks per second] [xtiles] [ytiles] [frames per second]
+//   headless export recording file.gif [cell pixels] [delay centiseconds] [threads]
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "snake.c"
+#include "timestep.c"
+#include "replay.c"
+#include "bots.c"
+#include "pool.c"
+#include "batch.c"
+#include "lockstep.c"
+#include "env.c"
+#include "autopilot.c"
+#include "hamilton.c"
+#include "arena.c"
+#include "net.c"
+#include "input.c"
+#include "snapshot.c"
+#include "drawlist.c"
+#include "trace.c"
+#include "raster.c"
+#include "term.c"
+#include "export.c"
+
+uint64_t GetNanoseconds() {
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return (uint64_t)Time.tv_sec * 1000000000ull + (uint64_t)Time.tv_nsec;
+}
+
+// Sleeps without spinning, for threads that share a core
+
+void SleepUntil(uint64_t Deadline) {
+    struct timespec Time = {
+        (time_t)(Deadline / 1000000000ull),
+        (long)(Deadline % 1000000000ull),
+    };
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &Time, 0) == EINTR) {}
+}
+
+// CPU time of the calling thread
+
+uint64_t GetThreadNanoseconds() {
+    struct timespec Time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &Time);
+    return (uint64_t)Time.tv_sec * 1000000000ull + (uint64_t)Time.tv_nsec;
+}
+
+// Runs ticks back to back
+
+int RunBench(int ArgumentCount, char** Arguments) {
+
+    long long Ticks = 10000000;
+    uint64_t Seed = 1;
+    int XTiles = 20;
+    int YTiles = 20;
+
+    if(ArgumentCount > 0) Ticks = atoll(Arguments[0]);
+    if(ArgumentCount > 1) Seed = strtoull(Arguments[1], 0, 10);
+    if(ArgumentCount > 2) XTiles = atoi(Arguments[2]);
+    if(ArgumentCount > 3) YTiles = atoi(Arguments[3]);
+
+    if(XTiles < 1 || XTiles > MAX_TILES || YTiles < 1 || YTiles > MAX_TILES) {
+        fprintf(stderr, "usage: headless bench [ticks] [seed] [xtiles] [ytiles]\n");
+        return 1;
+    }
+
+    game Game;
+    GameInit(&Game, XTiles, YTiles, Seed);
+
+    long long Games = 0;
+    long long TotalLength = 0;
+
+    uint64_t Start = GetNanoseconds();
+
+    for(long long Tick = 0; Tick < Ticks; ++Tick) {
+        int Direction = GreedyDirection(&Game);
+        if(Direction >= 0) InputQueueAdd(&Game.InputQueue, Direction);
+
+        GameUpdate(&Game);
+
+        if(!Game.Running) {
+            ++Games;
+            TotalLength += Game.TailLength + 1;
+            GameFree(&Game);
+            GameInit(&Game, XTiles, YTiles, ++Seed);
+        }
+    }
+
+    uint64_t Elapsed = GetNanoseconds() - Start;
+    double Seconds = (double)Elapsed / 1e9;
+
+    printf("board:        %dx%d\n", XTiles, YTiles);
+    printf("ticks:        %lld\n", Ticks);
+    printf("seconds:      %.3f\n", Seconds);
+    printf("ticks/sec:    %.0f\n", (double)Ticks / Seconds);
+    printf("games:        %lld\n", Games);
+    printf("avg length:   %.1f\n", Games ? (double)TotalLength / (double)Games : 0.0);
+    printf("length now:   %d\n", Game.TailLength + 1);
+
+    GameFree(&Game);
+    return 0;
+}
+
+// Sleep most of the way, spin the rest
+
+void WaitUntil(uint64_t Deadline) {
+    uint64_t Now = GetNanoseconds();
+    uint64_t Sleep = ClockSleepNanos(Now, Deadline);
+    if(Sleep) {
+        struct timespec Time = {
+            (time_t)(Sleep / 1000000000ull),
+            (long)(Sleep % 1000000000ull),
+        };
+        nanosleep(&Time, 0);
+    }
+    while(GetNanoseconds() < Deadline) {}
+}
+
+void PrintClock(fixedClock* Clock) {
+    printf("ticks:        %llu\n", (unsigned long long)Clock->Ticks);
+    printf("dropped:      %llu\n", (unsigned long long)Clock->Dropped);
+    printf("late avg us:  %.2f\n", Clock->Ticks ? (double)Clock->LatenessSum / (double)Clock->Ticks / 1e3 : 0.0);
+    printf("late max us:  %.2f\n", (double)Clock->LatenessMax / 1e3);
+}
+
+// Ticks on the real clock at a fixed rate, like the window does, and
+// reports how late ticks were
+
+int RunRealtime(int ArgumentCount, char** Arguments) {
+
+    double Seconds = 2.0;
+    uint64_t TickNanos = 1000000;
+
+    if(ArgumentCount > 0) Seconds = atof(Arguments[0]);
+    if(ArgumentCount > 1) TickNanos = (uint64_t)(atof(Arguments[1]) * 1e3);
+
+    if(Seconds <= 0.0 || TickNanos == 0) {
+        fprintf(stderr, "usage: headless realtime [seconds] [tick microseconds]\n");
+        return 1;
+    }
+
+    uint64_t Seed = 1;
+
+    game Game;
+    GameInit(&Game, 20, 20, Seed);
+
+    fixedClock Clock;
+    uint64_t Start = GetNanoseconds();
+    uint64_t End = Start + (uint64_t)(Seconds * 1e9);
+    ClockInit(&Clock, Start, TickNanos);
+
+    while(GetNanoseconds() < End) {
+        WaitUntil(ClockNextTick(&Clock));
+
+        int Ticks = ClockAdvance(&Clock, GetNanoseconds());
+        for(int Tick = 0; Tick < Ticks; ++Tick) {
+            int Direction = GreedyDirection(&Game);
+            if(Direction >= 0) InputQueueAdd(&Game.InputQueue, Direction);
+
+            GameUpdate(&Game);
+
+            if(!Game.Running) {
+                GameFree(&Game);
+                GameInit(&Game, 20, 20, ++Seed);
+            }
+        }
+    }
+
+    printf("tick us:      %.2f\n", (double)TickNanos / 1e3);
+    PrintClock(&Clock);
+
+    GameFree(&Game);
+    return 0;
+}
+
+// Drives the clock with made up frame times, including stalls, and checks
+// that no time is lost or invented
+
+int RunClockTest() {
+
+    rng Rng;
+    RngInit(&Rng, 1, 0);
+
+    uint64_t TickNanos = GetTickNanos(3);
+    uint64_t Now = 1000;
+    uint64_t Start = Now;
+    uint64_t Ticks = 0;
+    int Failed = 0;
+
+    fixedClock Clock;
+    ClockInit(&Clock, Now, TickNanos);
+
+    for(int Frame = 0; Frame < 1000000; ++Frame) {
+
+        // Mostly 60 Hz frames with some jitter, now and then a long stall
+
+        uint64_t FrameNanos = FRAME_NANOS - 500000 + RngBelow(&Rng, 1000000);
+        if(RngBelow(&Rng, 1000) == 0) FrameNanos = TickNanos * RngBelow(&Rng, 20);
+        Now += FrameNanos;
+
+        int Due = ClockAdvance(&Clock, Now);
+        Ticks += Due;
+
+        float Alpha = ClockAlpha(&Clock);
+        if(Due > MAX_CATCH_UP || Alpha < 0.0f || Alpha >= 1.0f) Failed = 1;
+    }
+
+    uint64_t Expected = (Now - Start) / TickNanos;
+    if(Ticks + Clock.Dropped != Expected) Failed = 1;
+
+    printf("expected:     %llu\n", (unsigned long long)Expected);
+    PrintClock(&Clock);
+    printf("%s\n", Failed ? "FAILED" : "ok");
+
+    return Failed;
+}
+
+// Plays one game with the bot until it dies or runs out of ticks and
+// saves the recording
+
+int RunRecord(int ArgumentCount, char** Arguments) {
+
+    if(ArgumentCount < 1) {
+        fprintf(stderr, "usage: headless record file [ticks] [seed] [xtiles] [ytiles]\n");
+        return 1;
+    }
+
+    char* Path = Arguments[0];
+    long long Ticks = 1000000;
+    uint64_t Seed = 1;
+    int XTiles = 20;
+    int YTiles = 20;
+
+    if(ArgumentCount > 1) Ticks = atoll(Arguments[1]);
+    if(ArgumentCount > 2) Seed = strtoull(Arguments[2], 0, 10);
+    if(ArgumentCount > 3) XTiles = atoi(Arguments[3]);
+    if(ArgumentCount > 4) YTiles = atoi(Arguments[4]);
+
+    if(XTiles < 1 || XTiles > MAX_TILES || YTiles < 1 || YTiles > MAX_TILES) {
+        fprintf(stderr, "bad board size\n");
+        return 1;
+    }
+
+    game Game;
+    GameInit(&Game, XTiles, YTiles, Seed);
+
+    recording Recording;
+    RecordingBegin(&Recording, &Game);
+
+    while(Game.Running && (long long)Game.Tick < Ticks) {
+        int Direction = GreedyDirection(&Game);
+        if(Direction >= 0 && Direction != Game.Direction) {
+            InputQueueAdd(&Game.InputQueue, Direction);
+        }
+
+        GameUpdate(&Game);
+        RecordingTick(&Recording, &Game);
+    }
+
+    RecordingEnd(&Recording, &Game);
+
+    if(!RecordingSave(&Recording, Path)) {
+        fprintf(stderr, "can't write %s\n", Path);
+        return 1;
+    }
+
+    printf("ticks:        %llu\n", (unsigned long long)Game.Tick);
+    printf("events:       %llu\n", (unsigned long long)Recording.Events);
+    printf("bytes:        %zu\n", Recording.Size);
+    printf("length:       %d\n", Game.TailLength + 1);
+    printf("hash:         %016llx\n", (unsigned long long)GameHash(&Game));
+
+    RecordingFree(&Recording);
+    GameFree(&Game);
+    return 0;
+}
+
+int RunReplay(int ArgumentCount, char** Arguments) {
+
+    if(ArgumentCount < 1) {
+        fprintf(stderr, "usage: headless replay file [repeat]\n");
+        return 1;
+    }
+
+    int Repeat = ArgumentCount > 1 ? atoi(Arguments[1]) : 1;
+
+    recording Recording;
+    if(!RecordingLoad(&Recording, Arguments[0])) {
+        fprintf(stderr, "can't read %s\n", Arguments[0]);
+        return 1;
+    }
+
+    int Result = REPLAY_OK;
+    uint64_t Ticks = 0;
+    uint64_t Hash = 0;
+    uint64_t Start = GetNanoseconds();
+
+    for(int Run = 0; Run < Repeat && Result == REPLAY_OK; ++Run) {
+        game Game;
+        Result = ReplayRun(&Recording, &Game);
+        if(Result != REPLAY_BAD_FILE) {
+            Ticks += Game.Tick;
+            Hash = GameHash(&Game);
+            GameFree(&Game);
+        }
+    }
+
+    double Seconds = (double)(GetNanoseconds() - Start) / 1e9;
+
+    if(Result == REPLAY_BAD_FILE) {
+        fprintf(stderr, "%s is not a recording\n", Arguments[0]);
+    } else {
+        printf("ticks:        %llu\n", (unsigned long long)Ticks);
+        printf("ticks/sec:    %.0f\n", (double)Ticks / Seconds);
+        printf("hash:         %016llx\n", (unsigned long long)Hash);
+        printf("%s\n", Result == REPLAY_OK ? "ok" : "MISMATCH");
+    }
+
+    RecordingFree(&Recording);
+    return Result != REPLAY_OK;
+}
+
+// Steps many games at once. With threads 0 it runs the same batch on
+// 1, 2, 4... up to all cores to show how it scales; the hash must come
+// out the same every time.
+
+int RunBatch(int ArgumentCount, char** Arguments) {
+
+    int Games = 4096;
+    long long Ticks = 2000;
+    int Threads = 0;
+    int XTiles = 20;
+    int YTiles = 20;
+    batchPolicy* Policy = GreedyPolicy;
+
+    if(ArgumentCount > 0) Games = atoi(Arguments[0]);
+    if(ArgumentCount > 1) Ticks = atoll(Arguments[1]);
+    if(ArgumentCount > 2) Threads = atoi(Arguments[2]);
+    if(ArgumentCount > 3) XTiles = atoi(Arguments[3]);
+    if(ArgumentCount > 4) YTiles = atoi(Arguments[4]);
+    if(ArgumentCount > 5 && !strcmp(Arguments[5], "random")) Policy = RandomPolicy;
+
+    if(Games < 1 || Ticks < 1 || Threads < 0 ||
+       XTiles < 1 || XTiles > MAX_TILES || YTiles < 1 || YTiles > MAX_TILES) {
+        fprintf(stderr, "usage: headless batch [games] [ticks] [threads] [xtiles] [ytiles] [greedy|random]\n");
+        return 1;
+    }
+
+    int Cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int FirstThreads = Threads ? Threads : 1;
+    int LastThreads = Threads ? Threads : Cores;
+    double SingleRate = 0.0;
+
+    printf("%d games, %lld ticks each, board %dx%d, %d cores\n", Games, Ticks, XTiles, YTiles, Cores);
+    printf("threads   ticks/sec   scaling   finished   avg score   max length   hash\n");
+
+    for(int ThreadCount = FirstThreads; ThreadCount <= LastThreads; ThreadCount *= 2) {
+        pool Pool;
+        PoolInit(&Pool, ThreadCount);
+
+        batch Batch;
+        BatchInit(&Batch, &Pool, Games, XTiles, YTiles, 1, Policy);
+
+        uint64_t Start = GetNanoseconds();
+        for(long long Done = 0; Done < Ticks; Done += 100) {
+            int Step = Ticks - Done < 100 ? (int)(Ticks - Done) : 100;
+            BatchStep(&Batch, Step);
+        }
+        double Seconds = (double)(GetNanoseconds() - Start) / 1e9;
+
+        batchStats Stats = BatchGetStats(&Batch);
+        double Rate = (double)Stats.Ticks / Seconds;
+        if(ThreadCount == FirstThreads) SingleRate = Rate / FirstThreads;
+
+        printf("%7d %11.0f %8.2fx %10llu %11.2f %12d   %016llx\n",
+               ThreadCount, Rate, Rate / SingleRate,
+               (unsigned long long)Stats.Finished,
+               Stats.Finished ? (double)Stats.ScoreSum / (double)Stats.Finished : 0.0,
+               Stats.MaxLength, (unsigned long long)Stats.Hash);
+
+        BatchFree(&Batch);
+        PoolFree(&Pool);
+
+        if(ThreadCount < LastThreads && ThreadCount * 2 > LastThreads) ThreadCount = LastThreads / 2;
+    }
+
+    return 0;
+}
+
+// Plays the same games with random inputs on plain games and on every
+// lockstep kernel the CPU has. Lanes that finish are checked against
+// their game and restarted, the checksums must all match.
+
+typedef struct {
+    uint64_t Checksum;
+    uint64_t Ticks;
+    uint64_t Nanoseconds;
+} lockstepRun;
+
+void LockstepFillInputs(int8_t* Inputs, rng* Policies, int Count) {
+    for(int Lane = 0; Lane < Count; ++Lane) {
+        Inputs[Lane] = (int8_t)RandomDirection(&Policies[Lane]);
+    }
+}
+
+lockstepRun RunGames(int Count, long long Ticks, int XTiles, int YTiles) {
+    lockstepRun Run = {0};
+    game* Games = malloc(Count * sizeof(game));
+    rng* Policies = malloc(Count * sizeof(rng));
+    int8_t* Inputs = malloc(Count);
+    uint64_t* Seeds = malloc(Count * sizeof(uint64_t));
+    assert(Games && Policies && Inputs && Seeds);
+
+    for(int Lane = 0; Lane < Count; ++Lane) {
+        Seeds[Lane] = 1 + Lane;
+        GameInit(&Games[Lane], XTiles, YTiles, Seeds[Lane]);
+        RngInit(&Policies[Lane], Lane, 0);
+    }
+
+    for(long long Tick = 0; Tick < Ticks; ++Tick) {
+        LockstepFillInputs(Inputs, Policies, Count);
+
+        uint64_t Start = GetNanoseconds();
+        for(int Lane = 0; Lane < Count; ++Lane) {
+            game* Game = &Games[Lane];
+            if(Inputs[Lane] >= 0) InputQueueAdd(&Game->InputQueue, Inputs[Lane]);
+            GameUpdate(Game);
+        }
+        Run.Nanoseconds += GetNanoseconds() - Start;
+
+        for(int Lane = 0; Lane < Count; ++Lane) {
+            game* Game = &Games[Lane];
+            if(!Game->Running) {
+                Run.Checksum += GameHash(Game) * (2 * (uint64_t)Lane + 1);
+                Run.Ticks += Game->Tick;
+                Seeds[Lane] += Count;
+                GameFree(Game);
+                GameInit(Game, XTiles, YTiles, Seeds[Lane]);
+            }
+        }
+    }
+
+    for(int Lane = 0; Lane < Count; ++Lane) {
+        Run.Checksum += GameHash(&Games[Lane]) * (2 * (uint64_t)Lane + 1);
+        Run.Ticks += Games[Lane].Tick;
+        GameFree(&Games[Lane]);
+    }
+
+    free(Games);
+    free(Policies);
+    free(Inputs);
+    free(Seeds);
+    return Run;
+}
+
+lockstepRun RunLockstep(int Kernel, int Count, long long Ticks, int XTiles, int YTiles) {
+    lockstepRun Run = {0};
+    lockstep Lockstep;
+    LockstepInit(&Lockstep, Count, XTiles, YTiles, 1);
+
+    rng* Policies = malloc(Count * sizeof(rng));
+    uint64_t* Seeds = malloc(Count * sizeof(uint64_t));
+    assert(Policies && Seeds);
+
+    for(int Lane = 0; Lane < Count; ++Lane) {
+        Seeds[Lane] = 1 + Lane;
+        RngInit(&Policies[Lane], Lane, 0);
+    }
+
+    for(long long Tick = 0; Tick < Ticks; ++Tick) {
+        LockstepFillInputs(Lockstep.Inputs, Policies, Count);
+
+        uint64_t Start = GetNanoseconds();
+        LockstepStep(&Lockstep, Kernel);
+        Run.Nanoseconds += GetNanoseconds() - Start;
+
+        for(int Lane = 0; Lane < Count; ++Lane) {
+            if(!Lockstep.Running[Lane]) {
+                Run.Checksum += LockstepLaneHash(&Lockstep, Lane) * (2 * (uint64_t)Lane + 1);
+                Run.Ticks += Lockstep.Tick[Lane];
+                Seeds[Lane] += Count;
+                LockstepLaneInit(&Lockstep, Lane, Seeds[Lane]);
+            }
+        }
+    }
+
+    for(int Lane = 0; Lane < Count; ++Lane) {
+        Run.Checksum += LockstepLaneHash(&Lockstep, Lane) * (2 * (uint64_t)Lane + 1);
+        Run.Ticks += Lockstep.Tick[Lane];
+    }
+
+    LockstepFree(&Lockstep);
+    free(Policies);
+    free(Seeds);
+    return Run;
+}
+
+void PrintLockstepRun(char* Name, lockstepRun Run, lockstepRun Reference) {
+    double Seconds = (double)Run.Nanoseconds / 1e9;
+    printf("%-8s %13.0f %10.2fx   %016llx %s\n", Name, (double)Run.Ticks / Seconds,
+           (double)Reference.Nanoseconds / (double)Run.Nanoseconds,
+           (unsigned long long)Run.Checksum,
+           Run.Checksum == Reference.Checksum && Run.Ticks == Reference.Ticks ? "ok" : "MISMATCH");
+}
+
+int RunLockstepTest(int ArgumentCount, char** Arguments) {
+
+    int Games = 4096;
+    long long Ticks = 2000;
+    int XTiles = 20;
+    int YTiles = 20;
+
+    if(ArgumentCount > 0) Games = atoi(Arguments[0]);
+    if(ArgumentCount > 1) Ticks = atoll(Arguments[1]);
+    if(ArgumentCount > 2) XTiles = atoi(Arguments[2]);
+    if(ArgumentCount > 3) YTiles = atoi(Arguments[3]);
+
+    if(Games < 1 || Ticks < 1 || XTiles < 1 || YTiles < 1 ||
+       (XTiles + 2) * (YTiles + 2) > LOCKSTEP_MAX_CELLS) {
+        fprintf(stderr, "usage: headless lockstep [games] [ticks] [xtiles] [ytiles]\n");
+        return 1;
+    }
+
+    printf("%d games, %lld ticks, board %dx%d\n", Games, Ticks, XTiles, YTiles);
+    printf("kernel       ticks/sec    speedup   checksum\n");
+
+    lockstepRun Reference = RunGames(Games, Ticks, XTiles, YTiles);
+    PrintLockstepRun("game", Reference, Reference);
+
+    int Failed = 0;
+    for(int Kernel = 0; Kernel < LOCKSTEP_KERNELS; ++Kernel) {
+        if(!LockstepKernelSupported(Kernel)) {
+            printf("%-8s not supported\n", LockstepKernelNames[Kernel]);
+            continue;
+        }
+        lockstepRun Run = RunLockstep(Kernel, Games, Ticks, XTiles, YTiles);
+        PrintLockstepRun(LockstepKernelNames[Kernel], Run, Reference);
+        if(Run.Checksum != Reference.Checksum || Run.Ticks != Reference.Ticks) Failed = 1;
+    }
+
+    return Failed;
+}
+
+// Checks the observations against a cell by cell version on every
+// widening kernel, then times stepping and observing separately. Each
+// kernel is the one EnvInit picks on some CPU, so none may be slower
+// than the table, give or take 10% for noise.
+
+void ReferenceObserve(env* Env, game* Game, uint8_t* Out) {
+    int Plane = Env->Width * Env->Height;
+    uint32_t Head = GetPieceCell(Game, 0);
+    int X0 = Env->Window ? CellX(Game, Head) - Env->Window / 2 : 0;
+    int Y0 = Env->Window ? CellY(Game, Head) - Env->Window / 2 : 0;
+
+    for(int Row = 0; Row < Env->Height; ++Row) {
+        for(int Column = 0; Column < Env->Width; ++Column) {
+            int X = X0 + Column;
+            int Y = Y0 + Row;
+            int Index = Row * Env->Width + Column;
+            int OnBoard = X >= 0 && X < Env->XTiles && Y >= 0 && Y < Env->YTiles;
+            uint32_t Cell = OnBoard ? CellIndex(Game, X, Y) : NO_CELL;
+            Out[ENV_PLANE_OCCUPIED * Plane + Index] = OnBoard ? IsCellBlocked(Game, Cell) : 1;
+            Out[ENV_PLANE_HEAD * Plane + Index] = OnBoard && Cell == Head;
+            Out[ENV_PLANE_FOOD * Plane + Index] = OnBoard && Cell == Game->Food;
+        }
+    }
+}
+
+int RunEnv(int ArgumentCount, char** Arguments) {
+
+    int Games = 1024;
+    int Steps = 1000;
+    int Window = 0;
+    int Threads = 1;
+    int XTiles = 20;
+    int YTiles = 20;
+
+    if(ArgumentCount > 0) Games = atoi(Arguments[0]);
+    if(ArgumentCount > 1) Steps = atoi(Arguments[1]);
+    if(ArgumentCount > 2) Window = atoi(Arguments[2]);
+    if(ArgumentCount > 3) Threads = atoi(Arguments[3]);
+    if(ArgumentCount > 4) XTiles = atoi(Arguments[4]);
+    if(ArgumentCount > 5) YTiles = atoi(Arguments[5]);
+
+    if(Games < 1 || Steps < 1 || Window < 0 || (Window && Window % 2 == 0) || Threads < 1 ||
+       XTiles < 1 || XTiles > MAX_TILES || YTiles < 1 || YTiles > MAX_TILES) {
+        fprintf(stderr, "usage: headless env [games] [steps] [window] [threads] [xtiles] [ytiles]\n");
+        return 1;
+    }
+
+    pool Pool;
+    PoolInit(&Pool, Threads);
+
+    env Env;
+    EnvInit(&Env, &Pool, Games, XTiles, YTiles, Window, 1);
+    int Picked = Env.Kernel;
+    int Slower = 0;
+
+    size_t Size = EnvObservationSize(&Env);
+    int32_t* Actions = malloc(Games * sizeof(int32_t));
+    float* Rewards = malloc(Games * sizeof(float));
+    uint8_t* Dones = malloc(Games);
+    uint8_t* Observations = malloc(Games * Size);
+    uint8_t* Reference = malloc(Size);
+    assert(Actions && Rewards && Dones && Observations && Reference);
+
+    printf("%d games, %d steps, observation %dx%dx%d, %d threads\n",
+           Games, Steps, ENV_PLANES, Env.Height, Env.Width, Threads);
+
+    uint64_t StepNanos = 0;
+    uint64_t ObserveNanos[EXPAND_KERNELS] = {0};
+    uint64_t Mismatches = 0;
+    uint64_t Episodes = 0;
+    double RewardSum = 0.0;
+
+    for(int Step = 0; Step < Steps; ++Step) {
+        for(int Index = 0; Index < Games; ++Index) {
+            Actions[Index] = GreedyDirection(&Env.Slots[Index].Game);
+        }
+
+        uint64_t Start = GetNanoseconds();
+        EnvStep(&Env, Actions, Rewards, Dones, 0);
+        StepNanos += GetNanoseconds() - Start;
+
+        for(int Index = 0; Index < Games; ++Index) {
+            RewardSum += Rewards[Index];
+            if(Dones[Index]) ++Episodes;
+        }
+
+        for(int Kernel = 0; Kernel < EXPAND_KERNELS; ++Kernel) {
+            if(!ExpandKernelSupported(Kernel)) continue;
+            Env.Kernel = Kernel;
+            memset(Observations, 0xff, Games * Size);
+
+            Start = GetNanoseconds();
+            EnvObserve(&Env, Observations);
+            ObserveNanos[Kernel] += GetNanoseconds() - Start;
+
+            for(int Index = 0; Index < Games; ++Index) {
+                ReferenceObserve(&Env, &Env.Slots[Index].Game, Reference);
+                if(memcmp(Reference, Observations + Index * Size, Size)) ++Mismatches;
+            }
+        }
+    }
+
+    double StepSeconds = (double)StepNanos / 1e9;
+    double Total = (double)Games * Steps;
+    printf("step:         %.0f steps/sec\n", Total / StepSeconds);
+    printf("episodes:     %llu, mean reward %.3f\n", (unsigned long long)Episodes, RewardSum / Total);
+
+    for(int Kernel = 0; Kernel < EXPAND_KERNELS; ++Kernel) {
+        if(!ExpandKernelSupported(Kernel)) {
+            printf("%-13s not supported\n", ExpandKernelNames[Kernel]);
+            continue;
+        }
+        double Seconds = (double)ObserveNanos[Kernel] / 1e9;
+        int Slow = ObserveNanos[Kernel] > ObserveNanos[EXPAND_TABLE] * 1.1;
+        Slower |= Slow;
+        printf("%-13s %.0f observations/sec, %.0f MB/s%s%s\n", ExpandKernelNames[Kernel],
+               Total / Seconds, Total * Size / Seconds / 1e6, Kernel == Picked ? ", picked" : "",
+               Slow ? ", slower than the table" : "");
+    }
+
+    printf("%s\n", Mismatches ? "MISMATCH" : (Slower ? "SLOWER THAN TABLE" : "ok"));
+
+    free(Actions);
+    free(Rewards);
+    free(Dones);
+    free(Observations);
+    free(Reference);
+    EnvFree(&Env);
+    PoolFree(&Pool);
+    return Mismatches != 0 || Slower;
+}
+
+// Plays games with the autopilot back to back
+
+int RunAutopilot(int ArgumentCount, char** Arguments) {
+
+    long long Ticks = 1000000;
+    int XTiles = 100;
+    int YTiles = 100;
+    int Budget = 4096;
+    uint64_t Seed = 1;
+
+    if(ArgumentCount > 0) Ticks = atoll(Arguments[0]);
+    if(ArgumentCount > 1) XTiles = atoi(Arguments[1]);
+    if(ArgumentCount > 2) YTiles = atoi(Arguments[2]);
+    if(ArgumentCount > 3) Budget = atoi(Arguments[3]);
+    if(ArgumentCount > 4) Seed = strtoull(Arguments[4], 0, 10);
+
+    if(Ticks < 1 || Budget < 1 ||
+       XTiles < 1 || XTiles > MAX_TILES || YTiles < 1 || YTiles > MAX_TILES) {
+        fprintf(stderr, "usage: headless autopilot [ticks] [xtiles] [ytiles] [budget] [seed]\n");
+        return 1;
+    }
+
+    game Game;
+    GameInit(&Game, XTiles, YTiles, Seed);
+
+    autopilot Autopilot;
+    AutopilotInit(&Autopilot, &Game, Budget);
+
+    long long Games = 0;
+    long long TotalLength = 0;
+    int MaxLength = 0;
+    uint64_t Start = GetNanoseconds();
+
+    for(long long Tick = 0; Tick < Ticks; ++Tick) {
+        int Direction = AutopilotDirection(&Autopilot, &Game);
+        if(Direction >= 0) InputQueueAdd(&Game.InputQueue, Direction);
+
+        GameUpdate(&Game);
+
+        int Full = Game.Food == NO_FOOD;
+        if(!Game.Running || Full) {
+            int Length = Game.TailLength + 1;
+            ++Games;
+            TotalLength += Length;
+            if(Length > MaxLength) MaxLength = Length;
+            if(Full) printf("filled the board at tick %llu\n", (unsigned long long)Game.Tick);
+
+            GameFree(&Game);
+            GameInit(&Game, XTiles, YTiles, ++Seed);
+        }
+    }
+
+    double Seconds = (double)(GetNanoseconds() - Start) / 1e9;
+    int Length = Game.TailLength + 1;
+    if(Length > MaxLength) MaxLength = Length;
+
+    printf("board:        %dx%d, budget %d\n", XTiles, YTiles, Budget);
+    printf("decisions:    %llu\n", (unsigned long long)Autopilot.Decisions);
+    printf("decisions/s:  %.0f\n", (double)Autopilot.Decisions / Seconds);
+    printf("games:        %lld\n", Games);
+    printf("avg length:   %.1f\n", Games ? (double)TotalLength / (double)Games : 0.0);
+    printf("max length:   %d\n", MaxLength);
+    printf("current:      %d\n", Length);
+    printf("rebuilds:     %llu\n", (unsigned long long)Autopilot.Rebuilds);
+    printf("relaxed:      %llu cells\n", (unsigned long long)Autopilot.Relaxed);
+    printf("flooded:      %llu cells\n", (unsigned long long)Autopilot.Flooded);
+    printf("cornered:     %llu\n", (unsigned long long)Autopilot.Cornered);
+
+    AutopilotFree(&Autopilot);
+    GameFree(&Game);
+    return 0;
+}
+
+// Fills the board with the Hamiltonian solver, the ticks after the
+// snake covers 90% of it are timed on their own
+
+int RunHamilton(int ArgumentCount, char** Arguments) {
+
+    int XTiles = 100;
+    int YTiles = 100;
+    long long MaxTicks = 0;
+    uint64_t Seed = 1;
+
+    if(ArgumentCount > 0) XTiles = atoi(Arguments[0]);
+    if(ArgumentCount > 1) YTiles = atoi(Arguments[1]);
+    if(ArgumentCount > 2) MaxTicks = atoll(Arguments[2]);
+    if(ArgumentCount > 3) Seed = strtoull(Arguments[3], 0, 10);
+
+    if(XTiles < 1 || XTiles > MAX_TILES || YTiles < 1 || YTiles > MAX_TILES ||
+       !HamiltonSupported(XTiles, YTiles) || MaxTicks < 0) {
+        fprintf(stderr, "usage: headless hamilton [xtiles] [ytiles] [max ticks] [seed]\n");
+        fprintf(stderr, "the board needs at least 2x2 tiles and an even side\n");
+        return 1;
+    }
+
+    game Game;
+    GameInit(&Game, XTiles, YTiles, Seed);
+
+    hamilton Hamilton;
+    uint64_t Start = GetNanoseconds();
+    HamiltonInit(&Hamilton, &Game);
+    double BuildSeconds = (double)(GetNanoseconds() - Start) / 1e9;
+
+    // Every step of the tour has to be to a neighbor
+
+    uint32_t* Tour = malloc(Hamilton.Length * sizeof(uint32_t));
+    assert(Tour);
+    for(int Y = 0; Y < YTiles; ++Y) {
+        for(int X = 0; X < XTiles; ++X) {
+            uint32_t Cell = CellIndex(&Game, X, Y);
+            Tour[Hamilton.Order[Cell]] = Cell;
+        }
+    }
+    int Broken = 0;
+    for(int Index = 0; Index < Hamilton.Length; ++Index) {
+        uint32_t Cell = Tour[Index];
+        uint32_t Next = Tour[(Index + 1) % Hamilton.Length];
+        int Adjacent = 0;
+        for(int Direction = 0; Direction < KEYSAMOUNT; ++Direction) {
+            if(Cell + Game.Steps[Direction] == Next) Adjacent = 1;
+        }
+        if(!Adjacent) ++Broken;
+    }
+    free(Tour);
+
+    printf("board:        %dx%d\n", XTiles, YTiles);
+    printf("tour:         %.3f ms, %s\n", BuildSeconds * 1e3, Broken ? "BROKEN" : "ok");
+
+    int LongLength = (int)((long long)Hamilton.Length * 9 / 10);
+    uint64_t LongStart = 0;
+    uint64_t LongTick = 0;
+
+    Start = GetNanoseconds();
+    while(Game.Running && Game.Food != NO_FOOD && (!MaxTicks || (long long)Game.Tick < MaxTicks)) {
+        if(!LongStart && Game.BodyLength >= LongLength) {
+            LongStart = GetNanoseconds();
+            LongTick = Game.Tick;
+        }
+
+        int Direction = HamiltonDirection(&Hamilton, &Game);
+        if(Direction >= 0) InputQueueAdd(&Game.InputQueue, Direction);
+        GameUpdate(&Game);
+    }
+    uint64_t End = GetNanoseconds();
+    double Seconds = (double)(End - Start) / 1e9;
+
+    char* Result = !Game.Running ? "DIED" : (Game.Food == NO_FOOD ? "filled" : "stopped");
+    printf("result:       %s at length %d of %d\n", Result, Game.BodyLength, Hamilton.Length);
+    printf("ticks:        %llu (%.2f per tile)\n", (unsigned long long)Game.Tick,
+           (double)Game.Tick / Hamilton.Length);
+    printf("shortcuts:    %llu\n", (unsigned long long)Hamilton.Shortcuts);
+    printf("ticks/sec:    %.0f\n", (double)Game.Tick / Seconds);
+    if(LongStart && End > LongStart) {
+        printf("above 90%%:    %llu ticks, %.0f ticks/sec\n", (unsigned long long)(Game.Tick - LongTick),
+               (double)(Game.Tick - LongTick) / ((double)(End - LongStart) / 1e9));
+    }
+
+    int Failed = Broken || !Game.Running;
+    HamiltonFree(&Hamilton);
+    GameFree(&Game);
+    return Failed;
+}
+
+// Rebuilds the board from the snakes and compares, returns the number of
+// cells that don't match
+
+int ArenaCheck(arena* Arena) {
+    int Words = (Arena->Cells + 63) / 64;
+    uint64_t* Expected = calloc(Words, sizeof(uint64_t));
+    assert(Expected);
+    int Errors = 0;
+
+    for(int Y = 0; Y < Arena->YTiles + 2; ++Y) {
+        for(int X = 0; X < Arena->Stride; ++X) {
+            if(X == 0 || Y == 0 || X == Arena->XTiles + 1 || Y == Arena->YTiles + 1) {
+                ArenaSet(Expected, Y * Arena->Stride + X);
+            }
+        }
+    }
+
+    int Food = 0;
+    for(int Index = 0; Index < Arena->SnakeCount; ++Index) {
+        arenaSnake* Snake = &Arena->Snakes[Index];
+        for(int Piece = 0; Piece < Snake->BodyLength; ++Piece) {
+            uint32_t Cell = ArenaGetPieceCell(Snake, Piece);
+            if(ArenaTest(Expected, Cell)) ++Errors; // Overlap
+            ArenaSet(Expected, Cell);
+        }
+    }
+
+    for(uint32_t Cell = 0; Cell < (uint32_t)Arena->Cells; ++Cell) {
+        if(ArenaTest(Expected, Cell) != ArenaTest(Arena->Occupied, Cell)) ++Errors;
+        if(ArenaTest(Arena->Food, Cell)) {
+            ++Food;
+            if(ArenaTest(Arena->Occupied, Cell)) ++Errors;
+        }
+        if(ArenaTest(Arena->Claimed, Cell) || ArenaTest(Arena->Contested, Cell)) ++Errors;
+        if(Arena->HeadOwner[Cell] != -1) ++Errors;
+    }
+    if(Food != Arena->FoodCount) ++Errors;
+
+    free(Expected);
+    return Errors;
+}
+
+int RunArena(int ArgumentCount, char** Arguments) {
+
+    int Snakes = 4096;
+    long long Ticks = 2000;
+    int XTiles = 1000;
+    int YTiles = 1000;
+    int Food = 8192;
+    uint64_t Seed = 1;
+
+    if(ArgumentCount > 0) Snakes = atoi(Arguments[0]);
+    if(ArgumentCount > 1) Ticks = atoll(Arguments[1]);
+    if(ArgumentCount > 2) XTiles = atoi(Arguments[2]);
+    if(ArgumentCount > 3) YTiles = atoi(Arguments[3]);
+    if(ArgumentCount > 4) Food = atoi(Arguments[4]);
+    if(ArgumentCount > 5) Seed = strtoull(Arguments[5], 0, 10);
+
+    if(Snakes < 1 || Ticks < 1 || Food < 0 ||
+       XTiles < 1 || XTiles > MAX_TILES || YTiles < 1 || YTiles > MAX_TILES) {
+        fprintf(stderr, "usage: headless arena [snakes] [ticks] [xtiles] [ytiles] [food] [seed]\n");
+        return 1;
+    }
+
+    arena Arena;
+    ArenaInit(&Arena, XTiles, YTiles, Snakes, Food, Seed);
+    ArenaPopulate(&Arena);
+
+    rng Bots;
+    RngInit(&Bots, Seed, 0);
+
+    uint64_t BotNanos = 0;
+    uint64_t UpdateNanos = 0;
+    int Errors = 0;
+
+    for(long long Tick = 0; Tick < Ticks; ++Tick) {
+        uint64_t Start = GetNanoseconds();
+        for(int Index = 0; Index < Snakes; ++Index) {
+            Arena.Inputs[Index] = (int8_t)ArenaBotDirection(&Arena, Index, &Bots);
+        }
+        uint64_t Middle = GetNanoseconds();
+        ArenaUpdate(&Arena);
+        uint64_t End = GetNanoseconds();
+
+        BotNanos += Middle - Start;
+        UpdateNanos += End - Middle;
+
+        if(Tick % 500 == 0) Errors += ArenaCheck(&Arena);
+    }
+    Errors += ArenaCheck(&Arena);
+
+    int Longest = 0;
+    long long TotalLength = 0;
+    for(int Index = 0; Index < Snakes; ++Index) {
+        int Length = Arena.Snakes[Index].BodyLength;
+        TotalLength += Length;
+        if(Length > Longest) Longest = Length;
+    }
+
+    double Seconds = (double)UpdateNanos / 1e9;
+    printf("board:        %dx%d, %d snakes, %d food\n", XTiles, YTiles, Snakes, Food);
+    printf("moves:        %llu\n", (unsigned long long)Arena.Moves);
+    printf("moves/sec:    %.0f\n", (double)Arena.Moves / Seconds);
+    printf("tick:         %.1f us, bots %.1f us\n", UpdateNanos / 1e3 / Ticks, BotNanos / 1e3 / Ticks);
+    printf("eaten:        %llu\n", (unsigned long long)Arena.Eaten);
+    printf("deaths:       %llu body, %llu head-on, %llu swap\n", (unsigned long long)Arena.HitBody,
+           (unsigned long long)Arena.HeadOn, (unsigned long long)Arena.Swaps);
+    printf("length:       %.1f average, %d longest\n", (double)TotalLength / Snakes, Longest);
+    printf("%s\n", Errors ? "BOARD MISMATCH" : "ok");
+
+    ArenaFree(&Arena);
+    return Errors != 0;
+}
+
+// Multiplayer
+
+// A few hundred connections on loopback is two descriptors each
+
+void RaiseFileLimit() {
+    struct rlimit Limit;
+    if(getrlimit(RLIMIT_NOFILE, &Limit) == 0 && Limit.rlim_cur < Limit.rlim_max) {
+        Limit.rlim_cur = Limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &Limit);
+    }
+}
+
+// Runs Ticks ticks on time, handling the network in between
+
+void ServeTicks(netServer* Server, uint64_t Ticks, uint64_t TickNanos) {
+    fixedClock Clock;
+    ClockInit(&Clock, GetNanoseconds(), TickNanos);
+
+    uint64_t Done = 0;
+    while(Done < Ticks) {
+        uint64_t Now = GetNanoseconds();
+        uint64_t Next = ClockNextTick(&Clock);
+        int Timeout = Next > Now ? (int)((Next - Now + 999999) / 1000000) : 0;
+        NetServerPoll(Server, Timeout);
+
+        int Due = ClockAdvance(&Clock, GetNanoseconds());
+        for(int Tick = 0; Tick < Due && Done < Ticks; ++Tick, ++Done) {
+            NetServerTick(Server);
+            NetServerBroadcast(Server, GetNanoseconds());
+        }
+    }
+}
+
+void PrintServer(netServer* Server, double Seconds) {
+    printf("connections:  %d open, %llu joined, %llu dropped\n", Server->Clients,
+           (unsigned long long)Server->Joins, (unsigned long long)Server->Drops);
+    printf("ticks:        %llu, %.1f delta bytes/tick for %d snakes\n", (unsigned long long)Server->Broadcasts,
+           Server->Broadcasts ? (double)Server->SharedBytes / Server->Broadcasts : 0.0, Server->Arena.SnakeCount);
+    printf("server sent:  %.1f KB/s\n", Server->BytesSent / 1024.0 / Seconds);
+    printf("inputs:       %llu, %llu lost\n", (unsigned long long)Server->Inputs,
+           (unsigned long long)Server->InputsLost);
+}
+
+// Scripted clients: every tick each one may turn the way a bot would,
+// then predicts its head. Runs until every client got BYE or failed,
+// returns the number that failed.
+
+int PlayClients(netClient* Clients, int Count, uint64_t Seed) {
+    struct pollfd* Polls = calloc(Count, sizeof(struct pollfd));
+    int* PollClient = calloc(Count, sizeof(int));
+    uint64_t* SeenTick = calloc(Count, sizeof(uint64_t));
+    assert(Polls && PollClient && SeenTick);
+
+    rng Rng;
+    RngInit(&Rng, Seed, 1);
+    int Failed = 0;
+
+    for(;;) {
+        int PollCount = 0;
+        for(int Index = 0; Index < Count; ++Index) {
+            netClient* Client = &Clients[Index];
+            if(Client->Socket < 0 || Client->Done) continue;
+            PollClient[PollCount] = Index;
+            Polls[PollCount++] = (struct pollfd){Client->Socket, POLLIN, 0};
+        }
+        if(!PollCount) break;
+
+        // Nothing for 10 seconds, the server is gone
+
+        if(poll(Polls, PollCount, 10000) == 0) {
+            for(int Poll = 0; Poll < PollCount; ++Poll) {
+                netClient* Client = &Clients[PollClient[Poll]];
+                close(Client->Socket);
+                Client->Socket = -1;
+                ++Failed;
+            }
+            break;
+        }
+
+        for(int Poll = 0; Poll < PollCount; ++Poll) {
+            if(!Polls[Poll].revents) continue;
+            int Index = PollClient[Poll];
+            netClient* Client = &Clients[Index];
+            uint64_t Now = GetNanoseconds();
+
+            int Alive = NetClientReceive(Client, Now);
+            if(Alive && Client->Joined && !Client->Done && Client->Mirror.Tick != SeenTick[Index]) {
+                SeenTick[Index] = Client->Mirror.Tick;
+                if(RngBelow(&Rng, 4) == 0) {
+                    int Direction = ArenaBotDirection(&Client->Mirror, Client->Snake, &Rng);
+                    if(Direction >= 0) Alive = NetClientSendInput(Client, Direction, Now);
+                }
+                NetClientPredict(Client);
+            }
+
+            if(!Alive) {
+                close(Client->Socket);
+                Client->Socket = -1;
+                ++Failed;
+            }
+        }
+    }
+
+    free(Polls);
+    free(PollClient);
+    free(SeenTick);
+    return Failed;
+}
+
+// Returns the number of mirrors that don't add up
+
+int PrintClients(netClient* Clients, int Count, int Failed, double Seconds) {
+    uint64_t BytesReceived = 0;
+    uint64_t BytesSent = 0;
+    uint64_t Ticks = 0;
+    uint64_t TickNanos = 0;
+    uint64_t TickNanosMax = 0;
+    uint64_t Acked = 0;
+    uint64_t InputNanos = 0;
+    uint64_t InputNanosMax = 0;
+    uint64_t Predictions = 0;
+    uint64_t Mispredictions = 0;
+    int Bad = 0;
+
+    for(int Index = 0; Index < Count; ++Index) {
+        netClient* Client = &Clients[Index];
+        BytesReceived += Client->BytesReceived;
+        BytesSent += Client->BytesSent;
+        Ticks += Client->Ticks;
+        TickNanos += Client->TickNanos;
+        Acked += Client->Acked;
+        InputNanos += Client->InputNanos;
+        Predictions += Client->Predictions;
+        Mispredictions += Client->Mispredictions;
+        if(Client->TickNanosMax > TickNanosMax) TickNanosMax = Client->TickNanosMax;
+        if(Client->InputNanosMax > InputNanosMax) InputNanosMax = Client->InputNanosMax;
+        if(Client->Joined && ArenaCheck(&Client->Mirror)) ++Bad;
+    }
+
+    printf("clients:      %d, %d failed\n", Count, Failed);
+    printf("down:         %.0f bytes/s per client, %.1f bytes/tick\n", BytesReceived / Seconds / Count,
+           Ticks ? (double)BytesReceived / Ticks : 0.0);
+    printf("up:           %.0f bytes/s per client\n", BytesSent / Seconds / Count);
+    printf("tick latency: %.0f us average, %.0f us max\n", Ticks ? TickNanos / 1e3 / Ticks : 0.0,
+           TickNanosMax / 1e3);
+    printf("input lag:    %.1f ms average, %.1f ms max, %llu inputs\n", Acked ? InputNanos / 1e6 / Acked : 0.0,
+           InputNanosMax / 1e6, (unsigned long long)Acked);
+    printf("mispredicted: %llu of %llu\n", (unsigned long long)Mispredictions, (unsigned long long)Predictions);
+    return Bad;
+}
+
+int RunServer(int ArgumentCount, char** Arguments) {
+
+    int Port = 7777;
+    double Seconds = 60;
+    int Hz = 20;
+    int Snakes = 512;
+    int XTiles = 256;
+    int YTiles = 256;
+    int Food = 512;
+
+    if(ArgumentCount > 0) Port = atoi(Arguments[0]);
+    if(ArgumentCount > 1) Seconds = atof(Arguments[1]);
+    if(ArgumentCount > 2) Hz = atoi(Arguments[2]);
+    if(ArgumentCount > 3) Snakes = atoi(Arguments[3]);
+    if(ArgumentCount > 4) XTiles = atoi(Arguments[4]);
+    if(ArgumentCount > 5) YTiles = atoi(Arguments[5]);
+    if(ArgumentCount > 6) Food = atoi(Arguments[6]);
+
+    if(Port < 0 || Port > 65535 || Seconds <= 0 || Hz < 1 || Snakes < 1 || Food < 0 ||
+       XTiles < 1 || XTiles > MAX_TILES || YTiles < 1 || YTiles > MAX_TILES) {
+        fprintf(stderr, "usage: headless server [port] [seconds] [tick hz] [snakes] [xtiles] [ytiles] [food]\n");
+        return 1;
+    }
+
+    RaiseFileLimit();
+
+    netServer Server;
+    if(!NetServerInit(&Server, Port, XTiles, YTiles, Snakes, Food, 1)) {
+        perror("server");
+        return 1;
+    }
+    printf("listening:    port %d, %dx%d, %d snakes\n", Server.Port, XTiles, YTiles, Snakes);
+    fflush(stdout);
+
+    ServeTicks(&Server, (uint64_t)(Seconds * Hz), 1000000000ull / Hz);
+    NetServerBye(&Server, 1000);
+    PrintServer(&Server, Seconds);
+
+    NetServerFree(&Server);
+    return 0;
+}
+
+int RunClients(int ArgumentCount, char** Arguments) {
+
+    char* Host = "127.0.0.1";
+    int Port = 7777;
+    int Count = 256;
+    uint64_t Seed = 1;
+
+    if(ArgumentCount > 0) Host = Arguments[0];
+    if(ArgumentCount > 1) Port = atoi(Arguments[1]);
+    if(ArgumentCount > 2) Count = atoi(Arguments[2]);
+    if(ArgumentCount > 3) Seed = strtoull(Arguments[3], 0, 10);
+
+    if(Port < 1 || Port > 65535 || Count < 1) {
+        fprintf(stderr, "usage: headless clients [host] [port] [count] [seed]\n");
+        return 1;
+    }
+
+    RaiseFileLimit();
+
+    netClient* Clients = calloc(Count, sizeof(netClient));
+    assert(Clients);
+    int Failed = 0;
+    for(int Index = 0; Index < Count; ++Index) {
+        if(!NetClientConnect(&Clients[Index], Host, Port)) ++Failed;
+    }
+
+    uint64_t Start = GetNanoseconds();
+    Failed += PlayClients(Clients, Count, Seed);
+    double Seconds = (GetNanoseconds() - Start) / 1e9;
+
+    int Bad = PrintClients(Clients, Count, Failed, Seconds);
+    printf("%s\n", Bad ? "MIRROR MISMATCH" : "ok");
+
+    for(int Index = 0; Index < Count; ++Index) {
+        NetClientFree(&Clients[Index]);
+    }
+    free(Clients);
+    return Failed || Bad;
+}
+
+typedef struct {
+    netServer* Server;
+    uint64_t Ticks;
+    uint64_t TickNanos;
+} serveJob;
+
+void* ServeThread(void* Argument) {
+    serveJob* Job = Argument;
+    ServeTicks(Job->Server, Job->Ticks, Job->TickNanos);
+    NetServerBye(Job->Server, 5000);
+    return 0;
+}
+
+// Server on a thread and scripted clients on loopback. At the end every
+// client's mirror has to match the server's arena.
+
+int RunNetTest(int ArgumentCount, char** Arguments) {
+
+    int Count = 256;
+    double Seconds = 10;
+    int Hz = 20;
+    int Snakes = 512;
+    int XTiles = 256;
+    int YTiles = 256;
+    int Food = 512;
+
+    if(ArgumentCount > 0) Count = atoi(Arguments[0]);
+    if(ArgumentCount > 1) Seconds = atof(Arguments[1]);
+    if(ArgumentCount > 2) Hz = atoi(Arguments[2]);
+    if(ArgumentCount > 3) Snakes = atoi(Arguments[3]);
+    if(ArgumentCount > 4) XTiles = atoi(Arguments[4]);
+    if(ArgumentCount > 5) YTiles = atoi(Arguments[5]);
+    if(ArgumentCount > 6) Food = atoi(Arguments[6]);
+
+    if(Count < 1 || Seconds <= 0 || Hz < 1 || Snakes < Count || Food < 0 ||
+       XTiles < 1 || XTiles > MAX_TILES || YTiles < 1 || YTiles > MAX_TILES) {
+        fprintf(stderr, "usage: headless nettest [clients] [seconds] [tick hz] [snakes] [xtiles] [ytiles] [food]\n");
+        return 1;
+    }
+
+    RaiseFileLimit();
+
+    netServer Server;
+    if(!NetServerInit(&Server, 0, XTiles, YTiles, Snakes, Food, 1)) {
+        perror("server");
+        return 1;
+    }
+
+    serveJob Job = {&Server, (uint64_t)(Seconds * Hz), 1000000000ull / Hz};
+    pthread_t Thread;
+    pthread_create(&Thread, 0, ServeThread, &Job);
+
+    netClient* Clients = calloc(Count, sizeof(netClient));
+    assert(Clients);
+    int Failed = 0;
+    for(int Index = 0; Index < Count; ++Index) {
+        if(!NetClientConnect(&Clients[Index], "127.0.0.1", Server.Port)) ++Failed;
+    }
+
+    uint64_t Start = GetNanoseconds();
+    Failed += PlayClients(Clients, Count, 1);
+    double Elapsed = (GetNanoseconds() - Start) / 1e9;
+    pthread_join(Thread, 0);
+
+    printf("board:        %dx%d, %d snakes, %d food, %d Hz\n", XTiles, YTiles, Snakes, Food, Hz);
+    PrintServer(&Server, Seconds);
+    int Bad = PrintClients(Clients, Count, Failed, Elapsed);
+
+    uint64_t Expected = ArenaHash(&Server.Arena);
+    for(int Index = 0; Index < Count; ++Index) {
+        netClient* Client = &Clients[Index];
+        if(Client->Done && ArenaHash(&Client->Mirror) != Expected) ++Bad;
+    }
+    printf("%s\n", Failed || Bad ? "MIRROR MISMATCH" : "ok");
+
+    for(int Index = 0; Index < Count; ++Index) {
+        NetClientFree(&Clients[Index]);
+    }
+    free(Clients);
+    NetServerFree(&Server);
+    return Failed || Bad;
+}
+
+// Input latency: a thread plays a player who turns in quick pairs,
+// sometimes hits the same key twice and sometimes straight back. The main thread runs frames at 60 Hz
+// and ticks like the window does. Every policy gets the same player.
+
+typedef struct {
+    inputRing* Ring;
+    atomic_int Stop;
+    uint64_t IntervalNanos;
+    uint64_t Seed;
+} inputPlayer;
+
+void* InputPlayerThread(void* Argument) {
+    inputPlayer* Player = Argument;
+    rng Rng;
+    RngInit(&Rng, Player->Seed, 0);
+    int Heading = RIGHT;
+
+    while(!atomic_load(&Player->Stop)) {
+        int Turn = (Heading + 1 + 2 * (int)RngBelow(&Rng, 2)) % KEYSAMOUNT;
+        if(RngBelow(&Rng, 8) == 0) InputRingPush(Player->Ring, Heading ^ 2, GetNanoseconds());
+        InputRingPush(Player->Ring, Turn, GetNanoseconds());
+        if(RngBelow(&Rng, 4) == 0) InputRingPush(Player->Ring, Turn, GetNanoseconds());
+
+        // Half the time the second key of a U turn follows right away
+
+        if(RngBelow(&Rng, 2) == 0) {
+            struct timespec Gap = {0, 5000000};
+            nanosleep(&Gap, 0);
+            Heading ^= 2;
+            InputRingPush(Player->Ring, Heading, GetNanoseconds());
+        } else {
+            Heading = Turn;
+        }
+
+        struct timespec Sleep = {
+            (time_t)(Player->IntervalNanos / 1000000000ull),
+            (long)(Player->IntervalNanos % 1000000000ull),
+        };
+        nanosleep(&Sleep, 0);
+    }
+    return 0;
+}
+
+void GetPolicyName(int Policy, char* Name, size_t Size) {
+    snprintf(Name, Size, "%s%s%s%s", Policy ? "" : "none",
+             Policy & INPUT_COALESCE ? "coalesce " : "",
+             Policy & INPUT_REJECT_OPPOSITE ? "reject " : "",
+             Policy & INPUT_DROP_OLDEST ? "oldest" : "");
+}
+
+int RunInputTest(int ArgumentCount, char** Arguments) {
+
+    double Seconds = 2.0;
+    double TurnsPerSecond = 10.0;
+    int Delay = -1; // DelayMin
+
+    if(ArgumentCount > 0) Seconds = atof(Arguments[0]);
+    if(ArgumentCount > 1) TurnsPerSecond = atof(Arguments[1]);
+    if(ArgumentCount > 2) Delay = atoi(Arguments[2]);
+
+    if(Seconds <= 0.0 || TurnsPerSecond <= 0.0 || Delay < -1) {
+        fprintf(stderr, "usage: headless input [seconds] [turns per second] [delay]\n");
+        return 1;
+    }
+
+    printf("policy                 keys  queued  merged  reject  drop   tick p50/p99/max ms  present p50/p99 ms\n");
+
+    for(int Policy = 0; Policy < INPUT_POLICIES; ++Policy) {
+        static inputRing Ring;
+        InputRingInit(&Ring);
+        inputMetrics Metrics = {0};
+
+        // Games start with a tail so going straight back counts
+
+        uint64_t Seed = 1;
+        game Game;
+        GameInit(&Game, 20, 20, Seed);
+        GrowSnake(&Game);
+        if(Delay < 0) Delay = Game.DelayMin;
+        Game.Delay = Delay;
+
+        inputPlayer Player = {.Ring = &Ring, .IntervalNanos = (uint64_t)(1e9 / TurnsPerSecond), .Seed = 1};
+        atomic_init(&Player.Stop, 0);
+        pthread_t Thread;
+        pthread_create(&Thread, 0, InputPlayerThread, &Player);
+
+        fixedClock Clock;
+        uint64_t Start = GetNanoseconds();
+        uint64_t End = Start + (uint64_t)(Seconds * 1e9);
+        uint64_t Frame = Start;
+        ClockInit(&Clock, Start, GetTickNanos(Game.Delay));
+
+        while(Frame < End) {
+            Frame += FRAME_NANOS;
+            WaitUntil(Frame);
+
+            int Ticks = ClockAdvance(&Clock, GetNanoseconds());
+            for(int Tick = 0; Tick < Ticks; ++Tick) {
+                InputDrain(&Ring, &Game, Policy, &Metrics);
+                GameUpdate(&Game);
+                InputMetricsTick(&Metrics, &Game, GetNanoseconds());
+
+                if(!Game.Running) {
+                    GameFree(&Game);
+                    GameInit(&Game, 20, 20, ++Seed);
+                    GrowSnake(&Game);
+                }
+                Game.Delay = Delay;
+            }
+            InputMetricsPresent(&Metrics, &Metrics, GetNanoseconds());
+        }
+
+        atomic_store(&Player.Stop, 1);
+        pthread_join(Thread, 0);
+        GameFree(&Game);
+
+        char Name[64];
+        GetPolicyName(Policy, Name, sizeof(Name));
+        printf("%-22s %5llu %7llu %7llu %7llu %5llu %6.1f %6.1f %6.1f %10.1f %6.1f\n", Name,
+               (unsigned long long)Metrics.Received, (unsigned long long)Metrics.Queued,
+               (unsigned long long)Metrics.Coalesced, (unsigned long long)Metrics.Rejected,
+               (unsigned long long)Metrics.Dropped,
+               LatencyPercentile(&Metrics.ToTick, 0.5) / 1e6, LatencyPercentile(&Metrics.ToTick, 0.99) / 1e6,
+               Metrics.ToTick.MaxNanos / 1e6,
+               LatencyPercentile(&Metrics.ToPresent, 0.5) / 1e6, LatencyPercentile(&Metrics.ToPresent, 0.99) / 1e6);
+    }
+
+    return 0;
+}
+
+// Simulation and rendering on separate threads: the simulation thread
+// ticks an autopilot game and publishes a snapshot after every batch of
+// ticks, the main thread renders whatever is newest with a null renderer
+// and checks that no snapshot changes under it. Built with SNAKE_TRACE
+// it can write a trace of both threads.
+
+typedef struct {
+    tripleBuffer* Buffer;
+    atomic_int Stop;
+    uint64_t TickNanos;
+    int XTiles;
+    int YTiles;
+
+    uint64_t Ticks;
+    uint64_t Games;
+    uint64_t BusyNanos;
+    uint64_t CpuNanos;
+} snapshotSimulation;
+
+void* SnapshotSimulationThread(void* Argument) {
+    snapshotSimulation* Simulation = Argument;
+    uint64_t CpuStart = GetThreadNanoseconds();
+    TraceThread("simulation");
+
+    uint64_t Seed = 1;
+    game Game;
+    GameInit(&Game, Simulation->XTiles, Simulation->YTiles, Seed);
+    autopilot Autopilot;
+    AutopilotInit(&Autopilot, &Game, 4096);
+
+    fixedClock Clock;
+    ClockInit(&Clock, GetNanoseconds(), Simulation->TickNanos);
+
+    while(!atomic_load_explicit(&Simulation->Stop, memory_order_relaxed)) {
+        SleepUntil(ClockNextTick(&Clock));
+        uint64_t Start = GetNanoseconds();
+
+        int Ticks = ClockAdvance(&Clock, Start);
+        for(int Tick = 0; Tick < Ticks; ++Tick) {
+            int Direction = AutopilotDirection(&Autopilot, &Game);
+            if(Direction >= 0) InputQueueAdd(&Game.InputQueue, Direction);
+            TRACE_START(UpdateStart);
+            GameUpdate(&Game);
+            TRACE_ZONE(TRACE_UPDATE, UpdateStart);
+            ++Simulation->Ticks;
+
+            if(!Game.Running) {
+                GameFree(&Game);
+                GameInit(&Game, Simulation->XTiles, Simulation->YTiles, ++Seed);
+                ++Simulation->Games;
+            }
+        }
+
+        if(Ticks) {
+            TRACE_START(PublishStart);
+            SnapshotCopy(TripleBufferWriteSlot(Simulation->Buffer), &Game, Start, Simulation->TickNanos);
+            TripleBufferPublish(Simulation->Buffer);
+            TRACE_ZONE(TRACE_PUBLISH, PublishStart);
+        }
+        Simulation->BusyNanos += GetNanoseconds() - Start;
+    }
+
+    AutopilotFree(&Autopilot);
+    GameFree(&Game);
+    Simulation->CpuNanos = GetThreadNanoseconds() - CpuStart;
+    return 0;
+}
+
+int RunSnapshotTest(int ArgumentCount, char** Arguments) {
+
+    double Seconds = 2.0;
+    uint64_t TickNanos = 500000;
+    uint64_t FrameNanos = 2000000;
+    int XTiles = 64;
+    int YTiles = 64;
+
+    if(ArgumentCount > 0) Seconds = atof(Arguments[0]);
+    if(ArgumentCount > 1) TickNanos = (uint64_t)(atof(Arguments[1]) * 1e3);
+    if(ArgumentCount > 2) FrameNanos = (uint64_t)(atof(Arguments[2]) * 1e3);
+    if(ArgumentCount > 3) XTiles = atoi(Arguments[3]);
+    if(ArgumentCount > 4) YTiles = atoi(Arguments[4]);
+    char* TracePath = ArgumentCount > 5 ? Arguments[5] : 0;
+
+    if(Seconds <= 0.0 || TickNanos == 0 || FrameNanos == 0 ||
+       XTiles < 1 || XTiles > MAX_TILES || YTiles < 1 || YTiles > MAX_TILES) {
+        fprintf(stderr, "usage: headless snapshot [seconds] [tick microseconds] [frame microseconds] [xtiles] [ytiles] [trace.json]\n");
+        return 1;
+    }
+
+    static tripleBuffer Buffer;
+    TripleBufferInit(&Buffer);
+
+    snapshotSimulation Simulation = {
+        .Buffer = &Buffer,
+        .TickNanos = TickNanos,
+        .XTiles = XTiles,
+        .YTiles = YTiles,
+    };
+    atomic_init(&Simulation.Stop, 0);
+
+    TraceInit(GetNanoseconds());
+    TraceThread("render");
+
+    uint64_t CpuStart = GetThreadNanoseconds();
+    uint64_t Start = GetNanoseconds();
+    uint64_t End = Start + (uint64_t)(Seconds * 1e9);
+
+    pthread_t Thread;
+    pthread_create(&Thread, 0, SnapshotSimulationThread, &Simulation);
+
+    uint64_t Frames = 0;
+    uint64_t Empty = 0; // Nothing published yet
+    uint64_t Repeated = 0; // Same snapshot as the frame before
+    uint64_t Skipped = 0; // Published but never drawn
+    uint64_t Backwards = 0;
+    uint64_t Torn = 0;
+    uint64_t LastSequence = 0;
+    uint64_t BusyNanos = 0;
+    double Sink = 0.0;
+
+    for(uint64_t Frame = Start + FrameNanos; Frame < End; Frame += FrameNanos) {
+        SleepUntil(Frame);
+        uint64_t FrameStart = GetNanoseconds();
+        TRACE_START(FrameTicks);
+        ++Frames;
+
+        snapshot* Snapshot = TripleBufferRead(&Buffer);
+        if(!Snapshot) {
+            ++Empty;
+            continue;
+        }
+
+        if(Snapshot->Sequence < LastSequence) {
+            ++Backwards;
+        } else if(Snapshot->Sequence == LastSequence) {
+            ++Repeated;
+        } else {
+            Skipped += Snapshot->Sequence - LastSequence - 1;
+        }
+        LastSequence = Snapshot->Sequence;
+
+        // Null renderer: everything the window would position, and the
+        // hash after drawing, so a write during the frame shows up
+
+        game* View = &Snapshot->Game;
+        float Alpha = SnapshotAlpha(Snapshot, FrameStart);
+        for(int Index = 0; Index < View->BodyLength; ++Index) {
+            uint32_t Cell = GetPieceCell(View, Index);
+            Sink += CellX(View, Cell) * Alpha + CellY(View, Cell) + GetPiecePalette(Index);
+        }
+        if(View->Food != NO_FOOD) Sink += CellX(View, View->Food) + CellY(View, View->Food);
+
+        if(GameHash(View) != Snapshot->Hash) ++Torn;
+
+        TRACE_ZONE(TRACE_FRAME, FrameTicks);
+        BusyNanos += GetNanoseconds() - FrameStart;
+    }
+
+    atomic_store(&Simulation.Stop, 1);
+    pthread_join(Thread, 0);
+
+    double Wall = (double)(GetNanoseconds() - Start);
+    uint64_t CpuNanos = GetThreadNanoseconds() - CpuStart;
+
+    printf("board:        %dx%d\n", XTiles, YTiles);
+    printf("ticks:        %llu (%llu games), %llu published\n", (unsigned long long)Simulation.Ticks,
+           (unsigned long long)Simulation.Games, (unsigned long long)Buffer.Published);
+    printf("frames:       %llu, %llu empty, %llu repeated\n", (unsigned long long)Frames,
+           (unsigned long long)Empty, (unsigned long long)Repeated);
+    printf("skipped:      %llu snapshots\n", (unsigned long long)Skipped);
+    printf("simulation:   %.1f%% busy, %.1f%% cpu\n", 100.0 * Simulation.BusyNanos / Wall,
+           100.0 * Simulation.CpuNanos / Wall);
+    printf("render:       %.1f%% busy, %.1f%% cpu\n", 100.0 * BusyNanos / Wall, 100.0 * CpuNanos / Wall);
+    printf("sink:         %.0f\n", Sink);
+    printf("%s\n", Torn || Backwards ? "TORN" : "ok");
+    if(Torn || Backwards) printf("torn:         %llu, %llu backwards\n", (unsigned long long)Torn, (unsigned long long)Backwards);
+
+    if(TracePath && !TraceWrite(TracePath, GetNanoseconds())) {
+        fprintf(stderr, "can't write %s, tracing needs a build with -DSNAKE_TRACE\n", TracePath);
+    }
+
+    TripleBufferFree(&Buffer);
+    return Torn || Backwards;
+}
+
+// Builds a draw list every frame of an autopilot game, four frames a
+// tick, and submits it to the null backend. Prints what a frame costs
+// in maps, draws and bytes next to drawing entity by entity, and how
+// many cells a renderer that repaints dirty cells would touch per tick.
+
+int RunDrawList(int ArgumentCount, char** Arguments) {
+
+    long long Frames = 100000;
+    int XTiles = 20;
+    int YTiles = 20;
+    int Wireframe = 0;
+
+    if(ArgumentCount > 0) Frames = atoll(Arguments[0]);
+    if(ArgumentCount > 1) XTiles = atoi(Arguments[1]);
+    if(ArgumentCount > 2) YTiles = atoi(Arguments[2]);
+    if(ArgumentCount > 3) Wireframe = atoi(Arguments[3]);
+
+    if(Frames < 1 || XTiles < 1 || XTiles > MAX_TILES || YTiles < 1 || YTiles > MAX_TILES) {
+        fprintf(stderr, "usage: headless drawlist [frames] [xtiles] [ytiles] [wireframe]\n");
+        return 1;
+    }
+
+    InitPalette();
+
+    uint64_t Seed = 1;
+    game Game;
+    GameInit(&Game, XTiles, YTiles, Seed);
+    autopilot Autopilot;
+    AutopilotInit(&Autopilot, &Game, 4096);
+
+    drawList List = {0};
+    drawCounts Instanced = {0};
+    drawCounts PerEntity = {0};
+    drawBackend Backend = {&Instanced, NullSubmit};
+    matrix ViewProjection = DrawViewProjection(XTiles, YTiles, 16.0f / 9.0f);
+
+    static drawDirty Dirty;
+    uint64_t DirtyCells = 0;
+    uint64_t DirtyAll = 0;
+
+    uint64_t Ticked = 0;
+    uint64_t TickedNanos = 0;
+    uint64_t BetweenNanos = 0;
+
+    for(long long Frame = 0; Frame < Frames; ++Frame) {
+        if(Frame % 4 == 0) {
+            int Direction = AutopilotDirection(&Autopilot, &Game);
+            if(Direction >= 0) InputQueueAdd(&Game.InputQueue, Direction);
+            GameUpdate(&Game);
+            if(!Game.Running || Game.Food == NO_FOOD) {
+                AutopilotFree(&Autopilot);
+                GameFree(&Game);
+                GameInit(&Game, XTiles, YTiles, ++Seed);
+                AutopilotInit(&Autopilot, &Game, 4096);
+            }
+        }
+
+        uint64_t Start = GetNanoseconds();
+        int Built = DrawListBuild(&List, &Game, (float)(Frame % 4) / 4.0f, Wireframe);
+        DrawListSubmit(&List, &Backend, &ViewProjection);
+        uint64_t Nanos = GetNanoseconds() - Start;
+
+        if(Built) {
+            ++Ticked;
+            TickedNanos += Nanos;
+        } else {
+            BetweenNanos += Nanos;
+        }
+
+        DrawDirtyUpdate(&Dirty, &Game);
+        if(Dirty.All) {
+            ++DirtyAll;
+        } else {
+            DirtyCells += (uint64_t)Dirty.Count;
+        }
+
+        DrawCountPerEntity(&PerEntity, &List);
+    }
+
+    double PerFrame = 1.0 / (double)Frames;
+    uint64_t Between = (uint64_t)Frames - Ticked;
+    printf("board:        %dx%d%s\n", XTiles, YTiles, Wireframe ? ", wireframe" : "");
+    printf("frames:       %lld, %llu after a tick\n", Frames, (unsigned long long)Ticked);
+    printf("instances:    %.1f per frame, %d bytes each\n", Instanced.Instances * PerFrame, (int)sizeof(drawInstance));
+    printf("per entity:   %.1f maps, %.1f draws, %.0f bytes per frame\n",
+           PerEntity.Maps * PerFrame, PerEntity.Draws * PerFrame, PerEntity.Bytes * PerFrame);
+    printf("instanced:    %.1f maps, %.1f draws, %.0f bytes per frame\n",
+           Instanced.Maps * PerFrame, Instanced.Draws * PerFrame, Instanced.Bytes * PerFrame);
+    printf("floor:        %llu uploads\n", (unsigned long long)Instanced.FloorUploads);
+    printf("reduction:    %.0fx maps, %.0fx draws, %.1fx bytes\n",
+           (double)PerEntity.Maps / Instanced.Maps, (double)PerEntity.Draws / Instanced.Draws,
+           (double)PerEntity.Bytes / Instanced.Bytes);
+    printf("build:        %.2f us after a tick, %.3f us in between\n",
+           Ticked ? TickedNanos / 1e3 / Ticked : 0.0, Between ? BetweenNanos / 1e3 / Between : 0.0);
+    printf("dirty:        %.1f cells per tick of %d, %llu full redraws\n",
+           Ticked > DirtyAll ? (double)DirtyCells / (Ticked - DirtyAll) : 0.0, XTiles * YTiles,
+           (unsigned long long)DirtyAll);
+
+    DrawListFree(&List);
+    AutopilotFree(&Autopilot);
+    GameFree(&Game);
+    return 0;
+}
+
+// Draws an autopilot game with the software rasterizer on every kernel
+// the CPU has, four frames a tick. The last frames have to come out the
+// same on every kernel, and without the wireframe the center pixel of
+// every tile has to be the color of what is on it, or the clear color
+// where D3D would clip it. Then the board is pushed past the far plane
+// and in front of the near one, where nothing may be drawn. Writes the
+// last frame if given a file.
+
+uint32_t ExpectedTileColor(raster* Raster, game* Game, uint32_t Cell) {
+    for(int Index = Game->BodyLength - 1; Index >= 0; --Index) {
+        if(GetPieceCell(Game, Index) == Cell) return Raster->Palette[GetPiecePalette(Index)];
+    }
+    if(Cell == Game->Food) return Raster->Palette[PALETTE_FOOD];
+    return Raster->Palette[GetTilePalette(Game, Cell)];
+}
+
+// Tiles whose center pixel isn't the expected color, skipping the two
+// that are sliding. A tile outside the near or far plane is expected to
+// be the clear color.
+
+int CheckTileCenters(raster* Raster, game* Game, matrix* ViewProjection) {
+    int Wrong = 0;
+    uint32_t Head = GetPieceCell(Game, 0);
+    for(int Y = 0; Y < Game->YTiles; ++Y) {
+        for(int X = 0; X < Game->XTiles; ++X) {
+            uint32_t Cell = CellIndex(Game, X, Y);
+            if(Cell == Head || Cell == Game->Vacated) continue;
+            if(Game->BodyLength > 1 && Cell == GetPieceCell(Game, 1)) continue;
+
+            float Clip[4];
+            for(int Column = 0; Column < 4; ++Column) {
+                Clip[Column] = X * ViewProjection->M[0][Column] + Y * ViewProjection->M[1][Column] +
+                               ViewProjection->M[3][Column];
+            }
+            int PixelX = (int)((Clip[0] / Clip[3] + 1.0f) * 0.5f * Raster->Width);
+            int PixelY = (int)((1.0f - Clip[1] / Clip[3]) * 0.5f * Raster->Height);
+            if(PixelX < 0 || PixelX >= Raster->Width || PixelY < 0 || PixelY >= Raster->Height) continue;
+
+            int Clipped = Clip[2] < 0.0f || Clip[2] > Clip[3];
+            uint32_t Expected = Clipped ? Raster->ClearColor : ExpectedTileColor(Raster, Game, Cell);
+            if(Raster->Pixels[(size_t)PixelY * Raster->Width + PixelX] != Expected) ++Wrong;
+        }
+    }
+    return Wrong;
+}
+
+int RunRaster(int ArgumentCount, char** Arguments) {
+
+    int Frames = 600;
+    int XTiles = 200;
+    int YTiles = 200;
+    int Width = 1920;
+    int Height = 1080;
+    int Threads = 1;
+    int Wireframe = 0;
+    char* Path = 0;
+
+    if(ArgumentCount > 0) Frames = atoi(Arguments[0]);
+    if(ArgumentCount > 1) XTiles = atoi(Arguments[1]);
+    if(ArgumentCount > 2) YTiles = atoi(Arguments[2]);
+    if(ArgumentCount > 3) Width = atoi(Arguments[3]);
+    if(ArgumentCount > 4) Height = atoi(Arguments[4]);
+    if(ArgumentCount > 5) Threads = atoi(Arguments[5]);
+    if(ArgumentCount > 6) Wireframe = atoi(Arguments[6]);
+    if(ArgumentCount > 7) Path = Arguments[7];
+
+    if(Frames < 1 || XTiles < 1 || XTiles > MAX_TILES || YTiles < 1 || YTiles > MAX_TILES ||
+       Width < 1 || Width > RASTER_GUARD || Height < 1 || Height > RASTER_GUARD || Threads < 1) {
+        fprintf(stderr, "usage: headless raster [frames] [xtiles] [ytiles] [width] [height] [threads] [wireframe] [file.ppm]\n");
+        return 1;
+    }
+
+    InitPalette();
+
+    pool Pool;
+    if(Threads > 1) PoolInit(&Pool, Threads);
+
+    matrix ViewProjection = DrawViewProjection(XTiles, YTiles, (float)Width / (float)Height);
+    uint64_t Hashes[RASTER_KERNELS] = {0};
+    int Failed = 0;
+
+    printf("board:        %dx%d%s\n", XTiles, YTiles, Wireframe ? ", wireframe" : "");
+    printf("image:        %dx%d, %d thread%s\n", Width, Height, Threads, Threads > 1 ? "s" : "");
+
+    for(int Kernel = 0; Kernel < RASTER_KERNELS; ++Kernel) {
+        if(!RasterKernelSupported(Kernel)) continue;
+
+        raster Raster;
+        RasterInit(&Raster, Width, Height, Kernel, Threads > 1 ? &Pool : 0);
+        drawBackend Backend = {&Raster, RasterSubmit};
+        drawList List = {0};
+
+        game Game;
+        GameInit(&Game, XTiles, YTiles, 1);
+        autopilot Autopilot;
+        AutopilotInit(&Autopilot, &Game, 4096);
+
+        uint64_t Nanos = 0;
+        uint64_t WorstNanos = 0;
+
+        for(int Frame = 0; Frame < Frames; ++Frame) {
+            if(Frame % 4 == 0 && Game.Running && Game.Food != NO_FOOD) {
+                int Direction = AutopilotDirection(&Autopilot, &Game);
+                if(Direction >= 0) InputQueueAdd(&Game.InputQueue, Direction);
+                GameUpdate(&Game);
+            }
+
+            uint64_t Start = GetNanoseconds();
+            DrawListBuild(&List, &Game, (float)(Frame % 4) / 4.0f, Wireframe);
+            DrawListSubmit(&List, &Backend, &ViewProjection);
+            uint64_t Elapsed = GetNanoseconds() - Start;
+            Nanos += Elapsed;
+            if(Elapsed > WorstNanos) WorstNanos = Elapsed;
+        }
+
+        Hashes[Kernel] = HashBytes(0xcbf29ce484222325ull, Raster.Pixels, (size_t)Width * Height * sizeof(uint32_t));
+        int Wrong = 0;
+        if(!Wireframe) {
+            DrawListBuild(&List, &Game, 1.0f, 0);
+            DrawListSubmit(&List, &Backend, &ViewProjection);
+            Wrong = CheckTileCenters(&Raster, &Game, &ViewProjection);
+            Failed |= Wrong != 0;
+        }
+        if(Hashes[Kernel] != Hashes[RASTER_SCALAR]) Failed = 1;
+
+        // Depth moved by twice w puts every vertex past the far plane,
+        // then in front of the near one, without moving it on screen
+
+        size_t Drawn = 0;
+        for(int Side = 0; Side < 2; ++Side) {
+            matrix Clipped = ViewProjection;
+            for(int Row = 0; Row < 4; ++Row) Clipped.M[Row][2] += (Side ? -2.0f : 2.0f) * ViewProjection.M[Row][3];
+            DrawListSubmit(&List, &Backend, &Clipped);
+            for(size_t Index = 0; Index < (size_t)Width * Height; ++Index) Drawn += Raster.Pixels[Index] != Raster.ClearColor;
+            Wrong += CheckTileCenters(&Raster, &Game, &Clipped);
+        }
+        DrawListSubmit(&List, &Backend, &ViewProjection);
+        Failed |= Drawn != 0 || Wrong != 0;
+
+        printf("%-14s%.0f fps, %.2f ms per frame, worst %.2f ms, length %d, %d wrong tiles, %zu clipped pixels drawn\n",
+               RasterKernelNames[Kernel], Frames / (Nanos / 1e9), Nanos / 1e6 / Frames, WorstNanos / 1e6,
+               Game.BodyLength, Wrong, Drawn);
+
+        if(Path && Kernel == RasterBestKernel()) {
+            if(!RasterWritePpm(&Raster, Path)) {
+                fprintf(stderr, "can't write %s\n", Path);
+                Failed = 1;
+            }
+        }
+
+        AutopilotFree(&Autopilot);
+        GameFree(&Game);
+        DrawListFree(&List);
+        RasterFree(&Raster);
+    }
+
+    if(Threads > 1) PoolFree(&Pool);
+
+    printf("%s\n", Failed ? "MISMATCH" : "ok");
+    return Failed;
+}
+
+// Shows an autopilot game in the terminal on stdout, for watching over
+// SSH. Ticks run on their own schedule and every frame sends what
+// changed since the one before, however many ticks that was. Numbers go
+// to stderr at the end so stdout can be thrown away to measure.
+
+int RunWatch(int ArgumentCount, char** Arguments) {
+
+    double Seconds = 10.0;
+    double TicksPerSecond = 20.0;
+    int XTiles = 40;
+    int YTiles = 20;
+    double FramesPerSecond = 60.0;
+
+    if(ArgumentCount > 0) Seconds = atof(Arguments[0]);
+    if(ArgumentCount > 1) TicksPerSecond = atof(Arguments[1]);
+    if(ArgumentCount > 2) XTiles = atoi(Arguments[2]);
+    if(ArgumentCount > 3) YTiles = atoi(Arguments[3]);
+    if(ArgumentCount > 4) FramesPerSecond = atof(Arguments[4]);
+
+    if(Seconds <= 0.0 || TicksPerSecond <= 0.0 || FramesPerSecond <= 0.0 ||
+       XTiles < 1 || XTiles > MAX_TILES || YTiles < 1 || YTiles > MAX_TILES) {
+        fprintf(stderr, "usage: headless watch [seconds] [ticks per second] [xtiles] [ytiles] [frames per second]\n");
+        return 1;
+    }
+
+    InitPalette();
+
+    uint64_t Seed = 1;
+    game Game;
+    GameInit(&Game, XTiles, YTiles, Seed);
+    autopilot Autopilot;
+    AutopilotInit(&Autopilot, &Game, 4096);
+
+    term Term;
+    TermInit(&Term, STDOUT_FILENO, 0, 0);
+
+    uint64_t FrameNanos = (uint64_t)(1e9 / FramesPerSecond);
+    uint64_t Start = GetNanoseconds();
+    uint64_t End = Start + (uint64_t)(Seconds * 1e9);
+    uint64_t Ticks = 0;
+    uint64_t Games = 1;
+    uint64_t FrameBusyNanos = 0;
+    uint64_t FrameWorstNanos = 0;
+
+    for(uint64_t Next = Start; Next < End; Next += FrameNanos) {
+        SleepUntil(Next);
+
+        uint64_t Due = (uint64_t)((GetNanoseconds() - Start) * 1e-9 * TicksPerSecond);
+        for(; Ticks < Due; ++Ticks) {
+            int Direction = AutopilotDirection(&Autopilot, &Game);
+            if(Direction >= 0) InputQueueAdd(&Game.InputQueue, Direction);
+            GameUpdate(&Game);
+            if(!Game.Running || Game.Food == NO_FOOD) {
+                AutopilotFree(&Autopilot);
+                GameFree(&Game);
+                GameInit(&Game, XTiles, YTiles, ++Seed);
+                AutopilotInit(&Autopilot, &Game, 4096);
+                ++Games;
+            }
+        }
+
+        uint64_t FrameStart = GetNanoseconds();
+        TermFrame(&Term, &Game);
+        uint64_t Nanos = GetNanoseconds() - FrameStart;
+        FrameBusyNanos += Nanos;
+        if(Nanos > FrameWorstNanos) FrameWorstNanos = Nanos;
+    }
+    TermEnd(&Term);
+
+    double Elapsed = (GetNanoseconds() - Start) / 1e9;
+    double PerFrame = Term.Frames ? 1.0 / (double)Term.Frames : 0.0;
+    fprintf(stderr, "board:        %dx%d, view %dx%d of a %dx%d terminal\n", XTiles, YTiles,
+            Term.Width, Term.Height, Term.Columns, Term.Rows);
+    fprintf(stderr, "ticks:        %llu in %.2f s, %llu games\n", (unsigned long long)Ticks, Elapsed,
+            (unsigned long long)Games);
+    fprintf(stderr, "frames:       %llu, %llu looked at the whole view\n", (unsigned long long)Term.Frames,
+            (unsigned long long)Term.FullFrames);
+    fprintf(stderr, "sent:         %.1f tiles, %.0f bytes per frame of %d tiles\n", Term.Cells * PerFrame,
+            Term.Bytes * PerFrame, Term.Width * Term.Height);
+    fprintf(stderr, "frame:        %.2f us average, %.2f us worst\n", FrameBusyNanos * PerFrame / 1e3,
+            FrameWorstNanos / 1e3);
+
+    TermFree(&Term);
+    AutopilotFree(&Autopilot);
+    GameFree(&Game);
+    return 0;
+}
+
+// Replays a recording into an animated GIF, a frame per tick, while the
+// workers encode the frames before. "-" writes to stdout.
+
+void ExportReplayTick(void* Context, game* Game) {
+    ExportFrame(Context, Game);
+}
+
+int RunExport(int ArgumentCount, char** Arguments) {
+
+    int CellSize = 8;
+    int Delay = 5;
+    int Threads = 2;
+
+    if(ArgumentCount > 2) CellSize = atoi(Arguments[2]);
+    if(ArgumentCount > 3) Delay = atoi(Arguments[3]);
+    if(ArgumentCount > 4) Threads = atoi(Arguments[4]);
+
+    if(ArgumentCount < 2 || CellSize < 1 || Delay < 0 || Delay > 0xffff || Threads < 0) {
+        fprintf(stderr, "usage: headless export recording file.gif [cell pixels] [delay centiseconds] [threads]\n");
+        return 1;
+    }
+
+    recording Recording;
+    if(!RecordingLoad(&Recording, Arguments[0])) {
+        fprintf(stderr, "can't read %s\n", Arguments[0]);
+        return 1;
+    }
+
+    replayHeader Header;
+    if(!ReplayReadHeader(&Recording, &Header)) {
+        fprintf(stderr, "%s is not a recording\n", Arguments[0]);
+        RecordingFree(&Recording);
+        return 1;
+    }
+    int XTiles = Header.XTiles;
+    int YTiles = Header.YTiles;
+
+    InitPalette();
+
+    exporter Exporter;
+    if(!ExportBegin(&Exporter, Arguments[1], XTiles, YTiles, CellSize, Delay, Threads)) {
+        fprintf(stderr, "can't write %s\n", Arguments[1]);
+        RecordingFree(&Recording);
+        return 1;
+    }
+
+    game Game;
+    uint64_t Start = GetNanoseconds();
+    int Result = ReplayRunEach(&Recording, &Game, ExportReplayTick, &Exporter);
+    uint64_t Frames = Exporter.Submitted;
+    uint64_t Tiles = Exporter.Tiles;
+    uint64_t Stalls = Exporter.Stalls;
+    int Written = ExportEnd(&Exporter);
+    double Seconds = (double)(GetNanoseconds() - Start) / 1e9;
+
+    FILE* Out = strcmp(Arguments[1], "-") ? stdout : stderr;
+    fprintf(Out, "board:        %dx%d, %dx%d pixels\n", XTiles, YTiles, XTiles * CellSize, YTiles * CellSize);
+    fprintf(Out, "frames:       %llu in %.3f s, %.0f per second\n", (unsigned long long)Frames, Seconds,
+            Frames / Seconds);
+    fprintf(Out, "tiles:        %.1f per frame of %d\n", (double)Tiles / Frames, XTiles * YTiles);
+    fprintf(Out, "bytes:        %llu, %.0f per frame\n", (unsigned long long)Exporter.Bytes,
+            (double)Exporter.Bytes / Frames);
+    fprintf(Out, "stalls:       %llu waits on %d workers\n", (unsigned long long)Stalls, Threads);
+    fprintf(Out, "%s\n", !Written ? "WRITE FAILED" : Result == REPLAY_OK ? "ok" :
+                          Result == REPLAY_BAD_FILE ? "NOT A RECORDING" : "MISMATCH");
+
+    if(Result != REPLAY_BAD_FILE) GameFree(&Game);
+    RecordingFree(&Recording);
+    return !Written || Result != REPLAY_OK;
+}
+
+int main(int ArgumentCount, char** Arguments) {
+
+    char* Mode = ArgumentCount > 1 ? Arguments[1] : "bench";
+    int ModeArgumentCount = ArgumentCount > 2 ? ArgumentCount - 2 : 0;
+    char** ModeArguments = Arguments + 2;
+
+    if(!strcmp(Mode, "bench")) {
+        return RunBench(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "realtime")) {
+        return RunRealtime(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "clocktest")) {
+        return RunClockTest();
+    } else if(!strcmp(Mode, "record")) {
+        return RunRecord(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "replay")) {
+        return RunReplay(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "batch")) {
+        return RunBatch(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "lockstep")) {
+        return RunLockstepTest(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "env")) {
+        return RunEnv(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "autopilot")) {
+        return RunAutopilot(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "hamilton")) {
+        return RunHamilton(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "arena")) {
+        return RunArena(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "server")) {
+        return RunServer(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "clients")) {
+        return RunClients(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "nettest")) {
+        return RunNetTest(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "input")) {
+        return RunInputTest(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "snapshot")) {
+        return RunSnapshotTest(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "drawlist")) {
+        return RunDrawList(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "raster")) {
+        return RunRaster(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "watch")) {
+        return RunWatch(ModeArgumentCount, ModeArguments);
+    } else if(!strcmp(Mode, "export")) {
+        return RunExport(ModeArgumentCount, ModeArguments);
+    }
+
+    fprintf(stderr, "usage: headless bench|realtime|clocktest|record|replay|batch|lockstep|env|autopilot|hamilton|arena|server|clients|nettest|input|snapshot|drawlist|raster|watch|export [arguments]\n");
+    return 1;
+}
@@ -0,0 +1,220 @@
+// Input on its way from wherever it happens to the simulation. Key
+// presses go into a lock-free ring with the time they happened and the
+// simulation drains the ring into the game's InputQueue before each tick.
+// One thread writes the ring and one reads it, each index is only ever
+// stored by its owner.
+//
+// Draining applies a policy, any mix of:
+//
+//   INPUT_COALESCE         a direction the snake will already be going in
+//                          is dropped instead of using up a tick
+//   INPUT_REJECT_OPPOSITE  a direction the game would refuse (straight
+//                          back) is dropped instead of using up a tick
+//   INPUT_DROP_OLDEST      a full InputQueue loses its oldest entry to
+//                          make room, without it the new input is dropped
+//
+// "Will be going in" is the last direction queued, or the current one.
+//
+// Latencies go into histograms with four buckets per power of two
+// microseconds: from the input to the tick that applied it, and to the
+// first frame presented after that tick. When ticks and frames are on
+// different threads the applied inputs travel with the snapshot and the
+// render thread keeps its own metrics for presenting.
+
+#include <stdatomic.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define INPUT_RING_SIZE 256 // Power of two
+#define INPUT_UNPRESENTED 16 // Power of two
+#define LATENCY_BUCKETS 96
+
+enum {
+    INPUT_COALESCE = 1,
+    INPUT_REJECT_OPPOSITE = 2,
+    INPUT_DROP_OLDEST = 4,
+    INPUT_POLICIES = 8, // Every mix is below this
+};
+
+typedef struct {
+    uint64_t Nanos;
+    int Direction;
+} inputEvent;
+
+typedef struct {
+    _Alignas(64) atomic_uint Write; // Stored by the producer
+    _Alignas(64) atomic_uint Read; // Stored by the consumer
+    _Alignas(64) uint64_t Overflows; // Producer side
+    inputEvent Events[INPUT_RING_SIZE];
+} inputRing;
+
+void InputRingInit(inputRing* Ring) {
+    atomic_init(&Ring->Write, 0);
+    atomic_init(&Ring->Read, 0);
+    Ring->Overflows = 0;
+}
+
+// Producer, 0 if the ring is full
+
+int InputRingPush(inputRing* Ring, int Direction, uint64_t Nanos) {
+    unsigned Write = atomic_load_explicit(&Ring->Write, memory_order_relaxed);
+    unsigned Read = atomic_load_explicit(&Ring->Read, memory_order_acquire);
+    if(Write - Read == INPUT_RING_SIZE) {
+        ++Ring->Overflows;
+        return 0;
+    }
+    Ring->Events[Write & (INPUT_RING_SIZE - 1)] = (inputEvent){Nanos, Direction};
+    atomic_store_explicit(&Ring->Write, Write + 1, memory_order_release);
+    return 1;
+}
+
+// Consumer, 0 if the ring is empty
+
+int InputRingPop(inputRing* Ring, inputEvent* Event) {
+    unsigned Read = atomic_load_explicit(&Ring->Read, memory_order_relaxed);
+    unsigned Write = atomic_load_explicit(&Ring->Write, memory_order_acquire);
+    if(Read == Write) return 0;
+    *Event = Ring->Events[Read & (INPUT_RING_SIZE - 1)];
+    atomic_store_explicit(&Ring->Read, Read + 1, memory_order_release);
+    return 1;
+}
+
+// Latency histograms
+
+typedef struct {
+    uint64_t Count;
+    uint64_t SumNanos;
+    uint64_t MaxNanos;
+    uint64_t Buckets[LATENCY_BUCKETS];
+} latency;
+
+// Index of the highest set bit, Value isn't 0
+
+int HighestBit(uint64_t Value) {
+#if defined(_MSC_VER)
+    unsigned long Index;
+    _BitScanReverse64(&Index, Value);
+    return (int)Index;
+#else
+    return 63 - __builtin_clzll(Value);
+#endif
+}
+
+// Below 4 microseconds every microsecond has a bucket, above that the top
+// three bits pick one
+
+int LatencyBucket(uint64_t Micros) {
+    if(Micros < 4) return (int)Micros;
+    int Log = HighestBit(Micros);
+    int Bucket = (Log - 1) * 4 + (int)((Micros >> (Log - 2)) & 3);
+    return Bucket < LATENCY_BUCKETS ? Bucket : LATENCY_BUCKETS - 1;
+}
+
+uint64_t LatencyBucketLimit(int Bucket) {
+    if(Bucket < 4) return (uint64_t)Bucket + 1;
+    int Log = Bucket / 4 + 1;
+    return (uint64_t)(4 + Bucket % 4 + 1) << (Log - 2);
+}
+
+void LatencyAdd(latency* Latency, uint64_t Nanos) {
+    int Bucket = LatencyBucket(Nanos / 1000);
+
+    ++Latency->Count;
+    Latency->SumNanos += Nanos;
+    if(Nanos > Latency->MaxNanos) Latency->MaxNanos = Nanos;
+    ++Latency->Buckets[Bucket];
+}
+
+// Upper bound of the bucket Fraction of the samples are in or below, in
+// nanoseconds, within 25%
+
+uint64_t LatencyPercentile(latency* Latency, double Fraction) {
+    uint64_t Target = (uint64_t)(Fraction * (double)Latency->Count);
+    uint64_t Seen = 0;
+    for(int Bucket = 0; Bucket < LATENCY_BUCKETS; ++Bucket) {
+        Seen += Latency->Buckets[Bucket];
+        if(Seen > Target) {
+            uint64_t Limit = LatencyBucketLimit(Bucket) * 1000;
+            return Limit < Latency->MaxNanos ? Limit : Latency->MaxNanos;
+        }
+    }
+    return Latency->MaxNanos;
+}
+
+// Metrics
+
+typedef struct {
+    uint64_t Received;
+    uint64_t Queued;
+    uint64_t Coalesced;
+    uint64_t Rejected;
+    uint64_t Dropped; // By a full InputQueue, oldest or newest
+
+    latency ToTick;
+    latency ToPresent;
+
+    // When the last INPUT_UNPRESENTED applied inputs happened, a ring
+    // indexed by Applied, which counts every one. Presented is how many
+    // of them a present has measured, more than INPUT_UNPRESENTED
+    // between two presents and the oldest go unmeasured.
+
+    uint64_t Applied;
+    uint64_t AppliedNanos[INPUT_UNPRESENTED];
+    uint64_t Presented;
+} inputMetrics;
+
+uint64_t NanosSince(uint64_t Then, uint64_t Now) {
+    return Now > Then ? Now - Then : 0;
+}
+
+// Moves everything in the ring into the game's InputQueue
+
+void InputDrain(inputRing* Ring, game* Game, int Policy, inputMetrics* Metrics) {
+    inputQueue* Q = &Game->InputQueue;
+    inputEvent Event;
+
+    while(InputRingPop(Ring, &Event)) {
+        ++Metrics->Received;
+
+        int Heading = Q->Length ? Q->Values[Q->Length - 1] : Game->Direction;
+        if((Policy & INPUT_COALESCE) && Event.Direction == Heading) {
+            ++Metrics->Coalesced;
+            continue;
+        }
+        if((Policy & INPUT_REJECT_OPPOSITE) && Game->TailLength > 0 && IsOppositeDirection(Heading, Event.Direction)) {
+            ++Metrics->Rejected;
+            continue;
+        }
+
+        if(Q->Length == INPUT_QUEUE_SIZE) {
+            ++Metrics->Dropped;
+            if(!(Policy & INPUT_DROP_OLDEST)) continue;
+        }
+        InputQueueAddAt(Q, Event.Direction, Event.Nanos);
+        ++Metrics->Queued;
+    }
+}
+
+// Call after each tick
+
+void InputMetricsTick(inputMetrics* Metrics, game* Game, uint64_t Now) {
+    if(Game->LastInput < 0 || !Game->LastInputNanos) return;
+
+    LatencyAdd(&Metrics->ToTick, NanosSince(Game->LastInputNanos, Now));
+    Metrics->AppliedNanos[Metrics->Applied++ & (INPUT_UNPRESENTED - 1)] = Game->LastInputNanos;
+}
+
+// Call once a frame is presented, Shown is the metrics of the ticks
+// behind it: Metrics itself, or a copy from the thread that ticks
+
+void InputMetricsPresent(inputMetrics* Metrics, inputMetrics* Shown, uint64_t Now) {
+    if(Shown->Applied <= Metrics->Presented) return;
+
+    uint64_t First = Metrics->Presented;
+    if(Shown->Applied - First > INPUT_UNPRESENTED) First = Shown->Applied - INPUT_UNPRESENTED;
+    for(uint64_t Input = First; Input < Shown->Applied; ++Input) {
+        LatencyAdd(&Metrics->ToPresent, NanosSince(Shown->AppliedNanos[Input & (INPUT_UNPRESENTED - 1)], Now));
+    }
+    Metrics->Presented = Shown->Applied;
+}
@@ -0,0 +1,611 @@
+// Lockstep batches: many games on the same board size stored as
+// structure of arrays, so one tick of the GameUpdate() rules runs on 8
+// (AVX2) or 16 (AVX-512) games per instruction.
+//
+// A lane plays exactly like a game with the same seed fed the same
+// inputs and hashes the same. The vector kernels only take the common
+// tick: a lane that eats, dies or keeps its free cells in an array is
+// left untouched by them and stepped by LockstepStepLane() instead, which
+// is also the scalar fallback. Finished lanes stay as they are until
+// LockstepLaneInit() starts a new game in them.
+//
+// Each lane owns a slice of one occupancy bitmap and one body ring, the
+// rings are sized for a full board so they never grow. The bitmap is in
+// 32 bit words so the kernels can gather and scatter it per lane.
+//
+// The floor seed and Delay are only for drawing and pacing and aren't
+// kept. Kernels are picked at run time, which needs GCC or Clang.
+
+#include <immintrin.h>
+#include <string.h>
+
+#define LOCKSTEP_WIDTH 16 // Lanes are padded to this
+#define LOCKSTEP_MAX_CELLS (1 << 16) // Per lane, border included
+
+#define LOCKSTEP_TARGET(Target) __attribute__((target(Target)))
+
+enum {
+    LOCKSTEP_SCALAR,
+    LOCKSTEP_AVX2,
+    LOCKSTEP_AVX512,
+    LOCKSTEP_KERNELS,
+};
+
+char* LockstepKernelNames[LOCKSTEP_KERNELS] = {"scalar", "avx2", "avx512"};
+
+typedef struct {
+    int Count;
+    int Padded;
+    int XTiles;
+    int YTiles;
+    int Stride;
+    int Area;
+    int Steps[KEYSAMOUNT];
+    int Words; // Occupancy words per lane
+    int BodyShift; // Log2 of the body ring size per lane
+
+    uint32_t* Occupied;
+    uint32_t* Body;
+
+    // Set by the caller before each step, a direction or -1 for no input
+
+    int8_t* Inputs;
+
+    // Per lane
+
+    uint64_t* Tick;
+    rng* Rng;
+    uint32_t* Head;
+    uint32_t* Food;
+    int32_t* Direction;
+    int32_t* TailLength;
+    int32_t* BodyHead;
+    int32_t* BodyLength;
+    int32_t* Growing;
+    int32_t* Running;
+
+    // Free cells, see game. Dense is set once a lane has them.
+
+    int32_t* Dense;
+    uint32_t** FreeCells;
+    uint32_t** FreeIndex;
+    int32_t* FreeCount;
+} lockstep;
+
+void* LockstepAlloc(size_t Size) {
+    Size = (Size + 63) & ~(size_t)63;
+    void* Result = aligned_alloc(64, Size);
+    assert(Result);
+    memset(Result, 0, Size);
+    return Result;
+}
+
+uint32_t* LockstepLaneBody(lockstep* Lockstep, int Lane) {
+    return Lockstep->Body + ((size_t)Lane << Lockstep->BodyShift);
+}
+
+uint32_t* LockstepLaneOccupied(lockstep* Lockstep, int Lane) {
+    return Lockstep->Occupied + (size_t)Lane * Lockstep->Words;
+}
+
+int LockstepIsBlocked(lockstep* Lockstep, int Lane, uint32_t Cell) {
+    return (LockstepLaneOccupied(Lockstep, Lane)[Cell >> 5] >> (Cell & 31)) & 1;
+}
+
+void LockstepSetCell(lockstep* Lockstep, int Lane, uint32_t Cell) {
+    LockstepLaneOccupied(Lockstep, Lane)[Cell >> 5] |= 1u << (Cell & 31);
+}
+
+void LockstepClearCell(lockstep* Lockstep, int Lane, uint32_t Cell) {
+    LockstepLaneOccupied(Lockstep, Lane)[Cell >> 5] &= ~(1u << (Cell & 31));
+}
+
+uint32_t LockstepCellIndex(lockstep* Lockstep, int X, int Y) {
+    return (uint32_t)((Y + 1) * Lockstep->Stride + X + 1);
+}
+
+// Free cells, same order of operations as in snake.c so food lands on
+// the same cells
+
+void LockstepAddFreeCell(lockstep* Lockstep, int Lane, uint32_t Cell) {
+    Lockstep->FreeIndex[Lane][Cell] = Lockstep->FreeCount[Lane];
+    Lockstep->FreeCells[Lane][Lockstep->FreeCount[Lane]++] = Cell;
+}
+
+void LockstepRemoveFreeCell(lockstep* Lockstep, int Lane, uint32_t Cell) {
+    uint32_t* FreeCells = Lockstep->FreeCells[Lane];
+    uint32_t* FreeIndex = Lockstep->FreeIndex[Lane];
+    uint32_t Index = FreeIndex[Cell];
+    uint32_t Last = FreeCells[--Lockstep->FreeCount[Lane]];
+    FreeCells[Index] = Last;
+    FreeIndex[Last] = Index;
+}
+
+void LockstepBuildFreeCells(lockstep* Lockstep, int Lane) {
+    int Cells = (Lockstep->XTiles + 2) * (Lockstep->YTiles + 2);
+    Lockstep->FreeCells[Lane] = malloc((size_t)Lockstep->Area * sizeof(uint32_t));
+    Lockstep->FreeIndex[Lane] = malloc((size_t)Cells * sizeof(uint32_t));
+    assert(Lockstep->FreeCells[Lane] && Lockstep->FreeIndex[Lane]);
+    Lockstep->FreeCount[Lane] = 0;
+    Lockstep->Dense[Lane] = 1;
+
+    for(int Y = 0; Y < Lockstep->YTiles; ++Y) {
+        for(int X = 0; X < Lockstep->XTiles; ++X) {
+            uint32_t Cell = LockstepCellIndex(Lockstep, X, Y);
+            if(!LockstepIsBlocked(Lockstep, Lane, Cell)) LockstepAddFreeCell(Lockstep, Lane, Cell);
+        }
+    }
+}
+
+void LockstepFreeFreeCells(lockstep* Lockstep, int Lane) {
+    free(Lockstep->FreeCells[Lane]);
+    free(Lockstep->FreeIndex[Lane]);
+    Lockstep->FreeCells[Lane] = 0;
+    Lockstep->FreeIndex[Lane] = 0;
+    Lockstep->FreeCount[Lane] = 0;
+    Lockstep->Dense[Lane] = 0;
+}
+
+void LockstepOccupyCell(lockstep* Lockstep, int Lane, uint32_t Cell) {
+    LockstepSetCell(Lockstep, Lane, Cell);
+    if(Lockstep->Dense[Lane]) {
+        LockstepRemoveFreeCell(Lockstep, Lane, Cell);
+    } else if(Lockstep->BodyLength[Lane] * 2 > Lockstep->Area) {
+        LockstepBuildFreeCells(Lockstep, Lane);
+    }
+}
+
+void LockstepVacateCell(lockstep* Lockstep, int Lane, uint32_t Cell) {
+    LockstepClearCell(Lockstep, Lane, Cell);
+    if(Lockstep->Dense[Lane]) LockstepAddFreeCell(Lockstep, Lane, Cell);
+}
+
+uint32_t LockstepRandomFreeCell(lockstep* Lockstep, int Lane) {
+    rng* Rng = &Lockstep->Rng[Lane];
+
+    if(Lockstep->Dense[Lane]) {
+        if(Lockstep->FreeCount[Lane] == 0) return NO_FOOD;
+        return Lockstep->FreeCells[Lane][RngBelow(Rng, Lockstep->FreeCount[Lane])];
+    }
+
+    for(;;) {
+        int X = (int)RngBelow(Rng, Lockstep->XTiles);
+        int Y = (int)RngBelow(Rng, Lockstep->YTiles);
+        uint32_t Cell = LockstepCellIndex(Lockstep, X, Y);
+        if(!LockstepIsBlocked(Lockstep, Lane, Cell)) return Cell;
+    }
+}
+
+// Lanes
+
+uint32_t LockstepGetPieceCell(lockstep* Lockstep, int Lane, int Index) {
+    int Mask = (1 << Lockstep->BodyShift) - 1;
+    return LockstepLaneBody(Lockstep, Lane)[(Lockstep->BodyHead[Lane] + Index) & Mask];
+}
+
+void LockstepPushHead(lockstep* Lockstep, int Lane, uint32_t Cell) {
+    int Mask = (1 << Lockstep->BodyShift) - 1;
+    Lockstep->BodyHead[Lane] = (Lockstep->BodyHead[Lane] - 1) & Mask;
+    LockstepLaneBody(Lockstep, Lane)[Lockstep->BodyHead[Lane]] = Cell;
+    Lockstep->Head[Lane] = Cell;
+    ++Lockstep->BodyLength[Lane];
+}
+
+// Starts a new game in the lane, like GameInit()
+
+void LockstepLaneInit(lockstep* Lockstep, int Lane, uint64_t Seed) {
+    int XTiles = Lockstep->XTiles;
+    int YTiles = Lockstep->YTiles;
+    int Stride = Lockstep->Stride;
+
+    LockstepFreeFreeCells(Lockstep, Lane);
+    memset(LockstepLaneOccupied(Lockstep, Lane), 0, Lockstep->Words * sizeof(uint32_t));
+
+    for(int X = 0; X < XTiles + 2; ++X) {
+        LockstepSetCell(Lockstep, Lane, X);
+        LockstepSetCell(Lockstep, Lane, (YTiles + 1) * Stride + X);
+    }
+    for(int Y = 0; Y < YTiles + 2; ++Y) {
+        LockstepSetCell(Lockstep, Lane, Y * Stride);
+        LockstepSetCell(Lockstep, Lane, Y * Stride + XTiles + 1);
+    }
+
+    Lockstep->Tick[Lane] = 0;
+    Lockstep->Direction[Lane] = RIGHT;
+    Lockstep->TailLength[Lane] = 0;
+    Lockstep->BodyHead[Lane] = 0;
+    Lockstep->BodyLength[Lane] = 0;
+    Lockstep->Growing[Lane] = 0;
+    Lockstep->Running[Lane] = 1;
+    Lockstep->Inputs[Lane] = -1;
+
+    RngInit(&Lockstep->Rng[Lane], Seed, STREAM_FOOD);
+
+    uint32_t Head = LockstepCellIndex(Lockstep, XTiles / 2, YTiles / 2);
+    LockstepPushHead(Lockstep, Lane, Head);
+    LockstepOccupyCell(Lockstep, Lane, Head);
+
+    Lockstep->Food[Lane] = LockstepRandomFreeCell(Lockstep, Lane);
+}
+
+// Lanes start with games seeded Seed, Seed + 1...
+
+void LockstepInit(lockstep* Lockstep, int Count, int XTiles, int YTiles, uint64_t Seed) {
+    int Stride = XTiles + 2;
+    int Cells = Stride * (YTiles + 2);
+
+    assert(Count > 0);
+    assert(XTiles > 0 && YTiles > 0 && Cells <= LOCKSTEP_MAX_CELLS);
+
+    int BodyShift = 0;
+    while((1 << BodyShift) < XTiles * YTiles) ++BodyShift;
+
+    *Lockstep = (lockstep){
+        .Count = Count,
+        .Padded = (Count + LOCKSTEP_WIDTH - 1) / LOCKSTEP_WIDTH * LOCKSTEP_WIDTH,
+        .XTiles = XTiles,
+        .YTiles = YTiles,
+        .Stride = Stride,
+        .Area = XTiles * YTiles,
+        .Steps = {
+            [UP] = Stride,
+            [LEFT] = -1,
+            [DOWN] = -Stride,
+            [RIGHT] = 1,
+        },
+        .Words = (Cells + 31) / 32,
+        .BodyShift = BodyShift,
+    };
+
+    size_t Padded = Lockstep->Padded;
+    Lockstep->Occupied = LockstepAlloc(Padded * Lockstep->Words * sizeof(uint32_t));
+    Lockstep->Body = LockstepAlloc((Padded << BodyShift) * sizeof(uint32_t));
+    Lockstep->Inputs = LockstepAlloc(Padded * sizeof(int8_t));
+    Lockstep->Tick = LockstepAlloc(Padded * sizeof(uint64_t));
+    Lockstep->Rng = LockstepAlloc(Padded * sizeof(rng));
+    Lockstep->Head = LockstepAlloc(Padded * sizeof(uint32_t));
+    Lockstep->Food = LockstepAlloc(Padded * sizeof(uint32_t));
+    Lockstep->Direction = LockstepAlloc(Padded * sizeof(int32_t));
+    Lockstep->TailLength = LockstepAlloc(Padded * sizeof(int32_t));
+    Lockstep->BodyHead = LockstepAlloc(Padded * sizeof(int32_t));
+    Lockstep->BodyLength = LockstepAlloc(Padded * sizeof(int32_t));
+    Lockstep->Growing = LockstepAlloc(Padded * sizeof(int32_t));
+    Lockstep->Running = LockstepAlloc(Padded * sizeof(int32_t));
+    Lockstep->Dense = LockstepAlloc(Padded * sizeof(int32_t));
+    Lockstep->FreeCells = LockstepAlloc(Padded * sizeof(uint32_t*));
+    Lockstep->FreeIndex = LockstepAlloc(Padded * sizeof(uint32_t*));
+    Lockstep->FreeCount = LockstepAlloc(Padded * sizeof(int32_t));
+
+    // Padding lanes never run
+
+    for(int Lane = 0; Lane < Count; ++Lane) {
+        LockstepLaneInit(Lockstep, Lane, Seed + Lane);
+    }
+}
+
+void LockstepFree(lockstep* Lockstep) {
+    for(int Lane = 0; Lane < Lockstep->Padded; ++Lane) {
+        LockstepFreeFreeCells(Lockstep, Lane);
+    }
+    free(Lockstep->Occupied);
+    free(Lockstep->Body);
+    free(Lockstep->Inputs);
+    free(Lockstep->Tick);
+    free(Lockstep->Rng);
+    free(Lockstep->Head);
+    free(Lockstep->Food);
+    free(Lockstep->Direction);
+    free(Lockstep->TailLength);
+    free(Lockstep->BodyHead);
+    free(Lockstep->BodyLength);
+    free(Lockstep->Growing);
+    free(Lockstep->Running);
+    free(Lockstep->Dense);
+    free(Lockstep->FreeCells);
+    free(Lockstep->FreeIndex);
+    free(Lockstep->FreeCount);
+    *Lockstep = (lockstep){0};
+}
+
+// One tick of one lane, GameUpdate() on the lane's arrays
+
+void LockstepStepLane(lockstep* Lockstep, int Lane) {
+
+    ++Lockstep->Tick[Lane];
+
+    // Move tail
+
+    uint32_t HeadCell = Lockstep->Head[Lane];
+    uint32_t TailCell = LockstepGetPieceCell(Lockstep, Lane, Lockstep->BodyLength[Lane] - 1);
+    int Growing = Lockstep->Growing[Lane];
+
+    if(Growing) {
+        --Lockstep->Growing[Lane];
+    } else {
+        --Lockstep->BodyLength[Lane];
+        LockstepVacateCell(Lockstep, Lane, TailCell);
+    }
+
+    // Head direction
+
+    int Direction = Lockstep->Inputs[Lane];
+    if(Direction >= 0 && Direction < KEYSAMOUNT) {
+        if(Lockstep->TailLength[Lane] == 0 ||
+           !IsOppositeDirection(Lockstep->Direction[Lane], Direction)) {
+            Lockstep->Direction[Lane] = Direction;
+        }
+    }
+
+    // Move head
+
+    uint32_t NewCell = HeadCell + Lockstep->Steps[Lockstep->Direction[Lane]];
+
+    if(LockstepIsBlocked(Lockstep, Lane, NewCell)) {
+        Lockstep->Running[Lane] = 0;
+
+        if(Growing) {
+            ++Lockstep->Growing[Lane];
+        } else {
+            ++Lockstep->BodyLength[Lane];
+            LockstepOccupyCell(Lockstep, Lane, TailCell);
+        }
+    } else {
+        LockstepPushHead(Lockstep, Lane, NewCell);
+        LockstepOccupyCell(Lockstep, Lane, NewCell);
+
+        if(NewCell == Lockstep->Food[Lane]) {
+            ++Lockstep->Growing[Lane];
+            ++Lockstep->TailLength[Lane];
+            Lockstep->Food[Lane] = LockstepRandomFreeCell(Lockstep, Lane);
+        }
+    }
+}
+
+// Kernels, they step every running lane by one tick
+
+void LockstepStepScalar(lockstep* Lockstep) {
+    for(int Lane = 0; Lane < Lockstep->Count; ++Lane) {
+        if(Lockstep->Running[Lane]) LockstepStepLane(Lockstep, Lane);
+    }
+}
+
+// The common tick is the one where the head moves onto a free cell (or
+// the cell the tail leaves) that isn't food and the lane doesn't need
+// its free cell array. Everything about it is decided before anything is
+// written, so the other lanes can go to LockstepStepLane() as they were.
+
+LOCKSTEP_TARGET("avx2")
+void LockstepStepAvx2(lockstep* Lockstep) {
+    int BodyShift = Lockstep->BodyShift;
+    __m256i Zero = _mm256_setzero_si256();
+    __m256i One = _mm256_set1_epi32(1);
+    __m256i Two = _mm256_set1_epi32(2);
+    __m256i Keys = _mm256_set1_epi32(KEYSAMOUNT);
+    __m256i NoInput = _mm256_set1_epi32(-1);
+    __m256i Area = _mm256_set1_epi32(Lockstep->Area);
+    __m256i RingMask = _mm256_set1_epi32((1 << BodyShift) - 1);
+    __m256i Steps = _mm256_setr_epi32(Lockstep->Steps[0], Lockstep->Steps[1],
+                                      Lockstep->Steps[2], Lockstep->Steps[3], 0, 0, 0, 0);
+    __m256i Lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i WordOffsets = _mm256_mullo_epi32(Lanes, _mm256_set1_epi32(Lockstep->Words));
+    __m256i BodyOffsets = _mm256_slli_epi32(Lanes, BodyShift);
+
+    for(int Base = 0; Base < Lockstep->Count; Base += 8) {
+        int Running = _mm256_movemask_ps(_mm256_castsi256_ps(
+            _mm256_cmpgt_epi32(_mm256_loadu_si256((__m256i*)(Lockstep->Running + Base)), Zero)));
+        if(!Running) continue;
+
+        uint32_t* Occupied = LockstepLaneOccupied(Lockstep, Base);
+        uint32_t* Body = LockstepLaneBody(Lockstep, Base);
+
+        __m256i Head = _mm256_loadu_si256((__m256i*)(Lockstep->Head + Base));
+        __m256i Food = _mm256_loadu_si256((__m256i*)(Lockstep->Food + Base));
+        __m256i Direction = _mm256_loadu_si256((__m256i*)(Lockstep->Direction + Base));
+        __m256i TailLength = _mm256_loadu_si256((__m256i*)(Lockstep->TailLength + Base));
+        __m256i BodyHead = _mm256_loadu_si256((__m256i*)(Lockstep->BodyHead + Base));
+        __m256i BodyLength = _mm256_loadu_si256((__m256i*)(Lockstep->BodyLength + Base));
+        __m256i Growing = _mm256_loadu_si256((__m256i*)(Lockstep->Growing + Base));
+        __m256i Dense = _mm256_loadu_si256((__m256i*)(Lockstep->Dense + Base));
+        __m256i Input = _mm256_cvtepi8_epi32(_mm_loadl_epi64((__m128i*)(Lockstep->Inputs + Base)));
+
+        __m256i Candidate = _mm256_andnot_si256(_mm256_cmpgt_epi32(Dense, Zero),
+            _mm256_cmpgt_epi32(_mm256_loadu_si256((__m256i*)(Lockstep->Running + Base)), Zero));
+
+        // Head direction
+
+        __m256i Turn = _mm256_and_si256(_mm256_cmpgt_epi32(Input, NoInput), _mm256_cmpgt_epi32(Keys, Input));
+        __m256i Allowed = _mm256_or_si256(_mm256_cmpeq_epi32(TailLength, Zero),
+            _mm256_xor_si256(_mm256_cmpeq_epi32(_mm256_xor_si256(Direction, Input), Two), NoInput));
+        Direction = _mm256_blendv_epi8(Direction, Input, _mm256_and_si256(Turn, Allowed));
+
+        // Move head
+
+        __m256i NewCell = _mm256_add_epi32(Head, _mm256_permutevar8x32_epi32(Steps, Direction));
+        __m256i TailIndex = _mm256_and_si256(_mm256_add_epi32(BodyHead, _mm256_sub_epi32(BodyLength, One)), RingMask);
+        __m256i TailCell = _mm256_mask_i32gather_epi32(Zero, (int*)Body,
+            _mm256_add_epi32(BodyOffsets, TailIndex), Candidate, 4);
+        __m256i Words = _mm256_mask_i32gather_epi32(Zero, (int*)Occupied,
+            _mm256_add_epi32(WordOffsets, _mm256_srli_epi32(NewCell, 5)), Candidate, 4);
+        __m256i Blocked = _mm256_and_si256(_mm256_srlv_epi32(Words, _mm256_and_si256(NewCell, _mm256_set1_epi32(31))), One);
+
+        __m256i NotGrowing = _mm256_cmpeq_epi32(Growing, Zero);
+        __m256i FreesTail = _mm256_and_si256(NotGrowing, _mm256_cmpeq_epi32(NewCell, TailCell));
+        __m256i NewLength = _mm256_sub_epi32(BodyLength, _mm256_xor_si256(NotGrowing, NoInput));
+        __m256i Free = _mm256_or_si256(_mm256_cmpeq_epi32(Blocked, Zero), FreesTail);
+        __m256i NotFood = _mm256_xor_si256(_mm256_cmpeq_epi32(NewCell, Food), NoInput);
+        __m256i Fits = _mm256_xor_si256(_mm256_cmpgt_epi32(_mm256_add_epi32(NewLength, NewLength), Area), NoInput);
+        __m256i Simple = _mm256_and_si256(_mm256_and_si256(Candidate, Free), _mm256_and_si256(NotFood, Fits));
+
+        // No scatters in AVX2, bitmap and ring are written per lane
+
+        BodyHead = _mm256_and_si256(_mm256_sub_epi32(BodyHead, One), RingMask);
+        Growing = _mm256_add_epi32(Growing, _mm256_andnot_si256(NotGrowing, NoInput));
+
+        int SimpleMask = _mm256_movemask_ps(_mm256_castsi256_ps(Simple));
+        int GrowingMask = _mm256_movemask_ps(_mm256_castsi256_ps(NotGrowing)) ^ 0xff;
+
+        uint32_t NewCells[8];
+        uint32_t TailCells[8];
+        int32_t BodyHeads[8];
+        _mm256_storeu_si256((__m256i*)NewCells, NewCell);
+        _mm256_storeu_si256((__m256i*)TailCells, TailCell);
+        _mm256_storeu_si256((__m256i*)BodyHeads, BodyHead);
+
+        for(int Bits = SimpleMask; Bits; Bits &= Bits - 1) {
+            int Index = __builtin_ctz(Bits);
+            int Lane = Base + Index;
+            if(!(GrowingMask & (1 << Index))) LockstepClearCell(Lockstep, Lane, TailCells[Index]);
+            LockstepSetCell(Lockstep, Lane, NewCells[Index]);
+            Body[((size_t)Index << BodyShift) + BodyHeads[Index]] = NewCells[Index];
+            ++Lockstep->Tick[Lane];
+        }
+
+        _mm256_maskstore_epi32((int*)(Lockstep->Head + Base), Simple, NewCell);
+        _mm256_maskstore_epi32((int*)(Lockstep->Direction + Base), Simple, Direction);
+        _mm256_maskstore_epi32((int*)(Lockstep->BodyHead + Base), Simple, BodyHead);
+        _mm256_maskstore_epi32((int*)(Lockstep->BodyLength + Base), Simple, NewLength);
+        _mm256_maskstore_epi32((int*)(Lockstep->Growing + Base), Simple, Growing);
+
+        for(int Bits = Running & ~SimpleMask; Bits; Bits &= Bits - 1) {
+            LockstepStepLane(Lockstep, Base + __builtin_ctz(Bits));
+        }
+    }
+}
+
+LOCKSTEP_TARGET("avx512f")
+void LockstepStepAvx512(lockstep* Lockstep) {
+    int BodyShift = Lockstep->BodyShift;
+    __m512i Zero = _mm512_setzero_si512();
+    __m512i One = _mm512_set1_epi32(1);
+    __m512i Two = _mm512_set1_epi32(2);
+    __m512i Keys = _mm512_set1_epi32(KEYSAMOUNT);
+    __m512i Area = _mm512_set1_epi32(Lockstep->Area);
+    __m512i BitMask = _mm512_set1_epi32(31);
+    __m512i RingMask = _mm512_set1_epi32((1 << BodyShift) - 1);
+    __m512i Steps = _mm512_setr_epi32(Lockstep->Steps[0], Lockstep->Steps[1],
+                                      Lockstep->Steps[2], Lockstep->Steps[3],
+                                      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    __m512i Lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i WordOffsets = _mm512_mullo_epi32(Lanes, _mm512_set1_epi32(Lockstep->Words));
+    __m512i BodyOffsets = _mm512_slli_epi32(Lanes, BodyShift);
+
+    for(int Base = 0; Base < Lockstep->Count; Base += 16) {
+        __mmask16 Running = _mm512_cmpneq_epi32_mask(_mm512_loadu_si512(Lockstep->Running + Base), Zero);
+        if(!Running) continue;
+
+        uint32_t* Occupied = LockstepLaneOccupied(Lockstep, Base);
+        uint32_t* Body = LockstepLaneBody(Lockstep, Base);
+
+        __m512i Head = _mm512_loadu_si512(Lockstep->Head + Base);
+        __m512i Food = _mm512_loadu_si512(Lockstep->Food + Base);
+        __m512i Direction = _mm512_loadu_si512(Lockstep->Direction + Base);
+        __m512i TailLength = _mm512_loadu_si512(Lockstep->TailLength + Base);
+        __m512i BodyHead = _mm512_loadu_si512(Lockstep->BodyHead + Base);
+        __m512i BodyLength = _mm512_loadu_si512(Lockstep->BodyLength + Base);
+        __m512i Growing = _mm512_loadu_si512(Lockstep->Growing + Base);
+        __m512i Input = _mm512_cvtepi8_epi32(_mm_loadu_si128((__m128i*)(Lockstep->Inputs + Base)));
+
+        __mmask16 Candidate = _mm512_mask_cmpeq_epi32_mask(Running, _mm512_loadu_si512(Lockstep->Dense + Base), Zero);
+
+        // Head direction
+
+        __mmask16 Turn = _mm512_cmpge_epi32_mask(Input, Zero) & _mm512_cmplt_epi32_mask(Input, Keys);
+        __mmask16 Allowed = _mm512_cmpeq_epi32_mask(TailLength, Zero) |
+                            _mm512_cmpneq_epi32_mask(_mm512_xor_si512(Direction, Input), Two);
+        Direction = _mm512_mask_mov_epi32(Direction, Turn & Allowed, Input);
+
+        // Move head
+
+        __m512i NewCell = _mm512_add_epi32(Head, _mm512_permutexvar_epi32(Direction, Steps));
+        __m512i TailIndex = _mm512_and_si512(_mm512_add_epi32(BodyHead, _mm512_sub_epi32(BodyLength, One)), RingMask);
+        __m512i TailCell = _mm512_mask_i32gather_epi32(Zero, Candidate, _mm512_add_epi32(BodyOffsets, TailIndex), Body, 4);
+        __m512i NewWord = _mm512_add_epi32(WordOffsets, _mm512_srli_epi32(NewCell, 5));
+        __m512i Words = _mm512_mask_i32gather_epi32(Zero, Candidate, NewWord, Occupied, 4);
+        __mmask16 Blocked = _mm512_test_epi32_mask(_mm512_srlv_epi32(Words, _mm512_and_si512(NewCell, BitMask)), One);
+
+        __mmask16 NotGrowing = _mm512_cmpeq_epi32_mask(Growing, Zero);
+        __mmask16 FreesTail = NotGrowing & _mm512_cmpeq_epi32_mask(NewCell, TailCell);
+        __m512i NewLength = _mm512_mask_add_epi32(BodyLength, ~NotGrowing, BodyLength, One);
+        __mmask16 Simple = Candidate & (~Blocked | FreesTail) &
+                           _mm512_cmpneq_epi32_mask(NewCell, Food) &
+                           _mm512_cmple_epi32_mask(_mm512_add_epi32(NewLength, NewLength), Area);
+
+        // Tail leaves, then the head arrives, they can share a word
+
+        __mmask16 Pop = Simple & NotGrowing;
+        __m512i TailWord = _mm512_add_epi32(WordOffsets, _mm512_srli_epi32(TailCell, 5));
+        __m512i TailWords = _mm512_mask_i32gather_epi32(Zero, Pop, TailWord, Occupied, 4);
+        TailWords = _mm512_andnot_si512(_mm512_sllv_epi32(One, _mm512_and_si512(TailCell, BitMask)), TailWords);
+        _mm512_mask_i32scatter_epi32(Occupied, Pop, TailWord, TailWords, 4);
+
+        Words = _mm512_mask_i32gather_epi32(Zero, Simple, NewWord, Occupied, 4);
+        Words = _mm512_or_si512(Words, _mm512_sllv_epi32(One, _mm512_and_si512(NewCell, BitMask)));
+        _mm512_mask_i32scatter_epi32(Occupied, Simple, NewWord, Words, 4);
+
+        BodyHead = _mm512_and_si512(_mm512_sub_epi32(BodyHead, One), RingMask);
+        _mm512_mask_i32scatter_epi32(Body, Simple, _mm512_add_epi32(BodyOffsets, BodyHead), NewCell, 4);
+
+        _mm512_mask_storeu_epi32(Lockstep->Head + Base, Simple, NewCell);
+        _mm512_mask_storeu_epi32(Lockstep->Direction + Base, Simple, Direction);
+        _mm512_mask_storeu_epi32(Lockstep->BodyHead + Base, Simple, BodyHead);
+        _mm512_mask_storeu_epi32(Lockstep->BodyLength + Base, Simple, NewLength);
+        _mm512_mask_storeu_epi32(Lockstep->Growing + Base, Simple & ~NotGrowing, _mm512_sub_epi32(Growing, One));
+
+        __m512i OneTick = _mm512_set1_epi64(1);
+        __m512i TickLow = _mm512_loadu_si512(Lockstep->Tick + Base);
+        __m512i TickHigh = _mm512_loadu_si512(Lockstep->Tick + Base + 8);
+        _mm512_mask_storeu_epi64(Lockstep->Tick + Base, (__mmask8)Simple, _mm512_add_epi64(TickLow, OneTick));
+        _mm512_mask_storeu_epi64(Lockstep->Tick + Base + 8, (__mmask8)(Simple >> 8), _mm512_add_epi64(TickHigh, OneTick));
+
+        for(int Bits = Running & ~Simple; Bits; Bits &= Bits - 1) {
+            LockstepStepLane(Lockstep, Base + __builtin_ctz(Bits));
+        }
+    }
+}
+
+int LockstepKernelSupported(int Kernel) {
+    if(Kernel == LOCKSTEP_AVX512) return __builtin_cpu_supports("avx512f");
+    if(Kernel == LOCKSTEP_AVX2) return __builtin_cpu_supports("avx2");
+    return 1;
+}
+
+int LockstepBestKernel() {
+    for(int Kernel = LOCKSTEP_KERNELS - 1; Kernel > LOCKSTEP_SCALAR; --Kernel) {
+        if(LockstepKernelSupported(Kernel)) return Kernel;
+    }
+    return LOCKSTEP_SCALAR;
+}
+
+// Advances every running lane by one tick using Inputs
+
+void LockstepStep(lockstep* Lockstep, int Kernel) {
+    switch(Kernel) {
+        case LOCKSTEP_AVX512: LockstepStepAvx512(Lockstep); break;
+        case LOCKSTEP_AVX2: LockstepStepAvx2(Lockstep); break;
+        default: LockstepStepScalar(Lockstep); break;
+    }
+}
+
+// Same as GameHash() of the game the lane is playing
+
+uint64_t LockstepLaneHash(lockstep* Lockstep, int Lane) {
+    uint64_t Hash = 0xcbf29ce484222325ull;
+    int Running = Lockstep->Running[Lane];
+    int TailLength = Lockstep->TailLength[Lane];
+    int Growing = Lockstep->Growing[Lane];
+    int Direction = Lockstep->Direction[Lane];
+    int BodyLength = Lockstep->BodyLength[Lane];
+    Hash = HashBytes(Hash, &Lockstep->Tick[Lane], sizeof(uint64_t));
+    Hash = HashBytes(Hash, &Lockstep->Rng[Lane], sizeof(rng));
+    Hash = HashBytes(Hash, &Lockstep->Food[Lane], sizeof(uint32_t));
+    Hash = HashBytes(Hash, &Running, sizeof(Running));
+    Hash = HashBytes(Hash, &TailLength, sizeof(TailLength));
+    Hash = HashBytes(Hash, &Growing, sizeof(Growing));
+    Hash = HashBytes(Hash, &Direction, sizeof(Direction));
+    Hash = HashBytes(Hash, &BodyLength, sizeof(BodyLength));
+    for(int Index = 0; Index < BodyLength; ++Index) {
+        uint32_t Cell = LockstepGetPieceCell(Lockstep, Lane, Index);
+        Hash = HashBytes(Hash, &Cell, sizeof(Cell));
+    }
+    return Hash;
+}
@@ -1,293 +1,136 @@
 #define WIN32_LEAN_AND_MEAN
 #define COBJMACROS
 #include <stdio.h>
+#include <stddef.h>
 #include <assert.h>
 #include <d3d11_1.h>
 #include <windows.h>
 #include <time.h>
 
-typedef struct { float X, Y, Z; } v3;
-typedef struct { float R, G, B, A; } color;
-typedef struct { float M[4][4]; } matrix;
+#include "snake.c"
+#include "timestep.c"
+#include "replay.c"
+#include "autopilot.c"
+#include "input.c"
+#include "snapshot.c"
+#include "drawlist.c"
+#include "trace.c"
 
-typedef struct { 
-    v3 Position;
-    v3 Direction;
-    color Color;
-    int Waiting;
-} entity;
+// Globals. Game, Autopilot, Recording and InputMetrics belong to the
+// simulation thread once it runs, the render loop draws from Snapshots.
 
-#define MAX_ENTITIES 1000
+game Game;
 
-// Globals
-
-entity Entities[MAX_ENTITIES];
-v3 Camera = {8.0f, 9.0f, -22.0f};
-
-int EntitiesAmount;
-int TailLength;
-int XTiles = 20;
-int YTiles = 20;
-int HeadIndex;
-int FoodIndex;
-int Running = 1;
-int Pause;
-int Delay = 30;
-int DelayMin = 3;
+atomic_int Running = 1;
+atomic_int Pause;
 int EnableWireframe = 0;
+atomic_int EnableAutopilot = 0;
+autopilot Autopilot;
+recording Recording;
+tripleBuffer Snapshots;
 
-color ColorBGPlatform = {0.2f, 0.2f, 0.2f, 1.0f};
-color ColorBGPlatformLighter = {0.21f, 0.21f, 0.21f, 1.0f};
-color ColorHead = {1.0f, 0.05f, 0.95f, 1.0f};
-color ColorFood = {0.30f, 0.4f, 0.9f, 1.0f};
-color ColorBorder = {0.2f, 0.2f, 0.2f, 1.0f};
-color ColorWireframe = {0.3f, 0.3f, 0.3f, 1.0f};
-
-enum {UP, LEFT, DOWN, RIGHT, KEYSAMOUNT};
-
-typedef struct {
-    int Length;
-    int Values[2];
-} inputQueue;
-
-inputQueue InputQueue;
+// Key presses go through the ring to the simulation
 
-void InputQueueAdd(inputQueue* Q, int Direction) {
-    if(Q->Length >= 2) Q->Length = 0;
-    Q->Values[Q->Length] = Direction;
-    ++Q->Length;
-}
+inputRing InputRing;
+inputMetrics InputMetrics;
+int InputPolicy = INPUT_COALESCE | INPUT_REJECT_OPPOSITE | INPUT_DROP_OLDEST;
 
-int InputQueuePop(inputQueue* Q) {
-    if(Q->Length <= 0) return -1;
-    int Result = Q->Values[0];
-    if(Q->Length > 1) {
-        Q->Values[0] = Q->Values[1];
-    } 
-    --Q->Length;
-    return Result;
-}
+// D3D11 backend: the floor layer is an immutable vertex buffer made again
+// only when the floor changes, the other instances go into one dynamic
+// vertex buffer with one map per frame. Each pass is one DrawInstanced of
+// the square or its outline. The palette is a constant buffer that never
+// changes.
 
-int IsOppositeDirection(v3 A, v3 B) {
-    int Result = 0;
-    if(
-       (A.X == 1.0f  && B.X == -1.0f) ||
-       (A.X == -1.0f && B.X == 1.0f) ||
-       (A.Y == 1.0f  && B.Y == -1.0f) ||
-       (A.Y == -1.0f && B.Y == 1.0f)
-       ) {
-        Result = 1;
-    }
-    return Result;
-}
-
-v3 AddV3(v3 A, v3 B) {
-    v3 Result = {0};
-    Result.X += A.X + B.X;
-    Result.Y += A.Y + B.Y;
-    Result.Z += A.Z + B.Z;
-    return Result;
-}
-
-int IsZeroV3(v3 Vector) {
-    if(Vector.X == 0.0f &&
-       Vector.Y == 0.0f &&
-       Vector.Z == 0.0f) {
-        return 1; 
-    }
-    return 0;
-}
-
-int CompareV3(v3 A, v3 B) {
-    if(A.X == B.X &&
-       A.Y == B.Y &&
-       A.Z == B.Z) {
-        return 1; 
-    }
-    return 0;
-}
-
-void AddEntity(entity* Entity) {
-    Entities[EntitiesAmount++] = *Entity;
-}
-
-float GetRandomZeroToOne() {
-    return (float)rand() / (float)RAND_MAX ;
-}
-
-color GetRandomColor() {
-    return (color){
-        GetRandomZeroToOne(),
-        GetRandomZeroToOne(),
-        GetRandomZeroToOne(),
-    };
-}
-
-color GetRandomShadeOfGray() {
-    float Shade = GetRandomZeroToOne();
-    return (color){
-        Shade,
-        Shade,
-        Shade,
-    };
-}
-
-v3 GetRandomPosition() {
-    return (v3){
-        rand() % XTiles, 
-        rand() % YTiles,
-        0.0f,
-    };
-}
+typedef struct {
+    ID3D11Device1* Device;
+    ID3D11DeviceContext1* Context;
+    ID3D11Buffer* FrameConstants; // View-projection
+    ID3D11Buffer* PaletteConstants;
+    ID3D11Buffer* Instances;
+    int InstanceCapacity;
+    ID3D11Buffer* Floor;
+    uint64_t FloorVersion;
+    
+    ID3D11Buffer* Square; // TRIANGLE LIST
+    UINT SquareVertices;
+    ID3D11Buffer* Outline; // LINE LIST
+    UINT OutlineVertices;
+    
+    ID3D11RasterizerState* Solid;
+    ID3D11RasterizerState* Wireframe;
+} d3dBackend;
 
-void Init() {
-    
-    // Platform
+void D3DSubmit(void* Backend, drawList* List, matrix* ViewProjection) {
+    d3dBackend* D3D = Backend;
+    ID3D11DeviceContext1* Context = D3D->Context;
     
-    for(int Y = 0; Y < YTiles; ++Y) {
-        for(int X = 0; X < XTiles; ++X) {
-            entity Entity = {
-                .Position = {X, Y},
-                .Color = ColorBGPlatform,
-            };
-            
-            // Some lighter tiles
-            
-            if((rand() % 100) < 3) {
-                Entity.Color = ColorBGPlatformLighter;
-            }
-            AddEntity(&Entity);
-        }
-    }
-    
-    // Food
-    
-    FoodIndex = EntitiesAmount;
-    
-    entity Food = {
-        .Position = {rand() % XTiles, rand() % YTiles},
-        .Color = ColorFood,
-    };
-    
-    AddEntity(&Food);
-    
-    // Snake head
-    
-    HeadIndex = EntitiesAmount;
-    
-    entity Head = {
-        .Position = {XTiles / 2, YTiles / 2},
-        .Color = ColorHead,
-        .Direction = {1.0f, 0.0f, 0.0f},
-    };
-    
-    AddEntity(&Head);
-}
-
-int IsPositionOutOfBounds(v3 Position) {
-    if(Position.X >= XTiles ||
-       Position.Y >= YTiles ||
-       Position.X < 0 ||
-       Position.Y < 0) {
-        return 1; 
-    }
-    return 0;
-}
-
-int IsPositionTailPiece(v3 Position) {
-    for(int Index = HeadIndex + 1;
-        Index < EntitiesAmount;
-        ++Index) {
-        if(CompareV3(Position, Entities[Index].Position)) {
-            return 1;
-        }
+    if(List->Total > D3D->InstanceCapacity) {
+        if(D3D->Instances) ID3D11Buffer_Release(D3D->Instances);
+        D3D->InstanceCapacity = List->Total * 2;
+        
+        D3D11_BUFFER_DESC InstanceBufferDesc = {0};
+        InstanceBufferDesc.ByteWidth = D3D->InstanceCapacity * sizeof(drawInstance);
+        InstanceBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+        InstanceBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        InstanceBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        HRESULT Result = ID3D11Device1_CreateBuffer(D3D->Device, &InstanceBufferDesc, 0, &D3D->Instances);
+        assert(SUCCEEDED(Result));
     }
     
-    return 0;
-}
-
-void GrowSnake() {
-    
-    color Color = Entities[EntitiesAmount-1].Color;
-    Color.R -= 0.05f; 
-    Color.G += 0.05f; 
-    Color.B += 0.05f;
-    
-    entity TailPiece = {
-        .Position = Entities[EntitiesAmount-1].Position,
-        .Color = Color,
-        .Waiting = 1,
-    };
-    AddEntity(&TailPiece);
-    ++TailLength;
-}
-
-void Update() {
-    
-    // Move tail
-    
-    for(int Index = EntitiesAmount-1; 
-        Index >= HeadIndex + 1; 
-        --Index) {
+    if(D3D->FloorVersion != List->FloorVersion) {
+        if(D3D->Floor) ID3D11Buffer_Release(D3D->Floor);
+        D3D->FloorVersion = List->FloorVersion;
         
-        if(!Entities[Index].Waiting) {
-            Entities[Index].Position = Entities[Index-1].Position;
-        } else {
-            Entities[Index].Waiting = 0;
-        }
+        D3D11_BUFFER_DESC FloorBufferDesc = {0};
+        FloorBufferDesc.ByteWidth = 2 * List->FloorTiles * sizeof(drawInstance);
+        FloorBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+        FloorBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
         
+        D3D11_SUBRESOURCE_DATA FloorData = { List->Floor };
+        HRESULT Result = ID3D11Device1_CreateBuffer(D3D->Device, &FloorBufferDesc, &FloorData, &D3D->Floor);
+        assert(SUCCEEDED(Result));
     }
     
-    // Head direction
-    
-    v3 NewDirection = {0};
+    D3D11_MAPPED_SUBRESOURCE MappedSubresource;
+    ID3D11DeviceContext1_Map(Context, (ID3D11Resource*)D3D->FrameConstants, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedSubresource);
+    *(matrix*)MappedSubresource.pData = *ViewProjection;
+    ID3D11DeviceContext1_Unmap(Context, (ID3D11Resource*)D3D->FrameConstants, 0);
     
-    if(InputQueue.Length > 0) {
-        int Direction = InputQueuePop(&InputQueue);
-        if(Direction == UP) { 
-            NewDirection.Y = 1.0f; 
-        } else if(Direction == LEFT) { 
-            NewDirection.X = -1.0f; 
-        } else if(Direction == DOWN) { 
-            NewDirection.Y = -1.0f; 
-        } else if(Direction == RIGHT) { 
-            NewDirection.X = 1.0f; 
-        }
-    }
+    ID3D11DeviceContext1_Map(Context, (ID3D11Resource*)D3D->Instances, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedSubresource);
+    memcpy(MappedSubresource.pData, List->Instances, List->Total * sizeof(drawInstance));
+    ID3D11DeviceContext1_Unmap(Context, (ID3D11Resource*)D3D->Instances, 0);
     
-    entity* Head = &Entities[HeadIndex];
+    ID3D11Buffer* ConstantBuffers[] = {D3D->FrameConstants, D3D->PaletteConstants};
+    ID3D11DeviceContext1_VSSetConstantBuffers(Context, 0, 2, ConstantBuffers);
     
-    if(!IsZeroV3(NewDirection)) {
-        if(TailLength > 0) {
-            if(!IsOppositeDirection(Head->Direction, NewDirection)) {
-                Head->Direction = NewDirection;
-            }
-        } else {
-            Head->Direction = NewDirection;
-        }
-    }
-    
-    // Move head
-    
-    v3 NewPosition = AddV3(Head->Position, Head->Direction);
-    
-    if(IsPositionOutOfBounds(NewPosition) ||
-       IsPositionTailPiece(NewPosition)
-       ) {
-        Running = 0;
-    } else {
-        Head->Position = NewPosition;
+    for(int Pass = 0; Pass < DRAW_PASSES; ++Pass) {
+        if(!List->Count[Pass]) continue;
+        TRACE_START(PassStart);
         
-        // Food collision
+        int Outline = Pass == DRAW_BORDER;
+        int Wireframe = Pass == DRAW_FLOOR_WIREFRAME || Pass == DRAW_WIREFRAME;
+        ID3D11Buffer* Buffers[] = {Outline ? D3D->Outline : D3D->Square, IsFloorPass(Pass) ? D3D->Floor : D3D->Instances};
+        UINT Strides[] = {3 * sizeof(float), sizeof(drawInstance)};
+        UINT Offsets[] = {0, 0};
         
-        if(CompareV3(Head->Position, Entities[FoodIndex].Position)) {
-            if(Delay > DelayMin) Delay -= 1;
-            GrowSnake();
-            Entities[FoodIndex].Position = GetRandomPosition();
-        }
+        ID3D11DeviceContext1_IASetPrimitiveTopology(Context, Outline ? D3D11_PRIMITIVE_TOPOLOGY_LINELIST
+                                                                     : D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        ID3D11DeviceContext1_IASetVertexBuffers(Context, 0, 2, Buffers, Strides, Offsets);
+        ID3D11DeviceContext1_RSSetState(Context, Wireframe ? D3D->Wireframe : D3D->Solid);
+        ID3D11DeviceContext1_DrawInstanced(Context, Outline ? D3D->OutlineVertices : D3D->SquareVertices,
+                                           List->Count[Pass], 0, List->First[Pass]);
+        TRACE_ZONE(TRACE_PASS + Pass, PassStart);
     }
 }
 
+uint64_t GetNanoseconds() {
+    static LARGE_INTEGER Frequency;
+    if(!Frequency.QuadPart) QueryPerformanceFrequency(&Frequency);
+    LARGE_INTEGER Counter;
+    QueryPerformanceCounter(&Counter);
+    return (uint64_t)((double)Counter.QuadPart * 1e9 / (double)Frequency.QuadPart);
+}
+
 LRESULT CALLBACK 
 WindowProc(HWND Window, UINT Message, WPARAM WParam, LPARAM LParam) {
     switch(Message) {
@@ -297,16 +140,16 @@ WindowProc(HWND Window, UINT Message, WPARAM WParam, LPARAM LParam) {
                     DestroyWindow(Window); 
                 } break;
                 case VK_UP: { 
-                    InputQueueAdd(&InputQueue, UP);
+                    InputRingPush(&InputRing, UP, GetNanoseconds());
                 } break;
                 case VK_LEFT: { 
-                    InputQueueAdd(&InputQueue, LEFT);
+                    InputRingPush(&InputRing, LEFT, GetNanoseconds());
                 } break;
                 case VK_DOWN: { 
-                    InputQueueAdd(&InputQueue, DOWN);
+                    InputRingPush(&InputRing, DOWN, GetNanoseconds());
                 } break;
                 case VK_RIGHT: {
-                    InputQueueAdd(&InputQueue, RIGHT);
+                    InputRingPush(&InputRing, RIGHT, GetNanoseconds());
                 } break;
                 case VK_SPACE: {
                     Pause = (Pause ? 0 : 1);
@@ -314,6 +157,12 @@ WindowProc(HWND Window, UINT Message, WPARAM WParam, LPARAM LParam) {
                 case 'W': { // Toggle wireframe
                     EnableWireframe = (EnableWireframe ? 0 : 1);
                 } break;
+                case 'A': { // Toggle autopilot
+                    EnableAutopilot = (EnableAutopilot ? 0 : 1);
+                } break;
+                case 'T': { // Write the trace, when built with SNAKE_TRACE
+                    TraceWrite("trace.json", GetNanoseconds());
+                } break;
             }
             
         } break;
@@ -327,10 +176,84 @@ WindowProc(HWND Window, UINT Message, WPARAM WParam, LPARAM LParam) {
     return 0;
 }
 
+void WaitUntil(uint64_t Deadline) {
+    uint64_t Now = GetNanoseconds();
+    uint64_t SleepNanos = ClockSleepNanos(Now, Deadline);
+    if(SleepNanos) Sleep((DWORD)(SleepNanos / 1000000));
+    while(GetNanoseconds() < Deadline) {}
+}
+
+// Ticks at a fixed rate and publishes a snapshot after every batch of
+// ticks, however long frames take. Sleep has the default 15.6 ms
+// granularity unless the timer period is raised, so it is for as long as
+// this runs.
+
+DWORD WINAPI SimulationThread(LPVOID Parameter) {
+    TraceThread("simulation");
+    timeBeginPeriod(1);
+    fixedClock Clock;
+    ClockInit(&Clock, GetNanoseconds(), GetTickNanos(Game.Delay));
+    uint64_t BusyNanos = 0;
+    
+    SnapshotCopy(TripleBufferWriteSlot(&Snapshots), &Game, GetNanoseconds(), Clock.TickNanos);
+    TripleBufferPublish(&Snapshots);
+    
+    while(Running && Game.Running) {
+        WaitUntil(ClockNextTick(&Clock));
+        
+        uint64_t Now = GetNanoseconds();
+        if(Pause) {
+            ClockReset(&Clock, Now);
+            continue;
+        }
+        
+        int Ticks = ClockAdvance(&Clock, Now);
+        for(int Tick = 0; Tick < Ticks && Game.Running; ++Tick) {
+            InputDrain(&InputRing, &Game, InputPolicy, &InputMetrics);
+            if(EnableAutopilot) {
+                int Direction = AutopilotDirection(&Autopilot, &Game);
+                if(Direction >= 0) InputQueueAdd(&Game.InputQueue, Direction);
+            }
+            TRACE_START(UpdateStart);
+            GameUpdate(&Game);
+            TRACE_ZONE(TRACE_UPDATE, UpdateStart);
+            InputMetricsTick(&InputMetrics, &Game, GetNanoseconds());
+            RecordingTick(&Recording, &Game);
+            ClockSetTickNanos(&Clock, GetTickNanos(Game.Delay));
+        }
+        
+        if(Ticks) {
+            TRACE_START(PublishStart);
+            snapshot* Snapshot = TripleBufferWriteSlot(&Snapshots);
+            SnapshotCopy(Snapshot, &Game, Now, Clock.TickNanos);
+            Snapshot->Inputs = InputMetrics;
+            BusyNanos += GetNanoseconds() - Now;
+            Snapshot->SimulationBusyNanos = BusyNanos;
+            Snapshot->TickLatenessMean = Clock.Ticks ? Clock.LatenessSum / Clock.Ticks : 0;
+            Snapshot->TickLatenessMax = Clock.LatenessMax;
+            TripleBufferPublish(&Snapshots);
+            TRACE_ZONE(TRACE_PUBLISH, PublishStart);
+        }
+    }
+    
+    timeEndPeriod(1);
+    return 0;
+}
+
 int WINAPI 
 WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PSTR CmdLine, int CmdShow) {
     
-    srand(time(NULL));
+    // Board size from the command line, "a.exe 64 48"
+    
+    int XTiles = 20;
+    int YTiles = 20;
+    sscanf(CmdLine, "%d %d", &XTiles, &YTiles);
+    if(XTiles < 1 || XTiles > MAX_TILES) XTiles = 20;
+    if(YTiles < 1 || YTiles > MAX_TILES) YTiles = 20;
+    
+    InitPalette();
+    GameInit(&Game, XTiles, YTiles, (uint64_t)time(NULL));
+    AutopilotInit(&Autopilot, &Game, 4096);
     
     WNDCLASS WindowClass = {0};
     const char ClassName[] = "Window";
@@ -438,8 +361,14 @@ WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PSTR CmdLine, int CmdShow) {
     
     // Shaders
     
+    // The palette size comes from here so the two can't disagree
+    
+    char PaletteAmount[16];
+    snprintf(PaletteAmount, sizeof(PaletteAmount), "%d", PALETTE_AMOUNT);
+    D3D_SHADER_MACRO Defines[] = {{"PALETTE_AMOUNT", PaletteAmount}, {0, 0}};
+    
     ID3D10Blob* VSBlob;
-    D3DCompileFromFile(L"shaders.hlsl", 0, 0, "vs_main", "vs_5_0", 0, 0, &VSBlob, 0);
+    D3DCompileFromFile(L"shaders.hlsl", Defines, 0, "vs_main", "vs_5_0", 0, 0, &VSBlob, 0);
     ID3D11VertexShader* VertexShader;
     Result = ID3D11Device1_CreateVertexShader(Device,
                                               ID3D10Blob_GetBufferPointer(VSBlob),
@@ -449,7 +378,7 @@ WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PSTR CmdLine, int CmdShow) {
     assert(SUCCEEDED(Result));
     
     ID3D10Blob* PSBlob;
-    D3DCompileFromFile(L"shaders.hlsl", 0, 0, "ps_main", "ps_5_0", 0, 0, &PSBlob, 0);
+    D3DCompileFromFile(L"shaders.hlsl", Defines, 0, "ps_main", "ps_5_0", 0, 0, &PSBlob, 0);
     ID3D11PixelShader* PixelShader;
     Result = ID3D11Device1_CreatePixelShader(Device,
                                              ID3D10Blob_GetBufferPointer(PSBlob),
@@ -458,14 +387,24 @@ WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PSTR CmdLine, int CmdShow) {
                                              &PixelShader);
     assert(SUCCEEDED(Result));
     
-    // Data layout
+    // Data layout: square vertices in slot 0, drawInstance in slot 1
     
     D3D11_INPUT_ELEMENT_DESC InputElementDesc[] = {
         {
             "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 
             0, 0, 
             D3D11_INPUT_PER_VERTEX_DATA, 0
-        }
+        },
+        {
+            "INSTANCE", 0, DXGI_FORMAT_R32G32_FLOAT,
+            1, offsetof(drawInstance, X),
+            D3D11_INPUT_PER_INSTANCE_DATA, 1
+        },
+        {
+            "PALETTE", 0, DXGI_FORMAT_R16G16_UINT,
+            1, offsetof(drawInstance, Palette),
+            D3D11_INPUT_PER_INSTANCE_DATA, 1
+        },
     };
     
     ID3D11InputLayout* InputLayout;
@@ -478,29 +417,19 @@ WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PSTR CmdLine, int CmdShow) {
                                              );
     assert(SUCCEEDED(Result));
     
-    // Rectangle vertex data (TRIANGLE LIST)
-    
-    float VertexData[] = {
-        -0.5f, -0.5f, 0.0f,
-        -0.5f, 0.5f, 0.0f,
-        0.5f, 0.5f, 0.0f,
-        -0.5f, -0.5f, 0.0f,
-        0.5f, 0.5f, 0.0f,
-        0.5f, -0.5f, 0.0f,
-    };
+    // Square vertex data (TRIANGLE LIST)
     
     UINT Stride = 3 * sizeof(float);
-    UINT NumVertices = sizeof(VertexData) / Stride;
-    UINT Offset = 0;
+    UINT NumVertices = sizeof(DrawSquareVertices) / Stride;
     
     D3D11_BUFFER_DESC BufferDesc = {
-        sizeof(VertexData),
+        sizeof(DrawSquareVertices),
         D3D11_USAGE_DEFAULT,
         D3D11_BIND_VERTEX_BUFFER,
         0, 0, 0
     };
     
-    D3D11_SUBRESOURCE_DATA InitialData = { VertexData };
+    D3D11_SUBRESOURCE_DATA InitialData = { DrawSquareVertices };
     
     ID3D11Buffer* Buffer;
     Result = ID3D11Device1_CreateBuffer(Device, &BufferDesc, &InitialData, &Buffer);
@@ -508,45 +437,26 @@ WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PSTR CmdLine, int CmdShow) {
     
     // Border vertex data (LINE LIST)
     
-    float BorderVertexData[] = {
-        -0.5f, -0.5f, 0.0f,
-        -0.5f, 0.5f, 0.0f,
-        -0.5f, 0.5f, 0.0f,
-        0.5f, 0.5f, 0.0f,
-        0.5f, 0.5f, 0.0f,
-        0.5f, -0.5f, 0.0f,
-        0.5f, -0.5f, 0.0f,
-        -0.5f, -0.5f, 0.0f,
-    };
-    
     UINT BorderStride = 3 * sizeof(float);
-    UINT BorderNumVertices = sizeof(BorderVertexData) / BorderStride;
-    UINT BorderOffset = 0;
+    UINT BorderNumVertices = sizeof(DrawOutlineVertices) / BorderStride;
     
     D3D11_BUFFER_DESC BorderBufferDesc = {
-        sizeof(BorderVertexData),
+        sizeof(DrawOutlineVertices),
         D3D11_USAGE_DEFAULT,
         D3D11_BIND_VERTEX_BUFFER,
         0, 0, 0
     };
     
-    D3D11_SUBRESOURCE_DATA BorderInitialData = { BorderVertexData };
+    D3D11_SUBRESOURCE_DATA BorderInitialData = { DrawOutlineVertices };
     
     ID3D11Buffer* BorderBuffer;
     Result = ID3D11Device1_CreateBuffer(Device, &BorderBufferDesc, &BorderInitialData, &BorderBuffer);
     assert(SUCCEEDED(Result));
     
-    // Constant buffer
-    
-    typedef struct {
-        matrix Model;
-        matrix View;
-        matrix Projection;
-        color Color;
-    } constants;
+    // Constant buffers: view-projection every frame, the palette once
     
     D3D11_BUFFER_DESC ConstantBufferDesc = {0};
-    ConstantBufferDesc.ByteWidth  = sizeof(constants);
+    ConstantBufferDesc.ByteWidth  = sizeof(matrix);
     ConstantBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
     ConstantBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
     ConstantBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
@@ -555,6 +465,17 @@ WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PSTR CmdLine, int CmdShow) {
     Result = ID3D11Device1_CreateBuffer(Device, &ConstantBufferDesc, NULL, &ConstantBuffer);
     assert(SUCCEEDED(Result));
     
+    D3D11_BUFFER_DESC PaletteBufferDesc = {0};
+    PaletteBufferDesc.ByteWidth  = sizeof(Palette);
+    PaletteBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    PaletteBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    
+    D3D11_SUBRESOURCE_DATA PaletteData = { Palette };
+    
+    ID3D11Buffer* PaletteBuffer;
+    Result = ID3D11Device1_CreateBuffer(Device, &PaletteBufferDesc, &PaletteData, &PaletteBuffer);
+    assert(SUCCEEDED(Result));
+    
     // Viewport
     
     RECT WindowRect;
@@ -564,28 +485,7 @@ WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PSTR CmdLine, int CmdShow) {
         (FLOAT)(WindowRect.bottom - WindowRect.top),
         0.0f, 1.0f };
     
-    // Projection matrix
-    
-    float AspectRatio = Viewport.Width / Viewport.Height;
-    float Height = 1.0f;
-    float Near = 1.0f;
-    float Far = 100.0f;
-    
-    matrix ProjectionMatrix = {
-        2.0f * Near / AspectRatio, 0.0f, 0.0f, 0.0f, 
-        0.0f, 2.0f * Near / Height, 0.0f, 0.0f, 
-        0.0f, 0.0f, Far / (Far - Near), 1.0f, 
-        0.0f, 0.0f, Near * Far / (Near - Far), 0.0f 
-    };
-    
-    // View matrix
-    
-    matrix ViewMatrix = {
-        1.0f, 0.0f, 0.0f, 0.0f,
-        0.0f, 1.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 1.0f, 0.0f,
-        -Camera.X, -Camera.Y, -Camera.Z, 1.0f,
-    };
+    matrix ViewProjection = DrawViewProjection(XTiles, YTiles, Viewport.Width / Viewport.Height);
     
     // Rasterizer states (only needed for wireframe toggling)
     
@@ -608,23 +508,60 @@ WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PSTR CmdLine, int CmdShow) {
     Result = ID3D11Device1_CreateRasterizerState(Device, &RasterizerDescWireframe, &RasterizerStateWireframe);
     assert(SUCCEEDED(Result));
     
-    Init();
     
-    int Counter = 0;
+    d3dBackend D3D = {
+        .Device = Device,
+        .Context = Context,
+        .FrameConstants = ConstantBuffer,
+        .PaletteConstants = PaletteBuffer,
+        .Square = Buffer,
+        .SquareVertices = NumVertices,
+        .Outline = BorderBuffer,
+        .OutlineVertices = BorderNumVertices,
+        .Solid = RasterizerStateDefault,
+        .Wireframe = RasterizerStateWireframe,
+    };
+    drawBackend Backend = {&D3D, D3DSubmit};
+    drawList DrawList = {0};
+    
+    // Every game is recorded, "headless replay last.rec" plays it back
+    
+    RecordingBegin(&Recording, &Game);
+    
+    TraceInit(GetNanoseconds());
+    TraceThread("render");
+    InputRingInit(&InputRing);
+    TripleBufferInit(&Snapshots);
+    HANDLE Simulation = CreateThread(0, 0, SimulationThread, 0, 0, 0);
+    assert(Simulation);
+    
+    inputMetrics PresentMetrics = {0};
+    uint64_t RenderBusyNanos = 0;
+    uint64_t StartNanos = GetNanoseconds();
+    uint64_t TitleNanos = StartNanos;
     
     while(Running) {
+        TRACE_START(PumpStart);
         MSG Message;
         while(PeekMessage(&Message, NULL, 0, 0, PM_REMOVE)) {
             if(Message.message == WM_QUIT) Running = 0;
             TranslateMessage(&Message);
             DispatchMessage(&Message);
         }
+        TRACE_ZONE(TRACE_PUMP, PumpStart);
         
-        if(Counter > Delay && !Pause) {
-            Update();
-            Counter = 0;
+        // Draw the newest snapshot, the simulation ticks on its own
+        
+        uint64_t FrameNanos = GetNanoseconds();
+        snapshot* Snapshot = TripleBufferRead(&Snapshots);
+        if(!Snapshot) {
+            Sleep(1);
+            continue;
         }
-        ++Counter;
+        game* View = &Snapshot->Game;
+        if(!View->Running) break;
+        
+        float Alpha = SnapshotAlpha(Snapshot, FrameNanos);
         
         // Clear
         
@@ -637,102 +574,54 @@ WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PSTR CmdLine, int CmdShow) {
         ID3D11DeviceContext1_OMSetRenderTargets(Context, 1, &RenderTargetView, 0);
         ID3D11DeviceContext1_IASetInputLayout(Context, InputLayout);
         ID3D11DeviceContext1_VSSetShader(Context, VertexShader, 0, 0);
-        ID3D11DeviceContext1_VSSetConstantBuffers(Context, 0, 1, &ConstantBuffer);
         ID3D11DeviceContext1_PSSetShader(Context, PixelShader, 0, 0);
         
-        ID3D11DeviceContext1_RSSetState(Context, RasterizerStateDefault);
+        // Draw everything, one instanced draw per pass
         
-        // Draw entities
+        TRACE_START(BuildStart);
+        DrawListBuild(&DrawList, View, Alpha, EnableWireframe);
+        TRACE_ZONE(TRACE_BUILD, BuildStart);
+        TRACE_START(SubmitStart);
+        DrawListSubmit(&DrawList, &Backend, &ViewProjection);
+        TRACE_ZONE(TRACE_SUBMIT, SubmitStart);
         
-        ID3D11DeviceContext1_IASetPrimitiveTopology(Context, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        ID3D11DeviceContext1_IASetVertexBuffers(Context, 0, 1, &Buffer, &Stride, &Offset);
+        // Swap
         
-        for(int Index = 0; Index < EntitiesAmount; ++Index) {
-            entity* Entity = &Entities[Index];
-            D3D11_MAPPED_SUBRESOURCE MappedSubresource;
-            ID3D11DeviceContext1_Map(Context, (ID3D11Resource*)ConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedSubresource);
-            constants *Constants = (constants*)MappedSubresource.pData;
-            Constants->Model = (matrix){
-                1.0f, 0.0f, 0.0f, 0.0f, 
-                0.0f, 1.0f, 0.0f, 0.0f, 
-                0.0f, 0.0f, 1.0f, 0.0f, 
-                Entity->Position.X, 
-                Entity->Position.Y, 
-                Entity->Position.Z, 1.0f
-            };
-            
-            Constants->View = ViewMatrix;
-            Constants->Projection = ProjectionMatrix;
-            Constants->Color = Entity->Color;
-            ID3D11DeviceContext1_Unmap(Context, (ID3D11Resource*)ConstantBuffer, 0);
-            ID3D11DeviceContext1_Draw(Context, NumVertices, 0);
-        }
+        RenderBusyNanos += GetNanoseconds() - FrameNanos;
+        TRACE_START(PresentStart);
+        IDXGISwapChain1_Present(SwapChain, 1, 0);
+        TRACE_ZONE(TRACE_PRESENT, PresentStart);
         
-        // Draw snake segment borders with lines
+        // Every input applied by the ticks this frame shows and no frame
+        // before it, skipped snapshots included
         
-        ID3D11DeviceContext1_IASetPrimitiveTopology(Context, D3D11_PRIMITIVE_TOPOLOGY_LINELIST);
-        ID3D11DeviceContext1_IASetVertexBuffers(Context, 0, 1, &BorderBuffer, &BorderStride, &BorderOffset);
+        uint64_t Presented = GetNanoseconds();
+        InputMetricsPresent(&PresentMetrics, &Snapshot->Inputs, Presented);
         
-        for(int Index = HeadIndex; Index < EntitiesAmount; ++Index) {
-            entity* Entity = &Entities[Index];
-            D3D11_MAPPED_SUBRESOURCE MappedSubresource;
-            ID3D11DeviceContext1_Map(Context, (ID3D11Resource*)ConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedSubresource);
-            constants *Constants = (constants*)MappedSubresource.pData;
-            Constants->Model = (matrix){
-                1.0f, 0.0f, 0.0f, 0.0f, 
-                0.0f, 1.0f, 0.0f, 0.0f, 
-                0.0f, 0.0f, 1.0f, 0.0f, 
-                Entity->Position.X, 
-                Entity->Position.Y, 
-                Entity->Position.Z, 1.0f
-            };
-            
-            Constants->View = ViewMatrix;
-            Constants->Projection = ProjectionMatrix;
-            Constants->Color = ColorBGPlatform;
-            ID3D11DeviceContext1_Unmap(Context, (ID3D11Resource*)ConstantBuffer, 0);
-            ID3D11DeviceContext1_Draw(Context, BorderNumVertices, 0);
-        }
-        
-        // Draw wireframe
+        // Input latency, how late ticks run and how busy each thread is in
+        // the title, once a second
         
-        if(EnableWireframe) {
-            
-            ID3D11DeviceContext1_IASetPrimitiveTopology(Context, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-            ID3D11DeviceContext1_IASetVertexBuffers(Context, 0, 1, 
-                                                    &Buffer, 
-                                                    &Stride, 
-                                                    &Offset);
-            
-            ID3D11DeviceContext1_RSSetState(Context, RasterizerStateWireframe);
-            
-            for(int Index = 0; Index < EntitiesAmount; ++Index) {
-                entity* Entity = &Entities[Index];
-                D3D11_MAPPED_SUBRESOURCE MappedSubresource;
-                ID3D11DeviceContext1_Map(Context, (ID3D11Resource*)ConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedSubresource);
-                constants *Constants = (constants*)MappedSubresource.pData;
-                Constants->Model = (matrix){
-                    1.0f, 0.0f, 0.0f, 0.0f, 
-                    0.0f, 1.0f, 0.0f, 0.0f, 
-                    0.0f, 0.0f, 1.0f, 0.0f, 
-                    Entity->Position.X, 
-                    Entity->Position.Y, 
-                    Entity->Position.Z, 1.0f
-                };
-                
-                Constants->View = ViewMatrix;
-                Constants->Projection = ProjectionMatrix;
-                Constants->Color = ColorWireframe;
-                ID3D11DeviceContext1_Unmap(Context, (ID3D11Resource*)ConstantBuffer, 0);
-                ID3D11DeviceContext1_Draw(Context, NumVertices, 0);
-            }
+        if(Presented - TitleNanos > 1000000000ull) {
+            double Elapsed = (double)(Presented - StartNanos);
+            char Title[256];
+            snprintf(Title, sizeof(Title), "Snake - input to tick %.0f/%.0f ms, to present %.0f/%.0f ms (p50/p99), %llu dropped - tick late %.2f/%.2f ms (avg/max) - simulation %.1f%%, render %.1f%%",
+                     LatencyPercentile(&Snapshot->Inputs.ToTick, 0.5) / 1e6, LatencyPercentile(&Snapshot->Inputs.ToTick, 0.99) / 1e6,
+                     LatencyPercentile(&PresentMetrics.ToPresent, 0.5) / 1e6, LatencyPercentile(&PresentMetrics.ToPresent, 0.99) / 1e6,
+                     (unsigned long long)Snapshot->Inputs.Dropped,
+                     Snapshot->TickLatenessMean / 1e6, Snapshot->TickLatenessMax / 1e6,
+                     100.0 * Snapshot->SimulationBusyNanos / Elapsed, 100.0 * RenderBusyNanos / Elapsed);
+            SetWindowTextA(Window, Title);
+            TitleNanos = Presented;
         }
-        
-        // Swap
-        
-        IDXGISwapChain1_Present(SwapChain, 1, 0);
-        
     }
     
+    Running = 0;
+    WaitForSingleObject(Simulation, INFINITE);
+    CloseHandle(Simulation);
+    
+    RecordingEnd(&Recording, &Game);
+    RecordingSave(&Recording, "last.rec");
+    DrawListFree(&DrawList);
+    
     return 0;
 }
@@ -0,0 +1,907 @@
+// Multiplayer: an authoritative server runs an arena and every client
+// steers one of its snakes over TCP. Snakes nobody has joined as are
+// driven by ArenaBotDirection.
+//
+// A message is a varint length and then the message, numbers are LEB128
+// varints like in recordings and lists are a count and then the items:
+//
+//   WELCOME  Snake XTiles YTiles SnakeCount Tick, every snake as Alive
+//            and when alive Direction Growing Length and its cells from
+//            the head, then the food cells
+//   TICK     Tick ServerNanos Ack, the snakes that died, one byte per
+//            four other snakes that were alive with their 2 bit
+//            directions, the spawns as (snake, cell, direction) and the
+//            food placed
+//   BYE      Tick, the server is done and Tick was its last
+//   INPUT    Sequence Direction, the only message a client sends
+//
+// Increasing snake indices and cells in a list are sent as the gap from
+// the one before (from 0 for the first).
+//
+// A TICK is a delta: knowing who was alive and where they went, a client
+// moves every snake the way the server did (tails leave unless growing,
+// food under a head is eaten) without being sent a single body cell, so
+// a tick costs about a quarter of a byte per snake. Everything after Ack
+// is the same for every client and is encoded once.
+//
+// The server applies at most one input per connection per tick and Ack
+// is the Sequence of the last one applied. A client predicts its head a
+// tick ahead from the server's state and the oldest input not yet
+// acknowledged, and redoes the prediction when the next TICK arrives.
+//
+// TCP keeps the deltas in order and complete so nothing needs resending,
+// TCP_NODELAY keeps small messages from waiting on each other.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define NET_MAX_MESSAGE (1 << 26)
+#define NET_MAX_QUEUED (1 << 24) // Unsent bytes before a connection is dropped
+#define NET_INPUTS 8 // Inputs waiting per connection
+
+enum {
+    NET_WELCOME = 1,
+    NET_TICK,
+    NET_BYE,
+    NET_INPUT,
+};
+
+// Byte buffers
+
+typedef struct {
+    uint8_t* Data;
+    size_t Size;
+    size_t Capacity;
+} netBuffer;
+
+void NetReserve(netBuffer* Buffer, size_t Size) {
+    if(Buffer->Size + Size <= Buffer->Capacity) return;
+    size_t Capacity = Buffer->Capacity ? Buffer->Capacity : 256;
+    while(Capacity < Buffer->Size + Size) Capacity *= 2;
+    Buffer->Data = realloc(Buffer->Data, Capacity);
+    assert(Buffer->Data);
+    Buffer->Capacity = Capacity;
+}
+
+void NetPushBytes(netBuffer* Buffer, void* Data, size_t Size) {
+    NetReserve(Buffer, Size);
+    memcpy(Buffer->Data + Buffer->Size, Data, Size);
+    Buffer->Size += Size;
+}
+
+void NetPushByte(netBuffer* Buffer, uint8_t Byte) {
+    NetReserve(Buffer, 1);
+    Buffer->Data[Buffer->Size++] = Byte;
+}
+
+void NetPushVarint(netBuffer* Buffer, uint64_t Value) {
+    NetReserve(Buffer, 10);
+    do {
+        uint8_t Byte = Value & 0x7f;
+        Value >>= 7;
+        Buffer->Data[Buffer->Size++] = Byte | (Value ? 0x80 : 0);
+    } while(Value);
+}
+
+// Drops Size bytes from the front
+
+void NetConsume(netBuffer* Buffer, size_t Size) {
+    memmove(Buffer->Data, Buffer->Data + Size, Buffer->Size - Size);
+    Buffer->Size -= Size;
+}
+
+void NetBufferFree(netBuffer* Buffer) {
+    free(Buffer->Data);
+    *Buffer = (netBuffer){0};
+}
+
+// Framing
+
+void NetPushMessage(netBuffer* Out, netBuffer* Head, netBuffer* Body) {
+    NetPushVarint(Out, Head->Size + (Body ? Body->Size : 0));
+    NetPushBytes(Out, Head->Data, Head->Size);
+    if(Body) NetPushBytes(Out, Body->Data, Body->Size);
+}
+
+// The message at Offset in In, 0 if it hasn't all arrived yet and -1 if
+// the length makes no sense. Moves Offset past it.
+
+int NetNextMessage(netBuffer* In, size_t* Offset, reader* Message) {
+    reader Length = {In->Data + *Offset, In->Data + In->Size};
+    uint64_t Size = ReadVarint(&Length);
+    if(Length.Failed) return In->Size - *Offset >= 10 ? -1 : 0;
+    if(Size > NET_MAX_MESSAGE) return -1;
+    if((uint64_t)(Length.End - Length.At) < Size) return 0;
+
+    *Message = (reader){Length.At, Length.At + Size};
+    *Offset = (size_t)(Message->End - In->Data);
+    return 1;
+}
+
+uint8_t ReadByte(reader* Reader) {
+    if(Reader->At >= Reader->End) {
+        Reader->Failed = 1;
+        return 0;
+    }
+    return *Reader->At++;
+}
+
+// Sockets, always non-blocking
+
+void NetConfigure(int Socket) {
+    int One = 1;
+    setsockopt(Socket, IPPROTO_TCP, TCP_NODELAY, &One, sizeof(One));
+    fcntl(Socket, F_SETFL, fcntl(Socket, F_GETFL) | O_NONBLOCK);
+}
+
+// Sends what the socket takes right now, 0 if the connection is gone
+
+int NetFlush(int Socket, netBuffer* Out, uint64_t* Bytes) {
+    size_t Sent = 0;
+    while(Sent < Out->Size) {
+        ssize_t Result = send(Socket, Out->Data + Sent, Out->Size - Sent, MSG_NOSIGNAL);
+        if(Result < 0) {
+            if(errno == EINTR) continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return 0;
+        }
+        Sent += (size_t)Result;
+    }
+    NetConsume(Out, Sent);
+    *Bytes += Sent;
+    return 1;
+}
+
+// Reads what has arrived, 0 if the connection is gone
+
+int NetReceive(int Socket, netBuffer* In, uint64_t* Bytes) {
+    for(;;) {
+        NetReserve(In, 1 << 16);
+        ssize_t Result = recv(Socket, In->Data + In->Size, In->Capacity - In->Size, 0);
+        if(Result == 0) return 0;
+        if(Result < 0) {
+            if(errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        In->Size += (size_t)Result;
+        *Bytes += (uint64_t)Result;
+    }
+}
+
+// Lists of increasing numbers
+
+void NetPushGap(netBuffer* Buffer, uint32_t* Last, uint32_t Value) {
+    NetPushVarint(Buffer, Value - *Last);
+    *Last = Value;
+}
+
+uint32_t ReadGap(reader* Reader, uint32_t* Last) {
+    *Last += (uint32_t)ReadVarint(Reader);
+    return *Last;
+}
+
+int CompareCells(const void* A, const void* B) {
+    uint32_t Left = *(uint32_t*)A;
+    uint32_t Right = *(uint32_t*)B;
+    return (Left > Right) - (Left < Right);
+}
+
+// Server
+
+typedef struct {
+    int Socket; // -1 while the snake is a bot
+    netBuffer In;
+    netBuffer Out;
+    uint64_t Sequences[NET_INPUTS];
+    int8_t Directions[NET_INPUTS];
+    int InputCount;
+    uint64_t Ack;
+} netConnection;
+
+typedef struct {
+    int Listener;
+    int Port;
+    arena Arena;
+    netConnection* Connections; // One per snake
+    int Clients;
+    rng Bots;
+    uint8_t* WasAlive;
+    struct pollfd* Polls;
+    netBuffer Shared;
+    netBuffer Head;
+
+    // Counters
+
+    uint64_t Joins;
+    uint64_t Drops;
+    uint64_t Inputs;
+    uint64_t InputsLost; // Arrived with NET_INPUTS already waiting
+    uint64_t BytesSent;
+    uint64_t BytesReceived;
+    uint64_t SharedBytes;
+    uint64_t Broadcasts;
+} netServer;
+
+void NetDrop(netServer* Server, netConnection* Connection) {
+    close(Connection->Socket);
+    Connection->Socket = -1;
+    Connection->In.Size = 0;
+    Connection->Out.Size = 0;
+    --Server->Clients;
+    ++Server->Drops;
+}
+
+// The whole arena, for a client that just joined
+
+void NetPushWelcome(netServer* Server, int Snake, netBuffer* Out) {
+    arena* Arena = &Server->Arena;
+    netBuffer* Message = &Server->Head;
+    Message->Size = 0;
+
+    NetPushByte(Message, NET_WELCOME);
+    NetPushVarint(Message, Snake);
+    NetPushVarint(Message, Arena->XTiles);
+    NetPushVarint(Message, Arena->YTiles);
+    NetPushVarint(Message, Arena->SnakeCount);
+    NetPushVarint(Message, Arena->Tick);
+
+    for(int Index = 0; Index < Arena->SnakeCount; ++Index) {
+        arenaSnake* Other = &Arena->Snakes[Index];
+        NetPushVarint(Message, Other->Alive);
+        if(!Other->Alive) continue;
+
+        NetPushVarint(Message, Other->Direction);
+        NetPushVarint(Message, Other->Growing);
+        NetPushVarint(Message, Other->BodyLength);
+        for(int Piece = 0; Piece < Other->BodyLength; ++Piece) {
+            NetPushVarint(Message, ArenaGetPieceCell(Other, Piece));
+        }
+    }
+
+    int Words = (Arena->Cells + 63) / 64;
+    uint32_t Last = 0;
+    NetPushVarint(Message, Arena->FoodCount);
+    for(int Word = 0; Word < Words; ++Word) {
+        for(uint64_t Bits = Arena->Food[Word]; Bits; Bits &= Bits - 1) {
+            NetPushGap(Message, &Last, (uint32_t)(Word * 64 + __builtin_ctzll(Bits)));
+        }
+    }
+
+    NetPushMessage(Out, Message, 0);
+}
+
+void NetAccept(netServer* Server) {
+    for(;;) {
+        int Socket = accept(Server->Listener, 0, 0);
+        if(Socket < 0) return;
+
+        int Snake = -1;
+        for(int Index = 0; Index < Server->Arena.SnakeCount; ++Index) {
+            if(Server->Connections[Index].Socket < 0) {
+                Snake = Index;
+                break;
+            }
+        }
+        if(Snake < 0) {
+            close(Socket);
+            continue;
+        }
+
+        NetConfigure(Socket);
+        netConnection* Connection = &Server->Connections[Snake];
+        Connection->Socket = Socket;
+        Connection->InputCount = 0;
+        Connection->Ack = 0;
+        ++Server->Clients;
+        ++Server->Joins;
+
+        NetPushWelcome(Server, Snake, &Connection->Out);
+        if(!NetFlush(Socket, &Connection->Out, &Server->BytesSent)) NetDrop(Server, Connection);
+    }
+}
+
+int NetServerMessage(netServer* Server, netConnection* Connection, reader* Message) {
+    uint64_t Type = ReadVarint(Message);
+    if(Type != NET_INPUT) return 0;
+
+    uint64_t Sequence = ReadVarint(Message);
+    uint64_t Direction = ReadVarint(Message);
+    if(Message->Failed || Direction >= KEYSAMOUNT) return 0;
+
+    ++Server->Inputs;
+    if(Connection->InputCount == NET_INPUTS) {
+        ++Server->InputsLost;
+        return 1;
+    }
+    Connection->Sequences[Connection->InputCount] = Sequence;
+    Connection->Directions[Connection->InputCount] = (int8_t)Direction;
+    ++Connection->InputCount;
+    return 1;
+}
+
+int NetServerInit(netServer* Server, int Port, int XTiles, int YTiles, int Snakes, int Food, uint64_t Seed) {
+    *Server = (netServer){0};
+
+    Server->Listener = socket(AF_INET, SOCK_STREAM, 0);
+    if(Server->Listener < 0) return 0;
+
+    int One = 1;
+    setsockopt(Server->Listener, SOL_SOCKET, SO_REUSEADDR, &One, sizeof(One));
+
+    struct sockaddr_in Address = {
+        .sin_family = AF_INET,
+        .sin_port = htons((uint16_t)Port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    socklen_t AddressSize = sizeof(Address);
+    if(bind(Server->Listener, (struct sockaddr*)&Address, sizeof(Address)) < 0 ||
+       listen(Server->Listener, 1024) < 0 ||
+       getsockname(Server->Listener, (struct sockaddr*)&Address, &AddressSize) < 0) {
+        close(Server->Listener);
+        return 0;
+    }
+    fcntl(Server->Listener, F_SETFL, fcntl(Server->Listener, F_GETFL) | O_NONBLOCK);
+    Server->Port = ntohs(Address.sin_port);
+
+    ArenaInit(&Server->Arena, XTiles, YTiles, Snakes, Food, Seed);
+    ArenaPopulate(&Server->Arena);
+    RngInit(&Server->Bots, Seed, 0);
+
+    Server->Connections = calloc(Snakes, sizeof(netConnection));
+    Server->WasAlive = calloc(Snakes, sizeof(uint8_t));
+    Server->Polls = calloc(Snakes + 1, sizeof(struct pollfd));
+    assert(Server->Connections && Server->WasAlive && Server->Polls);
+
+    for(int Index = 0; Index < Snakes; ++Index) {
+        Server->Connections[Index].Socket = -1;
+    }
+    return 1;
+}
+
+void NetServerFree(netServer* Server) {
+    for(int Index = 0; Index < Server->Arena.SnakeCount; ++Index) {
+        netConnection* Connection = &Server->Connections[Index];
+        if(Connection->Socket >= 0) close(Connection->Socket);
+        NetBufferFree(&Connection->In);
+        NetBufferFree(&Connection->Out);
+    }
+    close(Server->Listener);
+    ArenaFree(&Server->Arena);
+    free(Server->Connections);
+    free(Server->WasAlive);
+    free(Server->Polls);
+    NetBufferFree(&Server->Shared);
+    NetBufferFree(&Server->Head);
+}
+
+// Takes in new clients and inputs and sends what is queued, waiting up
+// to Timeout milliseconds for something to happen
+
+void NetServerPoll(netServer* Server, int Timeout) {
+    int Snakes = Server->Arena.SnakeCount;
+    struct pollfd* Polls = Server->Polls;
+    int PollCount = 0;
+
+    Polls[PollCount++] = (struct pollfd){Server->Listener, POLLIN, 0};
+    for(int Index = 0; Index < Snakes; ++Index) {
+        netConnection* Connection = &Server->Connections[Index];
+        if(Connection->Socket < 0) continue;
+        short Events = POLLIN | (Connection->Out.Size ? POLLOUT : 0);
+        Polls[PollCount++] = (struct pollfd){Connection->Socket, Events, 0};
+    }
+
+    if(poll(Polls, PollCount, Timeout) <= 0) return;
+
+    // Sockets go in snake order, so the connections line up with the polls
+
+    int Poll = 1;
+    for(int Index = 0; Index < Snakes && Poll < PollCount; ++Index) {
+        netConnection* Connection = &Server->Connections[Index];
+        if(Connection->Socket != Polls[Poll].fd) continue;
+        short Events = Polls[Poll++].revents;
+        if(!Events) continue;
+
+        int Alive = 1;
+        if(Events & (POLLIN | POLLHUP | POLLERR)) {
+            Alive = NetReceive(Connection->Socket, &Connection->In, &Server->BytesReceived);
+
+            size_t Offset = 0;
+            reader Message;
+            int Found;
+            while(Alive && (Found = NetNextMessage(&Connection->In, &Offset, &Message)) != 0) {
+                Alive = Found > 0 && NetServerMessage(Server, Connection, &Message);
+            }
+            if(Alive) NetConsume(&Connection->In, Offset);
+        }
+        if(Alive && (Events & POLLOUT)) {
+            Alive = NetFlush(Connection->Socket, &Connection->Out, &Server->BytesSent);
+        }
+        if(!Alive) NetDrop(Server, Connection);
+    }
+
+    if(Polls[0].revents & POLLIN) NetAccept(Server);
+}
+
+// What changed in the tick that just ran
+
+void NetEncodeTick(netServer* Server) {
+    arena* Arena = &Server->Arena;
+    netBuffer* Shared = &Server->Shared;
+    int Snakes = Arena->SnakeCount;
+    Shared->Size = 0;
+
+    int Deaths = 0;
+    int Spawns = 0;
+    for(int Index = 0; Index < Snakes; ++Index) {
+        arenaSnake* Snake = &Arena->Snakes[Index];
+        int Died = Server->WasAlive[Index] && Snake->Dies;
+        Deaths += Died;
+        Spawns += Snake->Alive && (!Server->WasAlive[Index] || Died);
+    }
+
+    uint32_t Last = 0;
+    NetPushVarint(Shared, Deaths);
+    for(int Index = 0; Index < Snakes; ++Index) {
+        if(Server->WasAlive[Index] && Arena->Snakes[Index].Dies) NetPushGap(Shared, &Last, Index);
+    }
+
+    uint8_t Byte = 0;
+    int Packed = 0;
+    for(int Index = 0; Index < Snakes; ++Index) {
+        arenaSnake* Snake = &Arena->Snakes[Index];
+        if(!Server->WasAlive[Index] || Snake->Dies) continue;
+        Byte |= (uint8_t)(Snake->Direction << (2 * (Packed & 3)));
+        if((++Packed & 3) == 0) {
+            NetPushByte(Shared, Byte);
+            Byte = 0;
+        }
+    }
+    if(Packed & 3) NetPushByte(Shared, Byte);
+
+    Last = 0;
+    NetPushVarint(Shared, Spawns);
+    for(int Index = 0; Index < Snakes; ++Index) {
+        arenaSnake* Snake = &Arena->Snakes[Index];
+        if(!Snake->Alive || (Server->WasAlive[Index] && !Snake->Dies)) continue;
+        NetPushGap(Shared, &Last, Index);
+        NetPushVarint(Shared, ArenaGetPieceCell(Snake, 0));
+        NetPushVarint(Shared, Snake->Direction);
+    }
+
+    qsort(Arena->Placed, Arena->PlacedCount, sizeof(uint32_t), CompareCells);
+    Last = 0;
+    NetPushVarint(Shared, Arena->PlacedCount);
+    for(int Index = 0; Index < Arena->PlacedCount; ++Index) {
+        NetPushGap(Shared, &Last, Arena->Placed[Index]);
+    }
+}
+
+// Runs a tick, NetServerBroadcast sends it
+
+void NetServerTick(netServer* Server) {
+    arena* Arena = &Server->Arena;
+    int Snakes = Arena->SnakeCount;
+
+    for(int Index = 0; Index < Snakes; ++Index) {
+        netConnection* Connection = &Server->Connections[Index];
+        Server->WasAlive[Index] = (uint8_t)Arena->Snakes[Index].Alive;
+
+        if(Connection->Socket < 0) {
+            Arena->Inputs[Index] = (int8_t)ArenaBotDirection(Arena, Index, &Server->Bots);
+        } else if(Connection->InputCount) {
+            Arena->Inputs[Index] = Connection->Directions[0];
+            Connection->Ack = Connection->Sequences[0];
+            --Connection->InputCount;
+            memmove(Connection->Sequences, Connection->Sequences + 1, Connection->InputCount * sizeof(uint64_t));
+            memmove(Connection->Directions, Connection->Directions + 1, Connection->InputCount);
+        } else {
+            Arena->Inputs[Index] = -1;
+        }
+    }
+
+    ArenaUpdate(Arena);
+    NetEncodeTick(Server);
+}
+
+// Now is the time the messages say they left the server
+
+void NetServerBroadcast(netServer* Server, uint64_t Now) {
+    arena* Arena = &Server->Arena;
+    int Snakes = Arena->SnakeCount;
+    Server->SharedBytes += Server->Shared.Size;
+    ++Server->Broadcasts;
+
+    for(int Index = 0; Index < Snakes; ++Index) {
+        netConnection* Connection = &Server->Connections[Index];
+        if(Connection->Socket < 0) continue;
+
+        netBuffer* Head = &Server->Head;
+        Head->Size = 0;
+        NetPushByte(Head, NET_TICK);
+        NetPushVarint(Head, Arena->Tick);
+        NetPushVarint(Head, Now);
+        NetPushVarint(Head, Connection->Ack);
+        NetPushMessage(&Connection->Out, Head, &Server->Shared);
+
+        if(!NetFlush(Connection->Socket, &Connection->Out, &Server->BytesSent) ||
+           Connection->Out.Size > NET_MAX_QUEUED) {
+            NetDrop(Server, Connection);
+        }
+    }
+}
+
+// Tells everyone the game is over and waits up to Timeout milliseconds
+// for it all to be sent
+
+void NetServerBye(netServer* Server, int Timeout) {
+    netBuffer* Head = &Server->Head;
+    Head->Size = 0;
+    NetPushByte(Head, NET_BYE);
+    NetPushVarint(Head, Server->Arena.Tick);
+
+    for(int Index = 0; Index < Server->Arena.SnakeCount; ++Index) {
+        netConnection* Connection = &Server->Connections[Index];
+        if(Connection->Socket >= 0) NetPushMessage(&Connection->Out, Head, 0);
+    }
+
+    for(int Waited = 0; Waited < Timeout; ++Waited) {
+        int Queued = 0;
+        for(int Index = 0; Index < Server->Arena.SnakeCount; ++Index) {
+            netConnection* Connection = &Server->Connections[Index];
+            if(Connection->Socket < 0 || !Connection->Out.Size) continue;
+            if(!NetFlush(Connection->Socket, &Connection->Out, &Server->BytesSent)) {
+                NetDrop(Server, Connection);
+                continue;
+            }
+            Queued += Connection->Out.Size != 0;
+        }
+        if(!Queued) return;
+        poll(0, 0, 1);
+    }
+}
+
+// Client
+
+typedef struct {
+    int Socket;
+    netBuffer In;
+    netBuffer Out;
+    int Joined;
+    int Done; // Got BYE
+    int Snake;
+    arena Mirror;
+
+    // Inputs the server hasn't acknowledged, oldest first
+
+    uint64_t NextSequence;
+    uint64_t Sequences[NET_INPUTS];
+    int8_t Directions[NET_INPUTS];
+    uint64_t SentNanos[NET_INPUTS];
+    int InputCount;
+
+    uint32_t Predicted; // Head after PredictedTick
+    uint64_t PredictedTick;
+
+    // Counters
+
+    uint64_t BytesSent;
+    uint64_t BytesReceived;
+    uint64_t Ticks;
+    uint64_t TickNanos; // Server sending a tick to it arriving
+    uint64_t TickNanosMax;
+    uint64_t Acked;
+    uint64_t InputNanos; // Sending an input to the tick that applied it
+    uint64_t InputNanosMax;
+    uint64_t Predictions;
+    uint64_t Mispredictions;
+} netClient;
+
+int NetClientConnect(netClient* Client, char* Host, int Port) {
+    *Client = (netClient){.Socket = -1, .NextSequence = 1};
+
+    char Service[16];
+    snprintf(Service, sizeof(Service), "%d", Port);
+    struct addrinfo Hints = {.ai_family = AF_INET, .ai_socktype = SOCK_STREAM};
+    struct addrinfo* Addresses;
+    if(getaddrinfo(Host, Service, &Hints, &Addresses) != 0) return 0;
+
+    Client->Socket = socket(AF_INET, SOCK_STREAM, 0);
+    int Connected = Client->Socket >= 0 &&
+                    connect(Client->Socket, Addresses->ai_addr, Addresses->ai_addrlen) == 0;
+    freeaddrinfo(Addresses);
+
+    if(!Connected) {
+        if(Client->Socket >= 0) close(Client->Socket);
+        Client->Socket = -1;
+        return 0;
+    }
+    NetConfigure(Client->Socket);
+    return 1;
+}
+
+void NetClientFree(netClient* Client) {
+    if(Client->Socket >= 0) close(Client->Socket);
+    if(Client->Joined) ArenaFree(&Client->Mirror);
+    NetBufferFree(&Client->In);
+    NetBufferFree(&Client->Out);
+    Client->Socket = -1;
+}
+
+int NetReadWelcome(netClient* Client, reader* Message) {
+    uint64_t Snake = ReadVarint(Message);
+    uint64_t XTiles = ReadVarint(Message);
+    uint64_t YTiles = ReadVarint(Message);
+    uint64_t Snakes = ReadVarint(Message);
+    uint64_t Tick = ReadVarint(Message);
+
+    if(Message->Failed || Client->Joined || XTiles < 1 || XTiles > MAX_TILES ||
+       YTiles < 1 || YTiles > MAX_TILES || Snake >= Snakes || Snakes > (uint64_t)(Message->End - Message->At)) {
+        return 0;
+    }
+
+    arena* Mirror = &Client->Mirror;
+    ArenaInit(Mirror, (int)XTiles, (int)YTiles, (int)Snakes, 0, 0);
+    Mirror->Tick = Tick;
+    Client->Joined = 1;
+    Client->Snake = (int)Snake;
+
+    for(int Index = 0; Index < Mirror->SnakeCount; ++Index) {
+        arenaSnake* Other = &Mirror->Snakes[Index];
+        if(!ReadVarint(Message)) continue;
+
+        uint64_t Direction = ReadVarint(Message);
+        uint64_t Growing = ReadVarint(Message);
+        uint64_t Length = ReadVarint(Message);
+        if(Message->Failed || Direction >= KEYSAMOUNT || Growing > (uint64_t)Mirror->Cells ||
+           Length < 1 || Length > (uint64_t)Mirror->Cells) {
+            return 0;
+        }
+
+        Other->Alive = 1;
+        Other->Direction = (int)Direction;
+        Other->Growing = (int)Growing;
+
+        // Cells come head first, the body is built from the tail
+
+        uint8_t* Cells = Message->At;
+        for(uint64_t Piece = 0; Piece < Length; ++Piece) ReadVarint(Message);
+        if(Message->Failed) return 0;
+        uint8_t* End = Message->At;
+
+        uint32_t* Body = malloc(Length * sizeof(uint32_t));
+        assert(Body);
+        Message->At = Cells;
+        for(uint64_t Piece = 0; Piece < Length; ++Piece) Body[Piece] = (uint32_t)ReadVarint(Message);
+        Message->At = End;
+
+        for(uint64_t Piece = Length; Piece-- > 0;) {
+            if(Body[Piece] >= (uint32_t)Mirror->Cells || ArenaTest(Mirror->Occupied, Body[Piece])) {
+                free(Body);
+                return 0;
+            }
+            ArenaPushHead(Other, Body[Piece]);
+            ArenaSet(Mirror->Occupied, Body[Piece]);
+        }
+        free(Body);
+    }
+
+    uint32_t Last = 0;
+    uint64_t FoodCount = ReadVarint(Message);
+    for(uint64_t Index = 0; Index < FoodCount && !Message->Failed; ++Index) {
+        uint32_t Cell = ReadGap(Message, &Last);
+        if(Cell >= (uint32_t)Mirror->Cells) return 0;
+        ArenaSet(Mirror->Food, Cell);
+        ++Mirror->FoodCount;
+    }
+    return !Message->Failed;
+}
+
+// Moves the mirror the way the server moved the arena
+
+int NetApplyTick(arena* Mirror, reader* Message) {
+    int Snakes = Mirror->SnakeCount;
+    arenaSnake* AllSnakes = Mirror->Snakes;
+
+    uint32_t Last = 0;
+    uint64_t Deaths = ReadVarint(Message);
+    if(Deaths > (uint64_t)Snakes) return 0;
+    for(uint64_t Death = 0; Death < Deaths; ++Death) {
+        uint32_t Index = ReadGap(Message, &Last);
+        if(Message->Failed || Index >= (uint32_t)Snakes || !AllSnakes[Index].Alive) return 0;
+        AllSnakes[Index].Dies = 1;
+    }
+
+    // Tails and the dead leave first so no new head lands on a cell that
+    // is cleared after it
+
+    int Packed = 0;
+    uint8_t Byte = 0;
+    for(int Index = 0; Index < Snakes; ++Index) {
+        arenaSnake* Snake = &AllSnakes[Index];
+        if(!Snake->Alive) continue;
+
+        if(Snake->Dies) {
+            Snake->Dies = 0;
+            ArenaKill(Mirror, Snake);
+            continue;
+        }
+
+        if((Packed & 3) == 0) Byte = ReadByte(Message);
+        Snake->Direction = (Byte >> (2 * (Packed & 3))) & 3;
+        ++Packed;
+        Snake->NewHead = ArenaGetPieceCell(Snake, 0) + Mirror->Steps[Snake->Direction];
+
+        if(Snake->Growing) {
+            --Snake->Growing;
+        } else {
+            ArenaClear(Mirror->Occupied, ArenaGetPieceCell(Snake, Snake->BodyLength - 1));
+            --Snake->BodyLength;
+        }
+    }
+    if(Message->Failed) return 0;
+
+    for(int Index = 0; Index < Snakes; ++Index) {
+        arenaSnake* Snake = &AllSnakes[Index];
+        if(!Snake->Alive) continue;
+
+        ArenaPushHead(Snake, Snake->NewHead);
+        ArenaSet(Mirror->Occupied, Snake->NewHead);
+        if(ArenaTest(Mirror->Food, Snake->NewHead)) {
+            ArenaClear(Mirror->Food, Snake->NewHead);
+            --Mirror->FoodCount;
+            ++Snake->Growing;
+        }
+    }
+
+    Last = 0;
+    uint64_t Spawns = ReadVarint(Message);
+    if(Spawns > (uint64_t)Snakes) return 0;
+    for(uint64_t Spawn = 0; Spawn < Spawns; ++Spawn) {
+        uint32_t Index = ReadGap(Message, &Last);
+        uint64_t Cell = ReadVarint(Message);
+        uint64_t Direction = ReadVarint(Message);
+        if(Message->Failed || Index >= (uint32_t)Snakes || AllSnakes[Index].Alive ||
+           Cell >= (uint64_t)Mirror->Cells || Direction >= KEYSAMOUNT) {
+            return 0;
+        }
+
+        arenaSnake* Snake = &AllSnakes[Index];
+        Snake->BodyLength = 0;
+        Snake->Growing = 0;
+        Snake->Direction = (int)Direction;
+        Snake->Alive = 1;
+        ArenaPushHead(Snake, (uint32_t)Cell);
+        ArenaSet(Mirror->Occupied, (uint32_t)Cell);
+    }
+
+    Last = 0;
+    uint64_t Placed = ReadVarint(Message);
+    for(uint64_t Index = 0; Index < Placed && !Message->Failed; ++Index) {
+        uint32_t Cell = ReadGap(Message, &Last);
+        if(Cell >= (uint32_t)Mirror->Cells) return 0;
+        ArenaSet(Mirror->Food, Cell);
+        ++Mirror->FoodCount;
+    }
+
+    ++Mirror->Tick;
+    return !Message->Failed;
+}
+
+int NetClientTick(netClient* Client, reader* Message, uint64_t Now) {
+    uint64_t Tick = ReadVarint(Message);
+    uint64_t SentNanos = ReadVarint(Message);
+    uint64_t Ack = ReadVarint(Message);
+    arena* Mirror = &Client->Mirror;
+
+    if(Message->Failed || !Client->Joined || Tick != Mirror->Tick + 1) return 0;
+    if(!NetApplyTick(Mirror, Message)) return 0;
+
+    uint64_t Latency = Now > SentNanos ? Now - SentNanos : 0;
+    ++Client->Ticks;
+    Client->TickNanos += Latency;
+    if(Latency > Client->TickNanosMax) Client->TickNanosMax = Latency;
+
+    // Check the prediction, a snake that died and came back doesn't count
+
+    arenaSnake* Snake = &Mirror->Snakes[Client->Snake];
+    if(Client->PredictedTick == Tick && Snake->Alive && Snake->BodyLength > 1) {
+        ++Client->Predictions;
+        Client->Mispredictions += ArenaGetPieceCell(Snake, 0) != Client->Predicted;
+    }
+    Client->PredictedTick = 0;
+
+    // Reconcile, inputs up to Ack are part of the server's state now
+
+    int Acked = 0;
+    while(Acked < Client->InputCount && Client->Sequences[Acked] <= Ack) {
+        uint64_t InputLatency = Now - Client->SentNanos[Acked];
+        Client->InputNanos += InputLatency;
+        if(InputLatency > Client->InputNanosMax) Client->InputNanosMax = InputLatency;
+        ++Acked;
+    }
+    if(Acked) {
+        Client->Acked += Acked;
+        Client->InputCount -= Acked;
+        memmove(Client->Sequences, Client->Sequences + Acked, Client->InputCount * sizeof(uint64_t));
+        memmove(Client->Directions, Client->Directions + Acked, Client->InputCount);
+        memmove(Client->SentNanos, Client->SentNanos + Acked, Client->InputCount * sizeof(uint64_t));
+    }
+    return 1;
+}
+
+// Handles everything that has arrived, 0 if the connection is gone or
+// the server sent something that doesn't fit
+
+int NetClientReceive(netClient* Client, uint64_t Now) {
+    int Alive = NetReceive(Client->Socket, &Client->In, &Client->BytesReceived);
+
+    size_t Offset = 0;
+    reader Message;
+    int Found;
+    while(!Client->Done && (Found = NetNextMessage(&Client->In, &Offset, &Message)) != 0) {
+        if(Found < 0) return 0;
+
+        uint64_t Type = ReadVarint(&Message);
+        if(Type == NET_WELCOME) {
+            if(!NetReadWelcome(Client, &Message)) return 0;
+        } else if(Type == NET_TICK) {
+            if(!NetClientTick(Client, &Message, Now)) return 0;
+        } else if(Type == NET_BYE) {
+            if(ReadVarint(&Message) != Client->Mirror.Tick) return 0;
+            Client->Done = 1;
+        } else {
+            return 0;
+        }
+    }
+    NetConsume(&Client->In, Offset);
+    return Alive || Client->Done;
+}
+
+int NetClientSendInput(netClient* Client, int Direction, uint64_t Now) {
+    if(Client->InputCount == NET_INPUTS) return 1;
+
+    netBuffer Message = {0};
+    uint8_t Storage[32];
+    Message.Data = Storage;
+    Message.Capacity = sizeof(Storage);
+
+    uint64_t Sequence = Client->NextSequence++;
+    NetPushByte(&Message, NET_INPUT);
+    NetPushVarint(&Message, Sequence);
+    NetPushVarint(&Message, Direction);
+    NetPushMessage(&Client->Out, &Message, 0);
+
+    Client->Sequences[Client->InputCount] = Sequence;
+    Client->Directions[Client->InputCount] = (int8_t)Direction;
+    Client->SentNanos[Client->InputCount] = Now;
+    ++Client->InputCount;
+
+    return NetFlush(Client->Socket, &Client->Out, &Client->BytesSent);
+}
+
+// Where the head goes on the next tick: the server's state plus the
+// oldest input it hasn't applied yet
+
+void NetClientPredict(netClient* Client) {
+    arena* Mirror = &Client->Mirror;
+    arenaSnake* Snake = &Mirror->Snakes[Client->Snake];
+    Client->PredictedTick = 0;
+    if(!Snake->Alive) return;
+
+    int Direction = Snake->Direction;
+    if(Client->InputCount) {
+        int Input = Client->Directions[0];
+        if(Snake->BodyLength + Snake->Growing == 1 || !IsOppositeDirection(Direction, Input)) Direction = Input;
+    }
+
+    Client->Predicted = ArenaGetPieceCell(Snake, 0) + Mirror->Steps[Direction];
+    Client->PredictedTick = Mirror->Tick + 1;
+}
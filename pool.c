@@ -0,0 +1,162 @@
+// Thread pool for running a loop body over [0, Count) on all cores.
+// The range is cut into chunks and dealt out evenly; each worker takes
+// chunks from the front of its own share and, once that is empty, takes
+// them from the other workers' shares so nobody sits idle while a slow
+// share is still running. POSIX threads, used by the Linux tools.
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define MAX_WORKERS 256
+
+typedef void poolTask(void* Context, int Begin, int End, int Worker);
+
+// Each share sits on its own cache line, they are hammered from all
+// workers when stealing
+
+typedef struct {
+    _Alignas(64) atomic_int Next;
+    int End;
+} poolShare;
+
+typedef struct pool pool;
+
+typedef struct {
+    pool* Pool;
+    int Index;
+} poolWorker;
+
+struct pool {
+    int WorkerCount;
+    pthread_t Threads[MAX_WORKERS];
+    poolWorker Workers[MAX_WORKERS];
+    poolShare Shares[MAX_WORKERS];
+
+    // Current job
+
+    poolTask* Task;
+    void* Context;
+    int Count;
+    int ChunkSize;
+
+    pthread_mutex_t Mutex;
+    pthread_cond_t Start;
+    pthread_cond_t Done;
+    int Generation;
+    int Busy;
+    int Quit;
+};
+
+void PoolWork(pool* Pool, int Worker) {
+    for(int Offset = 0; Offset < Pool->WorkerCount; ++Offset) {
+        poolShare* Share = &Pool->Shares[(Worker + Offset) % Pool->WorkerCount];
+        for(;;) {
+            int Chunk = atomic_fetch_add_explicit(&Share->Next, 1, memory_order_relaxed);
+            if(Chunk >= Share->End) break;
+
+            int Begin = Chunk * Pool->ChunkSize;
+            int End = Begin + Pool->ChunkSize;
+            if(End > Pool->Count) End = Pool->Count;
+            Pool->Task(Pool->Context, Begin, End, Worker);
+        }
+    }
+}
+
+void* PoolThread(void* Parameter) {
+    poolWorker* Worker = Parameter;
+    pool* Pool = Worker->Pool;
+    int Generation = 0;
+
+    for(;;) {
+        pthread_mutex_lock(&Pool->Mutex);
+        while(Pool->Generation == Generation && !Pool->Quit) {
+            pthread_cond_wait(&Pool->Start, &Pool->Mutex);
+        }
+        Generation = Pool->Generation;
+        int Quit = Pool->Quit;
+        pthread_mutex_unlock(&Pool->Mutex);
+
+        if(Quit) break;
+
+        PoolWork(Pool, Worker->Index);
+
+        pthread_mutex_lock(&Pool->Mutex);
+        if(--Pool->Busy == 0) pthread_cond_signal(&Pool->Done);
+        pthread_mutex_unlock(&Pool->Mutex);
+    }
+
+    return 0;
+}
+
+// WorkerCount includes the calling thread
+
+void PoolInit(pool* Pool, int WorkerCount) {
+    if(WorkerCount < 1) WorkerCount = 1;
+    if(WorkerCount > MAX_WORKERS) WorkerCount = MAX_WORKERS;
+
+    Pool->WorkerCount = WorkerCount;
+    Pool->Generation = 0;
+    Pool->Busy = 0;
+    Pool->Quit = 0;
+    pthread_mutex_init(&Pool->Mutex, 0);
+    pthread_cond_init(&Pool->Start, 0);
+    pthread_cond_init(&Pool->Done, 0);
+
+    for(int Index = 1; Index < WorkerCount; ++Index) {
+        Pool->Workers[Index] = (poolWorker){Pool, Index};
+        pthread_create(&Pool->Threads[Index], 0, PoolThread, &Pool->Workers[Index]);
+    }
+}
+
+void PoolFree(pool* Pool) {
+    pthread_mutex_lock(&Pool->Mutex);
+    Pool->Quit = 1;
+    pthread_cond_broadcast(&Pool->Start);
+    pthread_mutex_unlock(&Pool->Mutex);
+
+    for(int Index = 1; Index < Pool->WorkerCount; ++Index) {
+        pthread_join(Pool->Threads[Index], 0);
+    }
+
+    pthread_mutex_destroy(&Pool->Mutex);
+    pthread_cond_destroy(&Pool->Start);
+    pthread_cond_destroy(&Pool->Done);
+}
+
+// Calls Task on chunks of ChunkSize covering [0, Count) and returns when
+// all of them are done
+
+void PoolRun(pool* Pool, poolTask* Task, void* Context, int Count, int ChunkSize) {
+    if(Count <= 0) return;
+    if(ChunkSize < 1) ChunkSize = 1;
+
+    Pool->Task = Task;
+    Pool->Context = Context;
+    Pool->Count = Count;
+    Pool->ChunkSize = ChunkSize;
+
+    int Chunks = (Count + ChunkSize - 1) / ChunkSize;
+    for(int Index = 0; Index < Pool->WorkerCount; ++Index) {
+        int Begin = (int)((long long)Chunks * Index / Pool->WorkerCount);
+        int End = (int)((long long)Chunks * (Index + 1) / Pool->WorkerCount);
+        atomic_store_explicit(&Pool->Shares[Index].Next, Begin, memory_order_relaxed);
+        Pool->Shares[Index].End = End;
+    }
+
+    if(Pool->WorkerCount == 1) {
+        PoolWork(Pool, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&Pool->Mutex);
+    Pool->Busy = Pool->WorkerCount - 1;
+    ++Pool->Generation;
+    pthread_cond_broadcast(&Pool->Start);
+    pthread_mutex_unlock(&Pool->Mutex);
+
+    PoolWork(Pool, 0);
+
+    pthread_mutex_lock(&Pool->Mutex);
+    while(Pool->Busy > 0) pthread_cond_wait(&Pool->Done, &Pool->Mutex);
+    pthread_mutex_unlock(&Pool->Mutex);
+}
@@ -0,0 +1,586 @@
+// Software rasterizer: a draw list backend that does what shaders.hlsl
+// and the D3D11 state in main.c do, on the CPU. Every vertex of the
+// square (or its outline) goes through the instance offset and the
+// view-projection, then the perspective divide and the viewport. Filled
+// passes are triangle lists with back faces culled (clockwise is front),
+// the border pass is a line list and the wireframe passes draw the edges
+// of the triangles. The pixel gets the instance's palette color, there
+// is no depth buffer, later draws cover earlier ones.
+//
+// Triangles follow the D3D rules: vertices snapped to 1/16 pixel, pixel
+// centers sampled, top-left fill convention, so two triangles sharing an
+// edge never both draw a pixel and never both miss one. Coverage is
+// worked out per 8x8 block: blocks outside an edge are skipped, edges
+// that cover a whole block drop out and what is left runs in a kernel,
+// scalar or AVX2 picked at run time like the lockstep kernels. Lines are
+// Bresenham from pixel to pixel without the last one.
+//
+// D3D clips to 0 <= z <= w, the near and far planes. Here a triangle or
+// line with a vertex outside them is dropped whole rather than cut. Every
+// instance lies in the z = 0 plane and the camera looks straight down on
+// it, so all vertices are at one depth and a primitive is either all in
+// or all out: dropping it is what clipping would do. Off the sides there
+// is only a guard band, a primitive with a vertex more than RASTER_GUARD
+// pixels off screen is dropped too; DrawViewProjection keeps the board
+// on screen so that never happens.
+//
+// Work is split into bands of rows that threads draw in parallel, each
+// band goes through the primitives in order so overlaps come out the
+// same as drawing them one by one. The floor passes are drawn once into
+// their own image whenever the floor, the view-projection or the floor
+// wireframe changes, a frame starts as a copy of it and only draws what
+// moves.
+//
+// Pixels are R8G8B8A8, like the swap chain.
+
+#include <immintrin.h>
+#include <math.h>
+#include <string.h>
+
+#define RASTER_SUBPIXEL_BITS 4
+#define RASTER_SUBPIXEL (1 << RASTER_SUBPIXEL_BITS)
+#define RASTER_GUARD 16384
+#define RASTER_BLOCK 8
+#define RASTER_BAND 64 // Rows, a multiple of RASTER_BLOCK
+
+#define RASTER_TARGET(Target) __attribute__((target(Target)))
+
+enum {
+    RASTER_SCALAR,
+    RASTER_AVX2,
+    RASTER_KERNELS,
+};
+
+char* RasterKernelNames[RASTER_KERNELS] = {"scalar", "avx2"};
+
+// What a pass turns its instances into
+
+enum {
+    RASTER_TRIANGLES, // 2 per instance
+    RASTER_OUTLINES, // 4 lines per instance
+    RASTER_EDGES, // 6 lines per instance, the edges of the triangles
+};
+
+typedef struct {
+    int32_t X[3]; // Subpixels
+    int32_t Y[3];
+    int16_t MinX, MinY, MaxX, MaxY; // Pixels on screen, empty if MaxY < MinY
+    uint32_t Color;
+} rasterTriangle;
+
+typedef struct {
+    int32_t X0, Y0, X1, Y1; // Pixels
+    int16_t MinY, MaxY; // Empty if MaxY < MinY
+    uint32_t Color;
+} rasterLine;
+
+typedef struct {
+    int Kind;
+    int Count; // Instances
+    int Capacity;
+    rasterTriangle* Triangles;
+    rasterLine* Lines;
+} rasterPass;
+
+typedef void rasterBlock(uint32_t* Pixels, int Pitch, int Rows, int Columns,
+                         int32_t* E, int32_t* Dx, int32_t* Dy, uint32_t Color);
+
+typedef struct {
+    int Width;
+    int Height;
+    uint32_t* Pixels;
+    uint32_t* FloorPixels;
+    uint32_t ClearColor;
+    uint32_t Palette[PALETTE_AMOUNT];
+
+    int Kernel;
+    rasterBlock* Block;
+    pool* Pool; // 0 draws on the calling thread
+
+    rasterPass Passes[DRAW_PASSES];
+
+    // Per frame
+
+    matrix ViewProjection;
+    float SquareClip[6][4]; // Mesh vertices through the view-projection
+    float OutlineClip[8][4];
+
+    // What the floor image was drawn from
+
+    uint64_t FloorVersion;
+    matrix FloorViewProjection;
+    int FloorWireframe;
+
+    // Current job
+
+    int SetupPass;
+    drawInstance* SetupInstances;
+    int DrawingFloor;
+
+    uint64_t Frames;
+    uint64_t FloorDraws;
+} raster;
+
+uint32_t RasterColor(color Color) {
+    uint32_t R = (uint32_t)(Saturate(Color.R) * 255.0f + 0.5f);
+    uint32_t G = (uint32_t)(Saturate(Color.G) * 255.0f + 0.5f);
+    uint32_t B = (uint32_t)(Saturate(Color.B) * 255.0f + 0.5f);
+    uint32_t A = (uint32_t)(Saturate(Color.A) * 255.0f + 0.5f);
+    return R | G << 8 | B << 16 | A << 24;
+}
+
+// Kernels: Rows x Columns pixels of one block, E is each edge's value at
+// the first pixel (already biased, covered means >= 0), Dx and Dy what
+// it changes by per pixel and per row
+
+void RasterBlockScalar(uint32_t* Pixels, int Pitch, int Rows, int Columns,
+                       int32_t* E, int32_t* Dx, int32_t* Dy, uint32_t Color) {
+    int32_t E0 = E[0], E1 = E[1], E2 = E[2];
+    for(int Row = 0; Row < Rows; ++Row) {
+        int32_t X0 = E0, X1 = E1, X2 = E2;
+        for(int Column = 0; Column < Columns; ++Column) {
+            if((X0 | X1 | X2) >= 0) Pixels[Column] = Color;
+            X0 += Dx[0];
+            X1 += Dx[1];
+            X2 += Dx[2];
+        }
+        E0 += Dy[0];
+        E1 += Dy[1];
+        E2 += Dy[2];
+        Pixels += Pitch;
+    }
+}
+
+RASTER_TARGET("avx2")
+void RasterBlockAvx2(uint32_t* Pixels, int Pitch, int Rows, int Columns,
+                     int32_t* E, int32_t* Dx, int32_t* Dy, uint32_t Color) {
+    __m256i Lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i ColumnMask = _mm256_cmpgt_epi32(_mm256_set1_epi32(Columns), Lane);
+    __m256i Fill = _mm256_set1_epi32((int)Color);
+
+    __m256i E0 = _mm256_add_epi32(_mm256_set1_epi32(E[0]), _mm256_mullo_epi32(Lane, _mm256_set1_epi32(Dx[0])));
+    __m256i E1 = _mm256_add_epi32(_mm256_set1_epi32(E[1]), _mm256_mullo_epi32(Lane, _mm256_set1_epi32(Dx[1])));
+    __m256i E2 = _mm256_add_epi32(_mm256_set1_epi32(E[2]), _mm256_mullo_epi32(Lane, _mm256_set1_epi32(Dx[2])));
+    __m256i Dy0 = _mm256_set1_epi32(Dy[0]);
+    __m256i Dy1 = _mm256_set1_epi32(Dy[1]);
+    __m256i Dy2 = _mm256_set1_epi32(Dy[2]);
+
+    for(int Row = 0; Row < Rows; ++Row) {
+        __m256i Outside = _mm256_srai_epi32(_mm256_or_si256(_mm256_or_si256(E0, E1), E2), 31);
+        __m256i Mask = _mm256_andnot_si256(Outside, ColumnMask);
+        _mm256_maskstore_epi32((int*)Pixels, Mask, Fill);
+        E0 = _mm256_add_epi32(E0, Dy0);
+        E1 = _mm256_add_epi32(E1, Dy1);
+        E2 = _mm256_add_epi32(E2, Dy2);
+        Pixels += Pitch;
+    }
+}
+
+int RasterKernelSupported(int Kernel) {
+    if(Kernel == RASTER_AVX2) return __builtin_cpu_supports("avx2");
+    return 1;
+}
+
+int RasterBestKernel() {
+    for(int Kernel = RASTER_KERNELS - 1; Kernel > RASTER_SCALAR; --Kernel) {
+        if(RasterKernelSupported(Kernel)) return Kernel;
+    }
+    return RASTER_SCALAR;
+}
+
+void RasterInit(raster* Raster, int Width, int Height, int Kernel, pool* Pool) {
+    assert(Width > 0 && Width <= RASTER_GUARD && Height > 0 && Height <= RASTER_GUARD);
+    assert(RasterKernelSupported(Kernel));
+
+    *Raster = (raster){
+        .Width = Width,
+        .Height = Height,
+        .ClearColor = RasterColor((color){0.3f, 0.3f, 0.3f, 1.0f}),
+        .Kernel = Kernel,
+        .Block = Kernel == RASTER_AVX2 ? RasterBlockAvx2 : RasterBlockScalar,
+        .Pool = Pool,
+    };
+    Raster->Pixels = malloc((size_t)Width * Height * sizeof(uint32_t));
+    Raster->FloorPixels = malloc((size_t)Width * Height * sizeof(uint32_t));
+    assert(Raster->Pixels && Raster->FloorPixels);
+
+    for(int Index = 0; Index < PALETTE_AMOUNT; ++Index) {
+        Raster->Palette[Index] = RasterColor(Palette[Index]);
+    }
+
+    Raster->Passes[DRAW_FLOOR].Kind = RASTER_TRIANGLES;
+    Raster->Passes[DRAW_FILL].Kind = RASTER_TRIANGLES;
+    Raster->Passes[DRAW_BORDER].Kind = RASTER_OUTLINES;
+    Raster->Passes[DRAW_FLOOR_WIREFRAME].Kind = RASTER_EDGES;
+    Raster->Passes[DRAW_WIREFRAME].Kind = RASTER_EDGES;
+}
+
+void RasterFree(raster* Raster) {
+    for(int Pass = 0; Pass < DRAW_PASSES; ++Pass) {
+        free(Raster->Passes[Pass].Triangles);
+        free(Raster->Passes[Pass].Lines);
+    }
+    free(Raster->Pixels);
+    free(Raster->FloorPixels);
+    *Raster = (raster){0};
+}
+
+void RasterRun(raster* Raster, poolTask* Task, int Count, int ChunkSize) {
+    if(Raster->Pool) {
+        PoolRun(Raster->Pool, Task, Raster, Count, ChunkSize);
+    } else if(Count > 0) {
+        Task(Raster, 0, Count, 0);
+    }
+}
+
+// Vertex stage
+
+typedef struct {
+    int32_t X, Y; // Subpixels
+    int Valid;
+} rasterPoint;
+
+void TransformMesh(matrix* M, float (*Vertices)[3], float (*Clip)[4], int Count) {
+    for(int Index = 0; Index < Count; ++Index) {
+        for(int Column = 0; Column < 4; ++Column) {
+            Clip[Index][Column] = Vertices[Index][0] * M->M[0][Column] + Vertices[Index][1] * M->M[1][Column] +
+                                  Vertices[Index][2] * M->M[2][Column];
+        }
+    }
+}
+
+// The instance only moves the mesh, so a vertex through the
+// view-projection is the instance position through it plus the mesh
+// vertex through it
+
+rasterPoint ProjectVertex(raster* Raster, float* Base, float* Offset) {
+    float X = Base[0] + Offset[0];
+    float Y = Base[1] + Offset[1];
+    float Z = Base[2] + Offset[2];
+    float W = Base[3] + Offset[3];
+    if(W <= 1e-6f || Z < 0.0f || Z > W) return (rasterPoint){0};
+
+    float ScreenX = (X / W + 1.0f) * 0.5f * (float)Raster->Width;
+    float ScreenY = (1.0f - Y / W) * 0.5f * (float)Raster->Height;
+    if(ScreenX < -RASTER_GUARD || ScreenX > Raster->Width + RASTER_GUARD ||
+       ScreenY < -RASTER_GUARD || ScreenY > Raster->Height + RASTER_GUARD) {
+        return (rasterPoint){0};
+    }
+
+    return (rasterPoint){
+        (int32_t)lrintf(ScreenX * RASTER_SUBPIXEL),
+        (int32_t)lrintf(ScreenY * RASTER_SUBPIXEL),
+        1,
+    };
+}
+
+int16_t ClampPixel(int32_t Value, int Limit) {
+    return (int16_t)(Value < 0 ? 0 : (Value >= Limit ? Limit - 1 : Value));
+}
+
+int64_t TriangleArea(rasterPoint A, rasterPoint B, rasterPoint C) {
+    return (int64_t)(B.X - A.X) * (C.Y - A.Y) - (int64_t)(C.X - A.X) * (B.Y - A.Y);
+}
+
+rasterTriangle SetupTriangle(raster* Raster, rasterPoint A, rasterPoint B, rasterPoint C, uint32_t Color) {
+    rasterTriangle Triangle = {.MinY = 1, .MaxY = 0, .Color = Color};
+    if(!A.Valid || !B.Valid || !C.Valid || TriangleArea(A, B, C) <= 0) return Triangle;
+
+    int32_t MinX = A.X < B.X ? (A.X < C.X ? A.X : C.X) : (B.X < C.X ? B.X : C.X);
+    int32_t MaxX = A.X > B.X ? (A.X > C.X ? A.X : C.X) : (B.X > C.X ? B.X : C.X);
+    int32_t MinY = A.Y < B.Y ? (A.Y < C.Y ? A.Y : C.Y) : (B.Y < C.Y ? B.Y : C.Y);
+    int32_t MaxY = A.Y > B.Y ? (A.Y > C.Y ? A.Y : C.Y) : (B.Y > C.Y ? B.Y : C.Y);
+
+    MinX >>= RASTER_SUBPIXEL_BITS;
+    MaxX >>= RASTER_SUBPIXEL_BITS;
+    MinY >>= RASTER_SUBPIXEL_BITS;
+    MaxY >>= RASTER_SUBPIXEL_BITS;
+    if(MaxX < 0 || MaxY < 0 || MinX >= Raster->Width || MinY >= Raster->Height) return Triangle;
+
+    Triangle.X[0] = A.X; Triangle.Y[0] = A.Y;
+    Triangle.X[1] = B.X; Triangle.Y[1] = B.Y;
+    Triangle.X[2] = C.X; Triangle.Y[2] = C.Y;
+    Triangle.MinX = ClampPixel(MinX, Raster->Width);
+    Triangle.MaxX = ClampPixel(MaxX, Raster->Width);
+    Triangle.MinY = ClampPixel(MinY, Raster->Height);
+    Triangle.MaxY = ClampPixel(MaxY, Raster->Height);
+    return Triangle;
+}
+
+rasterLine SetupLine(raster* Raster, rasterPoint A, rasterPoint B, uint32_t Color) {
+    rasterLine Line = {.MinY = 1, .MaxY = 0, .Color = Color};
+    if(!A.Valid || !B.Valid) return Line;
+
+    Line.X0 = A.X >> RASTER_SUBPIXEL_BITS;
+    Line.Y0 = A.Y >> RASTER_SUBPIXEL_BITS;
+    Line.X1 = B.X >> RASTER_SUBPIXEL_BITS;
+    Line.Y1 = B.Y >> RASTER_SUBPIXEL_BITS;
+
+    int32_t MinY = Line.Y0 < Line.Y1 ? Line.Y0 : Line.Y1;
+    int32_t MaxY = Line.Y0 < Line.Y1 ? Line.Y1 : Line.Y0;
+    if(MaxY < 0 || MinY >= Raster->Height) return Line;
+    Line.MinY = ClampPixel(MinY, Raster->Height);
+    Line.MaxY = ClampPixel(MaxY, Raster->Height);
+    return Line;
+}
+
+void SetupInstances(void* Context, int Begin, int End, int Worker) {
+    raster* Raster = Context;
+    rasterPass* Pass = &Raster->Passes[Raster->SetupPass];
+    matrix* M = &Raster->ViewProjection;
+
+    for(int Index = Begin; Index < End; ++Index) {
+        drawInstance* Instance = &Raster->SetupInstances[Index];
+        uint32_t Color = Raster->Palette[Instance->Palette];
+
+        float Base[4];
+        for(int Column = 0; Column < 4; ++Column) {
+            Base[Column] = Instance->X * M->M[0][Column] + Instance->Y * M->M[1][Column] + M->M[3][Column];
+        }
+
+        if(Pass->Kind == RASTER_OUTLINES) {
+            rasterLine* Lines = Pass->Lines + 4 * Index;
+            for(int Line = 0; Line < 4; ++Line) {
+                rasterPoint A = ProjectVertex(Raster, Base, Raster->OutlineClip[2 * Line]);
+                rasterPoint B = ProjectVertex(Raster, Base, Raster->OutlineClip[2 * Line + 1]);
+                Lines[Line] = SetupLine(Raster, A, B, Color);
+            }
+            continue;
+        }
+
+        for(int Triangle = 0; Triangle < 2; ++Triangle) {
+            rasterPoint A = ProjectVertex(Raster, Base, Raster->SquareClip[3 * Triangle]);
+            rasterPoint B = ProjectVertex(Raster, Base, Raster->SquareClip[3 * Triangle + 1]);
+            rasterPoint C = ProjectVertex(Raster, Base, Raster->SquareClip[3 * Triangle + 2]);
+
+            if(Pass->Kind == RASTER_TRIANGLES) {
+                Pass->Triangles[2 * Index + Triangle] = SetupTriangle(Raster, A, B, C, Color);
+            } else {
+                rasterLine* Lines = Pass->Lines + 6 * Index + 3 * Triangle;
+                int Front = A.Valid && B.Valid && C.Valid && TriangleArea(A, B, C) > 0;
+                rasterLine Culled = {.MinY = 1, .MaxY = 0};
+                Lines[0] = Front ? SetupLine(Raster, A, B, Color) : Culled;
+                Lines[1] = Front ? SetupLine(Raster, B, C, Color) : Culled;
+                Lines[2] = Front ? SetupLine(Raster, C, A, Color) : Culled;
+            }
+        }
+    }
+}
+
+void SetupPass(raster* Raster, int Pass, drawInstance* Instances, int Count) {
+    rasterPass* Target = &Raster->Passes[Pass];
+    if(Count > Target->Capacity) {
+        free(Target->Triangles);
+        free(Target->Lines);
+        Target->Capacity = Count * 2;
+        Target->Triangles = 0;
+        Target->Lines = 0;
+        if(Target->Kind == RASTER_TRIANGLES) {
+            Target->Triangles = malloc(2 * (size_t)Target->Capacity * sizeof(rasterTriangle));
+            assert(Target->Triangles);
+        } else {
+            Target->Lines = malloc(6 * (size_t)Target->Capacity * sizeof(rasterLine));
+            assert(Target->Lines);
+        }
+    }
+    Target->Count = Count;
+
+    Raster->SetupPass = Pass;
+    Raster->SetupInstances = Instances;
+    RasterRun(Raster, SetupInstances, Count, 1024);
+}
+
+// Pixel stage, everything clipped to the rows [Top, Bottom)
+
+void DrawTriangle(raster* Raster, uint32_t* Pixels, rasterTriangle* Triangle, int Top, int Bottom) {
+    int MinY = Triangle->MinY > Top ? Triangle->MinY : Top;
+    int MaxY = Triangle->MaxY < Bottom - 1 ? Triangle->MaxY : Bottom - 1;
+    if(MinY > MaxY) return;
+
+    // Edge I runs from vertex I to the next one and is positive inside
+
+    int64_t A[3], B[3], Bias[3];
+    for(int Edge = 0; Edge < 3; ++Edge) {
+        int Next = Edge == 2 ? 0 : Edge + 1;
+        A[Edge] = (int64_t)Triangle->Y[Edge] - Triangle->Y[Next];
+        B[Edge] = (int64_t)Triangle->X[Next] - Triangle->X[Edge];
+        int TopLeft = A[Edge] > 0 || (A[Edge] == 0 && B[Edge] > 0);
+        Bias[Edge] = TopLeft ? 0 : -1;
+    }
+
+    int32_t Dx[3], Dy[3];
+    for(int Edge = 0; Edge < 3; ++Edge) {
+        Dx[Edge] = (int32_t)(A[Edge] * RASTER_SUBPIXEL);
+        Dy[Edge] = (int32_t)(B[Edge] * RASTER_SUBPIXEL);
+    }
+
+    int Last = RASTER_BLOCK - 1;
+    for(int BlockY = MinY & ~Last; BlockY <= MaxY; BlockY += RASTER_BLOCK) {
+        int Rows = Bottom - BlockY < RASTER_BLOCK ? Bottom - BlockY : RASTER_BLOCK;
+        int64_t CenterY = (int64_t)BlockY * RASTER_SUBPIXEL + RASTER_SUBPIXEL / 2;
+
+        for(int BlockX = Triangle->MinX & ~Last; BlockX <= Triangle->MaxX; BlockX += RASTER_BLOCK) {
+            int Columns = Raster->Width - BlockX < RASTER_BLOCK ? Raster->Width - BlockX : RASTER_BLOCK;
+            int64_t CenterX = (int64_t)BlockX * RASTER_SUBPIXEL + RASTER_SUBPIXEL / 2;
+
+            int32_t E[3], StepX[3], StepY[3];
+            int Covered = 0;
+            int Outside = 0;
+
+            for(int Edge = 0; Edge < 3; ++Edge) {
+                int64_t Corner = A[Edge] * (CenterX - Triangle->X[Edge]) +
+                                 B[Edge] * (CenterY - Triangle->Y[Edge]) + Bias[Edge];
+                int64_t Across = (int64_t)Dx[Edge] * Last;
+                int64_t Down = (int64_t)Dy[Edge] * Last;
+                int64_t Min = Corner + (Across < 0 ? Across : 0) + (Down < 0 ? Down : 0);
+                int64_t Max = Corner + (Across > 0 ? Across : 0) + (Down > 0 ? Down : 0);
+
+                if(Max < 0) {
+                    Outside = 1;
+                    break;
+                }
+                if(Min >= 0) {
+                    E[Edge] = StepX[Edge] = StepY[Edge] = 0;
+                    ++Covered;
+                } else {
+                    E[Edge] = (int32_t)Corner;
+                    StepX[Edge] = Dx[Edge];
+                    StepY[Edge] = Dy[Edge];
+                }
+            }
+            if(Outside) continue;
+
+            uint32_t* Block = Pixels + (size_t)BlockY * Raster->Width + BlockX;
+            if(Covered == 3) {
+                for(int Row = 0; Row < Rows; ++Row) {
+                    for(int Column = 0; Column < Columns; ++Column) Block[Column] = Triangle->Color;
+                    Block += Raster->Width;
+                }
+            } else {
+                Raster->Block(Block, Raster->Width, Rows, Columns, E, StepX, StepY, Triangle->Color);
+            }
+        }
+    }
+}
+
+void DrawLine(raster* Raster, uint32_t* Pixels, rasterLine* Line, int Top, int Bottom) {
+    if(Line->MaxY < Line->MinY || Line->MaxY < Top || Line->MinY >= Bottom) return;
+
+    int X = Line->X0;
+    int Y = Line->Y0;
+    int Dx = abs(Line->X1 - X);
+    int Dy = -abs(Line->Y1 - Y);
+    int StepX = X < Line->X1 ? 1 : -1;
+    int StepY = Y < Line->Y1 ? 1 : -1;
+    int Error = Dx + Dy;
+
+    while(X != Line->X1 || Y != Line->Y1) {
+        if(Y >= Top && Y < Bottom && X >= 0 && X < Raster->Width) {
+            Pixels[(size_t)Y * Raster->Width + X] = Line->Color;
+        }
+        int Twice = 2 * Error;
+        if(Twice >= Dy) {
+            Error += Dy;
+            X += StepX;
+        }
+        if(Twice <= Dx) {
+            Error += Dx;
+            Y += StepY;
+        }
+    }
+}
+
+void DrawPass(raster* Raster, uint32_t* Pixels, int Pass, int Top, int Bottom) {
+    rasterPass* Source = &Raster->Passes[Pass];
+    if(Source->Kind == RASTER_TRIANGLES) {
+        for(int Index = 0; Index < 2 * Source->Count; ++Index) {
+            rasterTriangle* Triangle = &Source->Triangles[Index];
+            if(Triangle->MaxY < Top || Triangle->MinY >= Bottom) continue;
+            DrawTriangle(Raster, Pixels, Triangle, Top, Bottom);
+        }
+    } else {
+        int Lines = (Source->Kind == RASTER_OUTLINES ? 4 : 6) * Source->Count;
+        for(int Index = 0; Index < Lines; ++Index) {
+            DrawLine(Raster, Pixels, &Source->Lines[Index], Top, Bottom);
+        }
+    }
+}
+
+void DrawBands(void* Context, int Begin, int End, int Worker) {
+    raster* Raster = Context;
+    for(int Band = Begin; Band < End; ++Band) {
+        int Top = Band * RASTER_BAND;
+        int Bottom = Top + RASTER_BAND < Raster->Height ? Top + RASTER_BAND : Raster->Height;
+        size_t First = (size_t)Top * Raster->Width;
+        size_t Count = (size_t)(Bottom - Top) * Raster->Width;
+
+        if(Raster->DrawingFloor) {
+            for(size_t Index = 0; Index < Count; ++Index) Raster->FloorPixels[First + Index] = Raster->ClearColor;
+            DrawPass(Raster, Raster->FloorPixels, DRAW_FLOOR, Top, Bottom);
+            DrawPass(Raster, Raster->FloorPixels, DRAW_FLOOR_WIREFRAME, Top, Bottom);
+            continue;
+        }
+
+        memcpy(Raster->Pixels + First, Raster->FloorPixels + First, Count * sizeof(uint32_t));
+        DrawPass(Raster, Raster->Pixels, DRAW_FILL, Top, Bottom);
+        DrawPass(Raster, Raster->Pixels, DRAW_BORDER, Top, Bottom);
+        DrawPass(Raster, Raster->Pixels, DRAW_WIREFRAME, Top, Bottom);
+    }
+}
+
+// The backend
+
+void RasterSubmit(void* Backend, drawList* List, matrix* ViewProjection) {
+    raster* Raster = Backend;
+    int Bands = (Raster->Height + RASTER_BAND - 1) / RASTER_BAND;
+
+    Raster->ViewProjection = *ViewProjection;
+    TransformMesh(ViewProjection, DrawSquareVertices, Raster->SquareClip, 6);
+    TransformMesh(ViewProjection, DrawOutlineVertices, Raster->OutlineClip, 8);
+
+    int FloorWireframe = List->Count[DRAW_FLOOR_WIREFRAME] > 0;
+    if(Raster->FloorVersion != List->FloorVersion || Raster->FloorWireframe != FloorWireframe ||
+       memcmp(&Raster->FloorViewProjection, ViewProjection, sizeof(matrix))) {
+        Raster->FloorVersion = List->FloorVersion;
+        Raster->FloorViewProjection = *ViewProjection;
+        Raster->FloorWireframe = FloorWireframe;
+
+        SetupPass(Raster, DRAW_FLOOR, List->Floor, List->FloorTiles);
+        SetupPass(Raster, DRAW_FLOOR_WIREFRAME, GetPassInstances(List, DRAW_FLOOR_WIREFRAME),
+                  List->Count[DRAW_FLOOR_WIREFRAME]);
+
+        Raster->DrawingFloor = 1;
+        RasterRun(Raster, DrawBands, Bands, 1);
+        Raster->DrawingFloor = 0;
+        ++Raster->FloorDraws;
+    }
+
+    SetupPass(Raster, DRAW_FILL, GetPassInstances(List, DRAW_FILL), List->Count[DRAW_FILL]);
+    SetupPass(Raster, DRAW_BORDER, GetPassInstances(List, DRAW_BORDER), List->Count[DRAW_BORDER]);
+    SetupPass(Raster, DRAW_WIREFRAME, GetPassInstances(List, DRAW_WIREFRAME), List->Count[DRAW_WIREFRAME]);
+
+    RasterRun(Raster, DrawBands, Bands, 1);
+    ++Raster->Frames;
+}
+
+// Binary PPM, returns 0 if the file can't be written
+
+int RasterWritePpm(raster* Raster, char* Path) {
+    FILE* File = fopen(Path, "wb");
+    if(!File) return 0;
+
+    fprintf(File, "P6\n%d %d\n255\n", Raster->Width, Raster->Height);
+    uint8_t* Row = malloc((size_t)Raster->Width * 3);
+    assert(Row);
+    for(int Y = 0; Y < Raster->Height; ++Y) {
+        uint32_t* Pixels = Raster->Pixels + (size_t)Y * Raster->Width;
+        for(int X = 0; X < Raster->Width; ++X) {
+            Row[3 * X] = (uint8_t)Pixels[X];
+            Row[3 * X + 1] = (uint8_t)(Pixels[X] >> 8);
+            Row[3 * X + 2] = (uint8_t)(Pixels[X] >> 16);
+        }
+        fwrite(Row, 3, (size_t)Raster->Width, File);
+    }
+    free(Row);
+    return fclose(File) == 0;
+}
@@ -0,0 +1,242 @@
+// Game recordings: the seed and board size plus every direction the
+// simulation popped from InputQueue, which is all it takes to run the
+// game again tick for tick.
+//
+// Layout, all numbers are LEB128 varints unless noted:
+//
+//   "SNKR" Version XTiles YTiles Seed
+//   Event*         (TickDelta * 4 + Direction), TickDelta >= 1
+//   0              end of events
+//   Ticks Hash     total ticks and GameHash() at the end, Hash is 8 bytes
+//                  little endian
+//
+// TickDelta counts from the previous event (from tick 0 for the first),
+// a tick pops at most one input so it is never 0. Without input the
+// snake goes straight and hits the border, so neither it nor the ticks
+// after the last event can be more than the longer side of the board,
+// and nothing is recorded after the tick the game ended on.
+
+#include <stdio.h>
+#include <string.h>
+
+#define RECORDING_VERSION 1
+
+typedef struct {
+    uint8_t* Data;
+    size_t Size;
+    size_t Capacity;
+    uint64_t LastEventTick;
+    uint64_t Events;
+} recording;
+
+// Writing
+
+void RecordingPushByte(recording* Recording, uint8_t Byte) {
+    if(Recording->Size == Recording->Capacity) {
+        Recording->Capacity = Recording->Capacity ? Recording->Capacity * 2 : 256;
+        Recording->Data = realloc(Recording->Data, Recording->Capacity);
+        assert(Recording->Data);
+    }
+    Recording->Data[Recording->Size++] = Byte;
+}
+
+void RecordingPushVarint(recording* Recording, uint64_t Value) {
+    while(Value >= 0x80) {
+        RecordingPushByte(Recording, (uint8_t)(Value | 0x80));
+        Value >>= 7;
+    }
+    RecordingPushByte(Recording, (uint8_t)Value);
+}
+
+// Call right after GameInit
+
+void RecordingBegin(recording* Recording, game* Game) {
+    *Recording = (recording){0};
+    RecordingPushByte(Recording, 'S');
+    RecordingPushByte(Recording, 'N');
+    RecordingPushByte(Recording, 'K');
+    RecordingPushByte(Recording, 'R');
+    RecordingPushVarint(Recording, RECORDING_VERSION);
+    RecordingPushVarint(Recording, Game->XTiles);
+    RecordingPushVarint(Recording, Game->YTiles);
+    RecordingPushVarint(Recording, Game->Seed);
+}
+
+// Call after every GameUpdate
+
+void RecordingTick(recording* Recording, game* Game) {
+    int Direction = Game->LastInput;
+    if(Direction < 0 || Direction >= KEYSAMOUNT) return;
+
+    uint64_t Delta = Game->Tick - Recording->LastEventTick;
+    RecordingPushVarint(Recording, Delta * 4 + (uint64_t)Direction);
+    Recording->LastEventTick = Game->Tick;
+    ++Recording->Events;
+}
+
+void RecordingEnd(recording* Recording, game* Game) {
+    RecordingPushVarint(Recording, 0);
+    RecordingPushVarint(Recording, Game->Tick);
+    uint64_t Hash = GameHash(Game);
+    for(int Byte = 0; Byte < 8; ++Byte) {
+        RecordingPushByte(Recording, (uint8_t)(Hash >> (Byte * 8)));
+    }
+}
+
+void RecordingFree(recording* Recording) {
+    free(Recording->Data);
+    *Recording = (recording){0};
+}
+
+int RecordingSave(recording* Recording, char* Path) {
+    FILE* File = fopen(Path, "wb");
+    if(!File) return 0;
+    size_t Written = fwrite(Recording->Data, 1, Recording->Size, File);
+    fclose(File);
+    return Written == Recording->Size;
+}
+
+int RecordingLoad(recording* Recording, char* Path) {
+    *Recording = (recording){0};
+    FILE* File = fopen(Path, "rb");
+    if(!File) return 0;
+    uint8_t Buffer[4096];
+    size_t Read;
+    while((Read = fread(Buffer, 1, sizeof(Buffer), File)) > 0) {
+        for(size_t Index = 0; Index < Read; ++Index) {
+            RecordingPushByte(Recording, Buffer[Index]);
+        }
+    }
+    fclose(File);
+    return 1;
+}
+
+// Reading
+
+typedef struct {
+    uint8_t* At;
+    uint8_t* End;
+    int Failed;
+} reader;
+
+uint64_t ReadVarint(reader* Reader) {
+    uint64_t Value = 0;
+    for(int Shift = 0; Shift < 64; Shift += 7) {
+        if(Reader->At >= Reader->End) break;
+        uint8_t Byte = *Reader->At++;
+        Value |= (uint64_t)(Byte & 0x7f) << Shift;
+        if(!(Byte & 0x80)) return Value;
+    }
+    Reader->Failed = 1;
+    return 0;
+}
+
+enum {
+    REPLAY_OK,
+    REPLAY_BAD_FILE,
+    REPLAY_MISMATCH,
+};
+
+typedef struct {
+    uint64_t Version;
+    int XTiles;
+    int YTiles;
+    uint64_t Seed;
+} replayHeader;
+
+// Returns how many bytes the header takes, 0 if the recording doesn't
+// start with one this version plays
+
+size_t ReplayReadHeader(recording* Recording, replayHeader* Header) {
+    reader Reader = {Recording->Data, Recording->Data + Recording->Size};
+
+    if(Recording->Size < 4 || memcmp(Reader.At, "SNKR", 4)) return 0;
+    Reader.At += 4;
+
+    uint64_t Version = ReadVarint(&Reader);
+    uint64_t XTiles = ReadVarint(&Reader);
+    uint64_t YTiles = ReadVarint(&Reader);
+    uint64_t Seed = ReadVarint(&Reader);
+
+    if(Reader.Failed || Version != RECORDING_VERSION ||
+       XTiles < 1 || XTiles > MAX_TILES || YTiles < 1 || YTiles > MAX_TILES) {
+        return 0;
+    }
+
+    *Header = (replayHeader){Version, (int)XTiles, (int)YTiles, Seed};
+    return (size_t)(Reader.At - Recording->Data);
+}
+
+typedef void replayTick(void* Context, game* Game);
+
+// Everything after the header, into the game GameInit just started
+
+int ReplayEvents(reader* Reader, game* Game, replayTick* Tick, void* Context) {
+    uint64_t Extent = Game->XTiles > Game->YTiles ? Game->XTiles : Game->YTiles;
+
+    // Ticks without input run back to back, the event's input goes in
+    // right before the tick that popped it
+
+    for(;;) {
+        uint64_t Event = ReadVarint(Reader);
+        if(Reader->Failed) return REPLAY_BAD_FILE;
+        if(Event == 0) break;
+
+        uint64_t Delta = Event >> 2;
+        if(Delta < 1 || Delta > Extent) return REPLAY_BAD_FILE;
+
+        uint64_t EventTick = Game->Tick + Delta;
+        while(Game->Tick + 1 < EventTick) {
+            if(!Game->Running) return REPLAY_BAD_FILE;
+            GameUpdate(Game);
+            if(Tick) Tick(Context, Game);
+        }
+
+        if(!Game->Running) return REPLAY_BAD_FILE;
+        InputQueueAdd(&Game->InputQueue, (int)(Event & 3));
+        GameUpdate(Game);
+        if(Tick) Tick(Context, Game);
+    }
+
+    uint64_t Ticks = ReadVarint(Reader);
+    if(Reader->Failed || Reader->End - Reader->At < 8 || Ticks < Game->Tick || Ticks - Game->Tick > Extent) {
+        return REPLAY_BAD_FILE;
+    }
+
+    while(Game->Tick < Ticks) {
+        if(!Game->Running) return REPLAY_BAD_FILE;
+        GameUpdate(Game);
+        if(Tick) Tick(Context, Game);
+    }
+
+    uint64_t Hash = 0;
+    for(int Byte = 0; Byte < 8; ++Byte) {
+        Hash |= (uint64_t)Reader->At[Byte] << (Byte * 8);
+    }
+
+    return GameHash(Game) == Hash ? REPLAY_OK : REPLAY_MISMATCH;
+}
+
+// Runs the recorded game in Game (which the caller frees) and checks it
+// ends up with the recorded hash. Tick, if given, sees the game once
+// before the first tick and after every tick. A file that goes on after
+// the game ended is bad, so a made up one can't keep it ticking. On
+// REPLAY_BAD_FILE there is nothing to free.
+
+int ReplayRunEach(recording* Recording, game* Game, replayTick* Tick, void* Context) {
+    replayHeader Header;
+    size_t HeaderSize = ReplayReadHeader(Recording, &Header);
+    if(!HeaderSize) return REPLAY_BAD_FILE;
+
+    GameInit(Game, Header.XTiles, Header.YTiles, Header.Seed);
+    if(Tick) Tick(Context, Game);
+
+    reader Reader = {Recording->Data + HeaderSize, Recording->Data + Recording->Size};
+    int Result = ReplayEvents(&Reader, Game, Tick, Context);
+    if(Result == REPLAY_BAD_FILE) GameFree(Game);
+    return Result;
+}
+
+int ReplayRun(recording* Recording, game* Game) {
+    return ReplayRunEach(Recording, Game, 0, 0);
+}
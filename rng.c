@@ -0,0 +1,91 @@
+// Random numbers, xoshiro256** seeded through splitmix64. Each game owns
+// its generators so games can be reproduced from their seed and run on
+// any number of threads without sharing state.
+
+#include <stdint.h>
+
+typedef struct {
+    uint64_t State[4];
+} rng;
+
+uint64_t SplitMix64(uint64_t* State) {
+    uint64_t Value = (*State += 0x9e3779b97f4a7c15ull);
+    Value = (Value ^ (Value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    Value = (Value ^ (Value >> 27)) * 0x94d049bb133111ebull;
+    return Value ^ (Value >> 31);
+}
+
+uint64_t RotateLeft(uint64_t Value, int Amount) {
+    return (Value << Amount) | (Value >> (64 - Amount));
+}
+
+// Streams with the same seed and different numbers start from unrelated
+// states
+
+void RngInit(rng* Rng, uint64_t Seed, uint64_t Stream) {
+    uint64_t State = Seed ^ RotateLeft(Stream * 0xd1342543de82ef95ull, 32);
+    for(int Index = 0; Index < 4; ++Index) {
+        Rng->State[Index] = SplitMix64(&State);
+    }
+}
+
+uint64_t RngNext(rng* Rng) {
+    uint64_t* S = Rng->State;
+    uint64_t Result = RotateLeft(S[1] * 5, 7) * 9;
+    uint64_t T = S[1] << 17;
+    S[2] ^= S[0];
+    S[3] ^= S[1];
+    S[1] ^= S[2];
+    S[0] ^= S[3];
+    S[2] ^= T;
+    S[3] = RotateLeft(S[3], 45);
+    return Result;
+}
+
+// Advances by 2^128 draws
+
+void RngJump(rng* Rng) {
+    static const uint64_t Jump[] = {
+        0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull,
+        0xa9582618e03fc9aaull, 0x39abdc4529b1661cull,
+    };
+
+    uint64_t S[4] = {0};
+    for(int Word = 0; Word < 4; ++Word) {
+        for(int Bit = 0; Bit < 64; ++Bit) {
+            if(Jump[Word] & (1ull << Bit)) {
+                for(int Index = 0; Index < 4; ++Index) S[Index] ^= Rng->State[Index];
+            }
+            RngNext(Rng);
+        }
+    }
+    for(int Index = 0; Index < 4; ++Index) Rng->State[Index] = S[Index];
+}
+
+// Returns a generator that never overlaps what is left of Rng
+
+rng RngSplit(rng* Rng) {
+    rng Result = *Rng;
+    RngJump(Rng);
+    return Result;
+}
+
+// Uniform in [0, Limit), multiply and shift with rejection of the biased
+// low range
+
+uint32_t RngBelow(rng* Rng, uint32_t Limit) {
+    uint64_t Product = (RngNext(Rng) >> 32) * Limit;
+    uint32_t Low = (uint32_t)Product;
+    if(Low < Limit) {
+        uint32_t Threshold = -Limit % Limit;
+        while(Low < Threshold) {
+            Product = (RngNext(Rng) >> 32) * Limit;
+            Low = (uint32_t)Product;
+        }
+    }
+    return (uint32_t)(Product >> 32);
+}
+
+float RngZeroToOne(rng* Rng) {
+    return (float)(RngNext(Rng) >> 40) / (float)(1 << 24);
+}
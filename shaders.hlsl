@@ -1,14 +1,20 @@
-cbuffer constants : register(b0)
+// PALETTE_AMOUNT is defined by main.c when compiling
+
+cbuffer frame : register(b0)
 {
-    row_major float4x4 model;
-    row_major float4x4 view;
-    row_major float4x4 projection;
-	float4 color;
+    row_major float4x4 view_projection;
+};
+
+cbuffer palette : register(b1)
+{
+    float4 colors[PALETTE_AMOUNT];
 };
 
 struct VS_Input
 {
 	float3 position: POSITION;
+	float2 instance: INSTANCE; // Tile the square goes on
+	uint2 palette: PALETTE; // Palette index and layer
 };
 
 struct VS_Output
@@ -20,12 +26,13 @@ struct VS_Output
 VS_Output vs_main(VS_Input input)
 {
 	VS_Output output;
-	output.position = mul(float4(input.position, 1.0f), mul(mul(model, view), projection));
-	output.color = color;
+	float3 position = input.position + float3(input.instance, 0.0f);
+	output.position = mul(float4(position, 1.0f), view_projection);
+	output.color = colors[input.palette.x];
 	return output;
 };
 
 float4 ps_main(VS_Output input): SV_TARGET
 {
 	return input.color;
-};
\ No newline at end of file
+};
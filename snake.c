@@ -0,0 +1,560 @@
+// Platform independent game simulation. Included by main.c (Win32/D3D11)
+// and headless.c (Linux driver), no OS headers allowed in here.
+//
+// Everything is in integer cells: a cell is the linear index of a tile on
+// the board padded with a one tile border, (Y + 1) * Stride + X + 1.
+// Floats only show up when a renderer turns cells into positions.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+
+#include "rng.c"
+
+typedef struct { float R, G, B, A; } color;
+
+#define MAX_TILES 16384 // Per side
+
+// Palette
+
+color ColorBGPlatform = {0.2f, 0.2f, 0.2f, 1.0f};
+color ColorBGPlatformLighter = {0.21f, 0.21f, 0.21f, 1.0f};
+color ColorHead = {1.0f, 0.05f, 0.95f, 1.0f};
+color ColorFood = {0.30f, 0.4f, 0.9f, 1.0f};
+color ColorBorder = {0.2f, 0.2f, 0.2f, 1.0f};
+color ColorWireframe = {0.3f, 0.3f, 0.3f, 1.0f};
+
+// Every piece is a bit lighter than the one in front of it. After
+// PIECE_SHADES pieces all channels are saturated so the rest share the
+// last shade.
+
+#define PIECE_SHADES 21
+
+enum {
+    PALETTE_PLATFORM,
+    PALETTE_PLATFORM_LIGHTER,
+    PALETTE_FOOD,
+    PALETTE_BORDER,
+    PALETTE_WIREFRAME,
+    PALETTE_PIECE,
+    PALETTE_AMOUNT = PALETTE_PIECE + PIECE_SHADES,
+};
+
+color Palette[PALETTE_AMOUNT];
+
+float Saturate(float Value) {
+    return Value < 0.0f ? 0.0f : (Value > 1.0f ? 1.0f : Value);
+}
+
+void InitPalette() {
+    Palette[PALETTE_PLATFORM] = ColorBGPlatform;
+    Palette[PALETTE_PLATFORM_LIGHTER] = ColorBGPlatformLighter;
+    Palette[PALETTE_FOOD] = ColorFood;
+    Palette[PALETTE_BORDER] = ColorBorder;
+    Palette[PALETTE_WIREFRAME] = ColorWireframe;
+
+    for(int Index = 0; Index < PIECE_SHADES; ++Index) {
+        color Color = ColorHead;
+        Color.R = Saturate(Color.R - 0.05f * Index);
+        Color.G = Saturate(Color.G + 0.05f * Index);
+        Color.B = Saturate(Color.B + 0.05f * Index);
+        Palette[PALETTE_PIECE + Index] = Color;
+    }
+}
+
+int GetPiecePalette(int Index) {
+    return PALETTE_PIECE + (Index < PIECE_SHADES ? Index : PIECE_SHADES - 1);
+}
+
+// Directions, opposite directions differ by two
+
+enum {UP, LEFT, DOWN, RIGHT, KEYSAMOUNT};
+
+int IsOppositeDirection(int A, int B) {
+    return (A ^ B) == 2;
+}
+
+// Directions waiting for a tick, one is popped per tick. When it is full
+// the oldest one goes, the latest key press is what the player means.
+
+#define INPUT_QUEUE_SIZE 4
+#define GAME_DIRTY 128 // Power of two
+
+typedef struct {
+    int Length;
+    int Values[INPUT_QUEUE_SIZE];
+    uint64_t Nanos[INPUT_QUEUE_SIZE]; // When the input happened, 0 if nobody measured
+} inputQueue;
+
+// Game state
+
+// Random streams of a game, all derived from its seed
+
+enum {
+    STREAM_FOOD,
+    STREAM_FLOOR,
+};
+
+typedef struct {
+    uint64_t Seed;
+    rng Rng; // STREAM_FOOD
+    uint64_t Tick;
+    int LastInput; // What the last tick popped from InputQueue, -1 if nothing
+    uint64_t LastInputNanos; // and when that input happened
+    int TailLength;
+    int XTiles;
+    int YTiles;
+    uint32_t Food;
+    int Running;
+    int Delay;
+    int DelayMin;
+    inputQueue InputQueue;
+
+    // One bit per cell, set for snake pieces. The board is padded with a
+    // one cell border that is always set so bounds and self-collision are
+    // the same bit test.
+
+    int Stride;
+    uint64_t* Occupied;
+
+    // Cell offset of one step in each direction
+
+    int Steps[KEYSAMOUNT];
+
+    // The platform is not stored, lighter tiles come from hashing the cell
+    // with FloorSeed.
+
+    uint32_t FloorSeed;
+
+    // Snake pieces as a ring buffer of cells, Body[BodyHead] is the head.
+    // Moving pushes a new head and pops the tail, Growing skips the pop.
+    // BodyCapacity is a power of two and doubles when the ring is full.
+
+    uint32_t* Body;
+    int BodyCapacity;
+    int BodyHead;
+    int BodyLength;
+    int Growing;
+    int Direction;
+
+    // Tail cell given up by the last tick, NO_CELL if the snake grew.
+    // Renderers use it to slide the tail.
+
+    uint32_t Vacated;
+
+    // Cells whose contents changed, as a ring of the last GAME_DIRTY:
+    // where the head went, the tail cell it gave up and where food was
+    // placed. DirtyCount counts every cell ever added, so a renderer that
+    // remembers it can tell what changed since it last looked, or that it
+    // fell too far behind and has to redraw everything.
+
+    uint32_t Dirty[GAME_DIRTY];
+    uint64_t DirtyCount;
+
+    // Free cells for placing food. While the snake covers at most half the
+    // board a random tile is free with probability >= 1/2, so food is
+    // placed by retrying. Past that the free cells are kept as a dense
+    // array plus each cell's index in it, so picking one stays O(1) up to
+    // a full board. Food is NO_FOOD once there is nowhere left to put it.
+    // The arrays outlive GameReset, UseFreeCells says if they are kept up.
+
+    uint32_t* FreeCells;
+    uint32_t* FreeIndex;
+    int FreeCount;
+    int UseFreeCells;
+} game;
+
+#define NO_CELL 0 // Border corner, the head can never get there
+#define NO_FOOD NO_CELL
+
+// Removes the entry at Index
+
+void InputQueueRemove(inputQueue* Q, int Index) {
+    for(int Next = Index + 1; Next < Q->Length; ++Next) {
+        Q->Values[Next - 1] = Q->Values[Next];
+        Q->Nanos[Next - 1] = Q->Nanos[Next];
+    }
+    --Q->Length;
+}
+
+void InputQueueAddAt(inputQueue* Q, int Direction, uint64_t Nanos) {
+    if(Q->Length >= INPUT_QUEUE_SIZE) InputQueueRemove(Q, 0);
+    Q->Values[Q->Length] = Direction;
+    Q->Nanos[Q->Length] = Nanos;
+    ++Q->Length;
+}
+
+void InputQueueAdd(inputQueue* Q, int Direction) {
+    InputQueueAddAt(Q, Direction, 0);
+}
+
+int InputQueuePop(inputQueue* Q) {
+    if(Q->Length <= 0) return -1;
+    int Result = Q->Values[0];
+    InputQueueRemove(Q, 0);
+    return Result;
+}
+
+color GetRandomColor(rng* Rng) {
+    return (color){
+        RngZeroToOne(Rng),
+        RngZeroToOne(Rng),
+        RngZeroToOne(Rng),
+    };
+}
+
+color GetRandomShadeOfGray(rng* Rng) {
+    float Shade = RngZeroToOne(Rng);
+    return (color){
+        Shade,
+        Shade,
+        Shade,
+    };
+}
+
+// Cells
+
+uint32_t CellIndex(game* Game, int X, int Y) {
+    return (uint32_t)((Y + 1) * Game->Stride + X + 1);
+}
+
+int CellX(game* Game, uint32_t Cell) {
+    return (int)(Cell % (uint32_t)Game->Stride) - 1;
+}
+
+int CellY(game* Game, uint32_t Cell) {
+    return (int)(Cell / (uint32_t)Game->Stride) - 1;
+}
+
+uint32_t GetRandomCell(game* Game) {
+    int X = (int)RngBelow(&Game->Rng, Game->XTiles);
+    int Y = (int)RngBelow(&Game->Rng, Game->YTiles);
+    return CellIndex(Game, X, Y);
+}
+
+// Occupancy
+
+int IsCellBlocked(game* Game, uint32_t Cell) {
+    return (Game->Occupied[Cell >> 6] >> (Cell & 63)) & 1;
+}
+
+void SetCell(game* Game, uint32_t Cell) {
+    Game->Occupied[Cell >> 6] |= 1ull << (Cell & 63);
+}
+
+void ClearCell(game* Game, uint32_t Cell) {
+    Game->Occupied[Cell >> 6] &= ~(1ull << (Cell & 63));
+}
+
+// Free cells
+
+void AddFreeCell(game* Game, uint32_t Cell) {
+    Game->FreeIndex[Cell] = Game->FreeCount;
+    Game->FreeCells[Game->FreeCount++] = Cell;
+}
+
+void RemoveFreeCell(game* Game, uint32_t Cell) {
+    uint32_t Index = Game->FreeIndex[Cell];
+    uint32_t Last = Game->FreeCells[--Game->FreeCount];
+    Game->FreeCells[Index] = Last;
+    Game->FreeIndex[Last] = Index;
+}
+
+void BuildFreeCells(game* Game) {
+    if(!Game->FreeCells) {
+        int Cells = (Game->XTiles + 2) * (Game->YTiles + 2);
+        Game->FreeCells = malloc((size_t)Game->XTiles * Game->YTiles * sizeof(uint32_t));
+        Game->FreeIndex = malloc((size_t)Cells * sizeof(uint32_t));
+        assert(Game->FreeCells && Game->FreeIndex);
+    }
+    Game->FreeCount = 0;
+    Game->UseFreeCells = 1;
+
+    for(int Y = 0; Y < Game->YTiles; ++Y) {
+        for(int X = 0; X < Game->XTiles; ++X) {
+            uint32_t Cell = CellIndex(Game, X, Y);
+            if(!IsCellBlocked(Game, Cell)) AddFreeCell(Game, Cell);
+        }
+    }
+}
+
+// Snake pieces go through these so the free cells follow the bitmap
+
+void OccupyCell(game* Game, uint32_t Cell) {
+    SetCell(Game, Cell);
+    if(Game->UseFreeCells) {
+        RemoveFreeCell(Game, Cell);
+    } else if(Game->BodyLength * 2 > Game->XTiles * Game->YTiles) {
+        BuildFreeCells(Game);
+    }
+}
+
+void VacateCell(game* Game, uint32_t Cell) {
+    ClearCell(Game, Cell);
+    if(Game->UseFreeCells) AddFreeCell(Game, Cell);
+}
+
+uint32_t GetRandomFreeCell(game* Game) {
+    if(Game->UseFreeCells) {
+        if(Game->FreeCount == 0) return NO_FOOD;
+        return Game->FreeCells[RngBelow(&Game->Rng, Game->FreeCount)];
+    }
+
+    for(;;) {
+        uint32_t Cell = GetRandomCell(Game);
+        if(!IsCellBlocked(Game, Cell)) return Cell;
+    }
+}
+
+void MarkDirty(game* Game, uint32_t Cell) {
+    Game->Dirty[Game->DirtyCount++ & (GAME_DIRTY - 1)] = Cell;
+}
+
+// Floor
+
+uint32_t HashCell(uint32_t Value) {
+    Value ^= Value >> 16;
+    Value *= 0x7feb352du;
+    Value ^= Value >> 15;
+    Value *= 0x846ca68bu;
+    Value ^= Value >> 16;
+    return Value;
+}
+
+// Some lighter tiles
+
+int IsLighterTile(game* Game, uint32_t Cell) {
+    return (HashCell(Cell ^ Game->FloorSeed) % 100) < 3;
+}
+
+int GetTilePalette(game* Game, uint32_t Cell) {
+    return IsLighterTile(Game, Cell) ? PALETTE_PLATFORM_LIGHTER : PALETTE_PLATFORM;
+}
+
+// Snake pieces, Index 0 is the head
+
+uint32_t GetPieceCell(game* Game, int Index) {
+    return Game->Body[(Game->BodyHead + Index) & (Game->BodyCapacity - 1)];
+}
+
+void GrowBody(game* Game) {
+    int Capacity = Game->BodyCapacity * 2;
+    uint32_t* Body = malloc(Capacity * sizeof(uint32_t));
+    assert(Body);
+    for(int Index = 0; Index < Game->BodyLength; ++Index) {
+        Body[Index] = GetPieceCell(Game, Index);
+    }
+    free(Game->Body);
+    Game->Body = Body;
+    Game->BodyCapacity = Capacity;
+    Game->BodyHead = 0;
+}
+
+void PushHead(game* Game, uint32_t Cell) {
+    if(Game->BodyLength == Game->BodyCapacity) GrowBody(Game);
+    Game->BodyHead = (Game->BodyHead - 1) & (Game->BodyCapacity - 1);
+    Game->Body[Game->BodyHead] = Cell;
+    ++Game->BodyLength;
+}
+
+// Starts a new game on the board Game already has without allocating:
+// the buffers are kept and cleared. Same seed, same game as GameInit.
+
+void GameReset(game* Game, uint64_t Seed) {
+
+    int XTiles = Game->XTiles;
+    int YTiles = Game->YTiles;
+    int Stride = Game->Stride;
+
+    *Game = (game){
+        .Seed = Seed,
+        .XTiles = XTiles,
+        .YTiles = YTiles,
+        .Running = 1,
+        .Delay = 30,
+        .DelayMin = 3,
+        .Stride = Stride,
+        .Steps = {
+            [UP] = Stride,
+            [LEFT] = -1,
+            [DOWN] = -Stride,
+            [RIGHT] = 1,
+        },
+        .LastInput = -1,
+        .Occupied = Game->Occupied,
+        .Body = Game->Body,
+        .BodyCapacity = Game->BodyCapacity,
+        .Direction = RIGHT,
+        .FreeCells = Game->FreeCells,
+        .FreeIndex = Game->FreeIndex,
+    };
+
+    int Cells = (XTiles + 2) * (YTiles + 2);
+    memset(Game->Occupied, 0, (size_t)(Cells + 63) / 64 * sizeof(uint64_t));
+
+    // Border
+
+    for(int X = 0; X < XTiles + 2; ++X) {
+        SetCell(Game, X);
+        SetCell(Game, (YTiles + 1) * Stride + X);
+    }
+    for(int Y = 0; Y < YTiles + 2; ++Y) {
+        SetCell(Game, Y * Stride);
+        SetCell(Game, Y * Stride + XTiles + 1);
+    }
+
+    RngInit(&Game->Rng, Seed, STREAM_FOOD);
+
+    // Platform
+
+    rng Floor;
+    RngInit(&Floor, Seed, STREAM_FLOOR);
+    Game->FloorSeed = (uint32_t)RngNext(&Floor);
+
+    // Snake head
+
+    uint32_t Head = CellIndex(Game, XTiles / 2, YTiles / 2);
+    PushHead(Game, Head);
+    OccupyCell(Game, Head);
+
+    // Food
+
+    Game->Food = GetRandomFreeCell(Game);
+}
+
+void GameInit(game* Game, int XTiles, int YTiles, uint64_t Seed) {
+
+    assert(XTiles > 0 && XTiles <= MAX_TILES);
+    assert(YTiles > 0 && YTiles <= MAX_TILES);
+
+    *Game = (game){
+        .XTiles = XTiles,
+        .YTiles = YTiles,
+        .Stride = XTiles + 2,
+        .BodyCapacity = 64,
+    };
+
+    int Cells = (XTiles + 2) * (YTiles + 2);
+    Game->Occupied = malloc((size_t)(Cells + 63) / 64 * sizeof(uint64_t));
+    Game->Body = malloc(Game->BodyCapacity * sizeof(uint32_t));
+    assert(Game->Occupied && Game->Body);
+
+    GameReset(Game, Seed);
+}
+
+void GameFree(game* Game) {
+    free(Game->Occupied);
+    free(Game->Body);
+    free(Game->FreeCells);
+    free(Game->FreeIndex);
+    Game->Occupied = 0;
+    Game->Body = 0;
+    Game->FreeCells = 0;
+    Game->FreeIndex = 0;
+}
+
+// The new piece appears where the tail is on the next move, so the tail
+// just stays put for one tick.
+
+void GrowSnake(game* Game) {
+    ++Game->Growing;
+    ++Game->TailLength;
+}
+
+// Advances the simulation by one tick.
+
+void GameUpdate(game* Game) {
+
+    ++Game->Tick;
+    Game->LastInput = -1;
+    Game->LastInputNanos = 0;
+
+    // Move tail, the tail cell is free for the head unless growing
+
+    uint32_t HeadCell = GetPieceCell(Game, 0);
+    uint32_t TailCell = GetPieceCell(Game, Game->BodyLength - 1);
+    int Growing = Game->Growing;
+
+    if(Growing) {
+        --Game->Growing;
+        Game->Vacated = NO_CELL;
+    } else {
+        --Game->BodyLength;
+        VacateCell(Game, TailCell);
+        Game->Vacated = TailCell;
+    }
+
+    // Head direction
+
+    if(Game->InputQueue.Length > 0) {
+        Game->LastInputNanos = Game->InputQueue.Nanos[0];
+        int Direction = InputQueuePop(&Game->InputQueue);
+        Game->LastInput = Direction;
+        if(Direction >= 0 && Direction < KEYSAMOUNT) {
+            if(Game->TailLength == 0 ||
+               !IsOppositeDirection(Game->Direction, Direction)) {
+                Game->Direction = Direction;
+            }
+        }
+    }
+
+    // Move head
+
+    uint32_t NewCell = HeadCell + Game->Steps[Game->Direction];
+
+    if(IsCellBlocked(Game, NewCell)) {
+        Game->Running = 0;
+
+        // Leave the snake as it was
+
+        if(Growing) {
+            ++Game->Growing;
+        } else {
+            ++Game->BodyLength;
+            OccupyCell(Game, TailCell);
+        }
+    } else {
+        PushHead(Game, NewCell);
+        OccupyCell(Game, NewCell);
+        MarkDirty(Game, NewCell);
+        if(!Growing) MarkDirty(Game, TailCell);
+
+        // Food collision
+
+        if(NewCell == Game->Food) {
+            if(Game->Delay > Game->DelayMin) Game->Delay -= 1;
+            GrowSnake(Game);
+            Game->Food = GetRandomFreeCell(Game);
+            if(Game->Food != NO_FOOD) MarkDirty(Game, Game->Food);
+        }
+    }
+}
+
+// Hash of everything that decides what happens next, for checking that
+// two runs ended up in the same place
+
+uint64_t HashBytes(uint64_t Hash, void* Data, size_t Size) {
+    uint8_t* Bytes = Data;
+    for(size_t Index = 0; Index < Size; ++Index) {
+        Hash = (Hash ^ Bytes[Index]) * 0x100000001b3ull;
+    }
+    return Hash;
+}
+
+uint64_t GameHash(game* Game) {
+    uint64_t Hash = 0xcbf29ce484222325ull;
+    Hash = HashBytes(Hash, &Game->Tick, sizeof(Game->Tick));
+    Hash = HashBytes(Hash, &Game->Rng, sizeof(Game->Rng));
+    Hash = HashBytes(Hash, &Game->Food, sizeof(Game->Food));
+    Hash = HashBytes(Hash, &Game->Running, sizeof(Game->Running));
+    Hash = HashBytes(Hash, &Game->TailLength, sizeof(Game->TailLength));
+    Hash = HashBytes(Hash, &Game->Growing, sizeof(Game->Growing));
+    Hash = HashBytes(Hash, &Game->Direction, sizeof(Game->Direction));
+    Hash = HashBytes(Hash, &Game->BodyLength, sizeof(Game->BodyLength));
+    for(int Index = 0; Index < Game->BodyLength; ++Index) {
+        uint32_t Cell = GetPieceCell(Game, Index);
+        Hash = HashBytes(Hash, &Cell, sizeof(Cell));
+    }
+    return Hash;
+}
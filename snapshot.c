@@ -0,0 +1,122 @@
+// Snapshots: the simulation thread publishes a copy of the game after
+// its ticks and the renderer draws from it, through a triple buffer.
+// One slot is being written, one is being read and the third holds the
+// newest published snapshot, so neither side ever waits for the other.
+// Publishing swaps the written slot with the middle one and marks it
+// fresh; the renderer takes the middle slot only when it is fresh.
+//
+// A snapshot is a game whose pointers are its own: the body is copied
+// head first (so BodyHead is 0) and there is no Occupied bitmap or free
+// list. Drawing code takes a game* and can't tell the difference, but
+// anything that needs the board has to use the real game.
+//
+// The writer stores GameHash of what it wrote, a reader that gets a
+// different hash saw a slot while it was being written.
+
+#include <stdatomic.h>
+
+#define SNAPSHOT_FRESH 4 // Flag next to the slot index in Middle
+
+typedef struct {
+    game Game;
+    uint32_t* Body;
+    int BodyCapacity;
+
+    uint64_t Sequence; // Counts publishes from 1
+    uint64_t Nanos; // When the tick ran
+    uint64_t TickNanos; // Until the next one is due
+    uint64_t Hash;
+
+    // Simulation side numbers for showing
+
+    inputMetrics Inputs; // As of this tick, the render thread presents from it
+    uint64_t SimulationBusyNanos;
+    uint64_t TickLatenessMean; // How late ticks ran after they were due
+    uint64_t TickLatenessMax;
+} snapshot;
+
+typedef struct {
+    snapshot Slots[3];
+    _Alignas(64) atomic_uint Middle;
+    _Alignas(64) int Writing; // Simulation thread only
+    uint64_t Published;
+    _Alignas(64) int Reading; // Render thread only
+} tripleBuffer;
+
+void TripleBufferInit(tripleBuffer* Buffer) {
+    memset(Buffer->Slots, 0, sizeof(Buffer->Slots));
+    Buffer->Writing = 0;
+    Buffer->Reading = 2;
+    Buffer->Published = 0;
+    atomic_init(&Buffer->Middle, 1);
+}
+
+void TripleBufferFree(tripleBuffer* Buffer) {
+    for(int Slot = 0; Slot < 3; ++Slot) {
+        free(Buffer->Slots[Slot].Body);
+        Buffer->Slots[Slot].Body = 0;
+    }
+}
+
+// Simulation side: fill the slot returned here, then publish it
+
+snapshot* TripleBufferWriteSlot(tripleBuffer* Buffer) {
+    return &Buffer->Slots[Buffer->Writing];
+}
+
+void SnapshotCopy(snapshot* Snapshot, game* Game, uint64_t Nanos, uint64_t TickNanos) {
+    if(Snapshot->BodyCapacity < Game->BodyCapacity) {
+        free(Snapshot->Body);
+        Snapshot->Body = malloc(Game->BodyCapacity * sizeof(uint32_t));
+        assert(Snapshot->Body);
+        Snapshot->BodyCapacity = Game->BodyCapacity;
+    }
+
+    // The ring is at most two runs of cells
+
+    int Length = Game->BodyLength;
+    int First = Game->BodyCapacity - Game->BodyHead;
+    if(First > Length) First = Length;
+    memcpy(Snapshot->Body, Game->Body + Game->BodyHead, First * sizeof(uint32_t));
+    memcpy(Snapshot->Body + First, Game->Body, (Length - First) * sizeof(uint32_t));
+
+    Snapshot->Game = *Game;
+    Snapshot->Game.Body = Snapshot->Body;
+    Snapshot->Game.BodyHead = 0;
+    Snapshot->Game.BodyCapacity = Snapshot->BodyCapacity;
+    Snapshot->Game.Occupied = 0;
+    Snapshot->Game.FreeCells = 0;
+    Snapshot->Game.FreeIndex = 0;
+
+    Snapshot->Nanos = Nanos;
+    Snapshot->TickNanos = TickNanos;
+    Snapshot->Hash = GameHash(&Snapshot->Game);
+}
+
+void TripleBufferPublish(tripleBuffer* Buffer) {
+    Buffer->Slots[Buffer->Writing].Sequence = ++Buffer->Published;
+    unsigned Old = atomic_exchange_explicit(&Buffer->Middle, (unsigned)Buffer->Writing | SNAPSHOT_FRESH,
+                                            memory_order_acq_rel);
+    Buffer->Writing = (int)(Old & 3);
+}
+
+// Render side: the newest snapshot, which is the one from last time if
+// nothing was published since. 0 before the first publish.
+
+snapshot* TripleBufferRead(tripleBuffer* Buffer) {
+    if(atomic_load_explicit(&Buffer->Middle, memory_order_relaxed) & SNAPSHOT_FRESH) {
+        unsigned Old = atomic_exchange_explicit(&Buffer->Middle, (unsigned)Buffer->Reading, memory_order_acq_rel);
+        Buffer->Reading = (int)(Old & 3);
+    }
+    snapshot* Snapshot = &Buffer->Slots[Buffer->Reading];
+    return Snapshot->Sequence ? Snapshot : 0;
+}
+
+// How far the renderer is between the snapshot's tick and the next one,
+// like ClockAlpha
+
+float SnapshotAlpha(snapshot* Snapshot, uint64_t Now) {
+    if(Now <= Snapshot->Nanos || !Snapshot->TickNanos) return 0.0f;
+    float Alpha = (float)(Now - Snapshot->Nanos) / (float)Snapshot->TickNanos;
+    return Alpha < 1.0f ? Alpha : 1.0f;
+}
@@ -0,0 +1,216 @@
+// Terminal renderer: draws the board in a terminal with ANSI escapes,
+// every tile two columns wide in its palette color, the top row is the
+// highest Y like in the window. The first frame draws every tile, after
+// that only tiles whose color changed: the dirty cells of the game from
+// DrawDirtyUpdate are looked at and compared against what the terminal
+// shows, everything else is left alone. A frame is one write.
+//
+// Boards bigger than the terminal are shown through a viewport that
+// follows the head. It jumps to put the head back in the middle once it
+// gets within a quarter of the edge, so most frames don't move it. A
+// frame after a jump, or after the game got more than GAME_DIRTY dirty
+// cells ahead, looks at every tile in view but still sends only the ones
+// that changed.
+//
+// Needs the game itself, a snapshot has no board to tell which tiles the
+// snake is on.
+
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#define TERM_UNKNOWN 0xff // Tile not drawn yet
+
+typedef struct {
+    int Fd;
+    int Columns; // Terminal, one row is kept for the status line
+    int Rows;
+
+    // Viewport in tiles, ViewX and ViewY is the bottom left one
+
+    int Width;
+    int Height;
+    int ViewX;
+    int ViewY;
+
+    uint8_t* Shown; // Palette index of every tile in view as the terminal has it
+    int Started;
+
+    drawDirty Dirty;
+
+    // Output of the frame being built
+
+    char* Out;
+    size_t Length;
+    size_t Capacity;
+    int Color; // Background set last, -1 for none
+    int CursorRow; // Where the terminal's cursor is, 1 based
+    int CursorColumn;
+
+    uint64_t Frames;
+    uint64_t FullFrames; // Frames that looked at every tile in view
+    uint64_t Cells; // Tiles sent
+    uint64_t Bytes;
+} term;
+
+void TermPush(term* Term, char* Data, size_t Size) {
+    if(Term->Length + Size > Term->Capacity) {
+        Term->Capacity = (Term->Length + Size) * 2;
+        Term->Out = realloc(Term->Out, Term->Capacity);
+        assert(Term->Out);
+    }
+    memcpy(Term->Out + Term->Length, Data, Size);
+    Term->Length += Size;
+}
+
+void TermPrint(term* Term, char* Format, ...) {
+    char Text[128];
+    va_list Arguments;
+    va_start(Arguments, Format);
+    int Size = vsnprintf(Text, sizeof(Text), Format, Arguments);
+    va_end(Arguments);
+    if(Size > 0) TermPush(Term, Text, (size_t)(Size < (int)sizeof(Text) ? Size : (int)sizeof(Text) - 1));
+}
+
+// Columns and Rows 0 asks the terminal, 80x24 if that doesn't work
+
+void TermInit(term* Term, int Fd, int Columns, int Rows) {
+    *Term = (term){.Fd = Fd, .Color = -1};
+
+    struct winsize Size;
+    if((!Columns || !Rows) && ioctl(Fd, TIOCGWINSZ, &Size) == 0 && Size.ws_col && Size.ws_row) {
+        if(!Columns) Columns = Size.ws_col;
+        if(!Rows) Rows = Size.ws_row;
+    }
+    Term->Columns = Columns > 1 ? Columns : 80;
+    Term->Rows = Rows > 1 ? Rows : 24;
+}
+
+void TermFree(term* Term) {
+    free(Term->Shown);
+    free(Term->Out);
+    *Term = (term){0};
+}
+
+void TermFlush(term* Term) {
+    size_t Written = 0;
+    while(Written < Term->Length) {
+        ssize_t Result = write(Term->Fd, Term->Out + Written, Term->Length - Written);
+        if(Result <= 0) break;
+        Written += (size_t)Result;
+    }
+    Term->Bytes += Term->Length;
+    Term->Length = 0;
+}
+
+// Puts the cursor back where the shell expects it
+
+void TermEnd(term* Term) {
+    TermPrint(Term, "\x1b[0m\x1b[%d;1H\x1b[?25h\n", Term->Height + 1);
+    TermFlush(Term);
+}
+
+void TermPutTile(term* Term, game* Game, int X, int Y) {
+    int Column = X - Term->ViewX;
+    int Row = Term->ViewY + Term->Height - 1 - Y;
+    if(Column < 0 || Column >= Term->Width || Row < 0 || Row >= Term->Height) return;
+
+    int Shade = DrawDirtyTilePalette(&Term->Dirty, Game, CellIndex(Game, X, Y));
+    uint8_t* Shown = &Term->Shown[Row * Term->Width + Column];
+    if(*Shown == Shade) return;
+    *Shown = (uint8_t)Shade;
+
+    int TerminalRow = Row + 1;
+    int TerminalColumn = 2 * Column + 1;
+    if(TerminalRow != Term->CursorRow || TerminalColumn != Term->CursorColumn) {
+        TermPrint(Term, "\x1b[%d;%dH", TerminalRow, TerminalColumn);
+    }
+    if(Shade != Term->Color) {
+        color Color = Palette[Shade];
+        TermPrint(Term, "\x1b[48;2;%d;%d;%dm", (int)(Color.R * 255.0f + 0.5f),
+                  (int)(Color.G * 255.0f + 0.5f), (int)(Color.B * 255.0f + 0.5f));
+        Term->Color = Shade;
+    }
+    TermPush(Term, "  ", 2);
+    Term->CursorRow = TerminalRow;
+    Term->CursorColumn = TerminalColumn + 2;
+    ++Term->Cells;
+}
+
+// Moves the viewport if the head got close to its edge, returns 1 if it
+// moved or changed size
+
+int Follow(int Head, int* View, int Size, int Board) {
+    if(Size >= Board) {
+        int Moved = *View != 0;
+        *View = 0;
+        return Moved;
+    }
+    int Margin = Size / 4;
+    if(Head >= *View + Margin && Head < *View + Size - Margin) return 0;
+
+    int Next = Head - Size / 2;
+    if(Next < 0) Next = 0;
+    if(Next > Board - Size) Next = Board - Size;
+    int Moved = Next != *View;
+    *View = Next;
+    return Moved;
+}
+
+int TermFollow(term* Term, game* Game) {
+    int Width = Term->Columns / 2 < Game->XTiles ? Term->Columns / 2 : Game->XTiles;
+    int Height = Term->Rows - 1 < Game->YTiles ? Term->Rows - 1 : Game->YTiles;
+
+    int Resized = Width != Term->Width || Height != Term->Height;
+    if(Resized) {
+        Term->Width = Width;
+        Term->Height = Height;
+        free(Term->Shown);
+        Term->Shown = malloc((size_t)Width * Height);
+        assert(Term->Shown);
+        memset(Term->Shown, TERM_UNKNOWN, (size_t)Width * Height);
+        if(Term->Frames) TermPush(Term, "\x1b[0m\x1b[2J", 8);
+        Term->Color = -1;
+        Term->CursorRow = 0;
+    }
+
+    uint32_t Head = GetPieceCell(Game, 0);
+    int Moved = Follow(CellX(Game, Head), &Term->ViewX, Width, Game->XTiles);
+    Moved |= Follow(CellY(Game, Head), &Term->ViewY, Height, Game->YTiles);
+    return Resized || Moved;
+}
+
+// Sends what changed since the last frame
+
+void TermFrame(term* Term, game* Game) {
+    if(!Term->Started) {
+        TermPush(Term, "\x1b[?25l\x1b[0m\x1b[2J", 14);
+        Term->Started = 1;
+    }
+
+    DrawDirtyUpdate(&Term->Dirty, Game);
+    int Full = TermFollow(Term, Game) || Term->Dirty.All || Term->Frames == 0;
+
+    if(Full) {
+        ++Term->FullFrames;
+        for(int Y = Term->ViewY + Term->Height - 1; Y >= Term->ViewY; --Y) {
+            for(int X = Term->ViewX; X < Term->ViewX + Term->Width; ++X) {
+                TermPutTile(Term, Game, X, Y);
+            }
+        }
+    } else {
+        for(int Index = 0; Index < Term->Dirty.Count; ++Index) {
+            uint32_t Cell = Term->Dirty.Cells[Index];
+            TermPutTile(Term, Game, CellX(Game, Cell), CellY(Game, Cell));
+        }
+    }
+
+    TermPrint(Term, "\x1b[0m\x1b[%d;1Htick %llu  length %d  view %d,%d of %dx%d%s\x1b[K",
+              Term->Height + 1, (unsigned long long)Game->Tick, Game->BodyLength,
+              Term->ViewX, Term->ViewY, Game->XTiles, Game->YTiles, Game->Running ? "" : "  dead");
+    Term->Color = -1;
+    Term->CursorRow = 0;
+
+    ++Term->Frames;
+    TermFlush(Term);
+}
@@ -0,0 +1,95 @@
+// Fixed timestep clock. The caller passes in the current time in
+// nanoseconds from whatever clock the platform has (or a fake one), the
+// clock says how many ticks are due and how far the render is between
+// the last tick and the next one.
+
+#include <stdint.h>
+
+// The window used to tick every Delay + 1 frames at 60 Hz
+
+#define FRAME_NANOS (1000000000ull / 60)
+#define MAX_CATCH_UP 8
+
+uint64_t GetTickNanos(int Delay) {
+    return (uint64_t)(Delay + 1) * FRAME_NANOS;
+}
+
+typedef struct {
+    uint64_t TickNanos;
+    uint64_t LastTime;
+    uint64_t Accumulator;
+
+    // Lateness of each tick relative to when it was due, and ticks thrown
+    // away because we fell more than MAX_CATCH_UP ticks behind.
+
+    uint64_t Ticks;
+    uint64_t Dropped;
+    uint64_t LatenessSum;
+    uint64_t LatenessMax;
+} fixedClock;
+
+void ClockInit(fixedClock* Clock, uint64_t Now, uint64_t TickNanos) {
+    *Clock = (fixedClock){
+        .TickNanos = TickNanos,
+        .LastTime = Now,
+    };
+}
+
+// Time doesn't count while paused
+
+void ClockReset(fixedClock* Clock, uint64_t Now) {
+    Clock->LastTime = Now;
+    Clock->Accumulator = 0;
+}
+
+void ClockSetTickNanos(fixedClock* Clock, uint64_t TickNanos) {
+    Clock->TickNanos = TickNanos;
+}
+
+// Returns the number of ticks to run now
+
+int ClockAdvance(fixedClock* Clock, uint64_t Now) {
+    Clock->Accumulator += Now - Clock->LastTime;
+    Clock->LastTime = Now;
+
+    int Ticks = 0;
+    while(Clock->Accumulator >= Clock->TickNanos && Ticks < MAX_CATCH_UP) {
+        Clock->Accumulator -= Clock->TickNanos;
+        ++Ticks;
+
+        // What is left over is how long ago this tick was due
+
+        ++Clock->Ticks;
+        Clock->LatenessSum += Clock->Accumulator;
+        if(Clock->Accumulator > Clock->LatenessMax) Clock->LatenessMax = Clock->Accumulator;
+    }
+
+    if(Clock->Accumulator >= Clock->TickNanos) {
+        Clock->Dropped += Clock->Accumulator / Clock->TickNanos;
+        Clock->Accumulator %= Clock->TickNanos;
+    }
+
+    return Ticks;
+}
+
+// 0 right after a tick, approaching 1 just before the next one
+
+float ClockAlpha(fixedClock* Clock) {
+    return (float)Clock->Accumulator / (float)Clock->TickNanos;
+}
+
+uint64_t ClockNextTick(fixedClock* Clock) {
+    return Clock->LastTime + (Clock->TickNanos - Clock->Accumulator);
+}
+
+// Waiting for a deadline: sleep while it is further away than the sleep
+// granularity, spin for the rest. Windows sleeps in whole timer periods,
+// 1 ms with timeBeginPeriod(1), and may wake a period late; the other
+// 2 ms are for the scheduler.
+
+#define SPIN_NANOS 3000000ull
+
+uint64_t ClockSleepNanos(uint64_t Now, uint64_t Deadline) {
+    if(Deadline <= Now + SPIN_NANOS) return 0;
+    return Deadline - Now - SPIN_NANOS;
+}
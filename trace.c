@@ -0,0 +1,202 @@
+// Tracing: zones around the hot paths, written out as Chrome trace JSON
+// that chrome://tracing and ui.perfetto.dev open. Only there when built
+// with SNAKE_TRACE defined, otherwise the zones are nothing and the
+// functions do nothing.
+//
+//   TRACE_START(Start);
+//   GameUpdate(&Game);
+//   TRACE_ZONE(TRACE_UPDATE, Start);
+//
+// A thread calls TraceThread once to get a ring of the last TRACE_EVENTS
+// zones, zones on threads without one are dropped. A zone is two reads of
+// the time stamp counter and one store into the ring, only the thread
+// that owns a ring writes it. TraceWrite can run on any thread while the
+// others keep going: it copies each ring, then throws away what may have
+// been overwritten during the copy. Time stamp counter ticks are turned
+// into nanoseconds with the rate between TraceInit and TraceWrite.
+
+#include <stdatomic.h>
+
+#define TRACE_EVENTS 65536 // Per thread, a power of two
+#define TRACE_THREADS 16
+
+enum {
+    TRACE_PUMP,
+    TRACE_UPDATE,
+    TRACE_PUBLISH,
+    TRACE_FRAME,
+    TRACE_BUILD,
+    TRACE_SUBMIT,
+    TRACE_PASS, // One per draw pass
+    TRACE_PRESENT = TRACE_PASS + DRAW_PASSES,
+    TRACE_ZONES,
+};
+
+char* TraceZoneNames[TRACE_ZONES] = {
+    [TRACE_PUMP] = "pump",
+    [TRACE_UPDATE] = "update",
+    [TRACE_PUBLISH] = "publish",
+    [TRACE_FRAME] = "frame",
+    [TRACE_BUILD] = "build",
+    [TRACE_SUBMIT] = "submit",
+    [TRACE_PASS + DRAW_FLOOR] = "floor pass",
+    [TRACE_PASS + DRAW_FILL] = "fill pass",
+    [TRACE_PASS + DRAW_BORDER] = "border pass",
+    [TRACE_PASS + DRAW_FLOOR_WIREFRAME] = "floor wireframe pass",
+    [TRACE_PASS + DRAW_WIREFRAME] = "wireframe pass",
+    [TRACE_PRESENT] = "present",
+};
+
+#ifdef SNAKE_TRACE
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL _Thread_local
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+#define TRACE_START(Start) uint64_t Start = TraceTicks()
+#define TRACE_ZONE(Zone, Start) TraceZone(Zone, Start)
+
+typedef struct {
+    uint64_t Start;
+    uint64_t End;
+    uint32_t Zone;
+} traceEvent;
+
+typedef struct {
+    _Alignas(64) atomic_uint Write; // Stored by the owner
+    char Name[32];
+    traceEvent Events[TRACE_EVENTS];
+} traceThread;
+
+typedef struct {
+    atomic_int ThreadCount;
+    traceThread* Threads[TRACE_THREADS];
+    uint64_t StartTicks;
+    uint64_t StartNanos;
+} tracer;
+
+tracer Tracer;
+TRACE_THREAD_LOCAL traceThread* TraceLocal;
+
+uint64_t TraceTicks() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec Time;
+    timespec_get(&Time, TIME_UTC);
+    return (uint64_t)Time.tv_sec * 1000000000ull + (uint64_t)Time.tv_nsec;
+#endif
+}
+
+void TraceZone(int Zone, uint64_t Start) {
+    traceThread* Thread = TraceLocal;
+    if(!Thread) return;
+    unsigned Write = atomic_load_explicit(&Thread->Write, memory_order_relaxed);
+    Thread->Events[Write & (TRACE_EVENTS - 1)] = (traceEvent){Start, TraceTicks(), (uint32_t)Zone};
+    atomic_store_explicit(&Thread->Write, Write + 1, memory_order_release);
+}
+
+// Nanos is the caller's clock, once before any zone
+
+void TraceInit(uint64_t Nanos) {
+    Tracer.StartTicks = TraceTicks();
+    Tracer.StartNanos = Nanos;
+}
+
+// Gives the calling thread a ring, Name is what the trace calls it
+
+void TraceThread(char* Name) {
+    if(TraceLocal) return;
+    int Index = atomic_fetch_add(&Tracer.ThreadCount, 1);
+    if(Index >= TRACE_THREADS) return;
+
+    traceThread* Thread = calloc(1, sizeof(traceThread));
+    assert(Thread);
+    atomic_init(&Thread->Write, 0);
+    snprintf(Thread->Name, sizeof(Thread->Name), "%s", Name);
+    Tracer.Threads[Index] = Thread;
+    TraceLocal = Thread;
+}
+
+// Writes what the rings hold, Nanos is the caller's clock now. Returns 0
+// if the file couldn't be written.
+
+int TraceWrite(char* Path, uint64_t Nanos) {
+    FILE* File = fopen(Path, "wb");
+    if(!File) return 0;
+
+    uint64_t Ticks = TraceTicks();
+    double NanosPerTick = Ticks > Tracer.StartTicks
+        ? (double)(Nanos - Tracer.StartNanos) / (double)(Ticks - Tracer.StartTicks) : 1.0;
+
+    traceEvent* Copy = malloc(TRACE_EVENTS * sizeof(traceEvent));
+    assert(Copy);
+
+    fprintf(File, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    int First = 1;
+
+    int ThreadCount = atomic_load(&Tracer.ThreadCount);
+    if(ThreadCount > TRACE_THREADS) ThreadCount = TRACE_THREADS;
+    for(int Index = 0; Index < ThreadCount; ++Index) {
+        traceThread* Thread = Tracer.Threads[Index];
+        if(!Thread) continue;
+
+        fprintf(File, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                First ? "" : ",\n", Index + 1, Thread->Name);
+        First = 0;
+
+        unsigned End = atomic_load_explicit(&Thread->Write, memory_order_acquire);
+        unsigned Begin = End > TRACE_EVENTS ? End - TRACE_EVENTS : 0;
+        for(unsigned Event = Begin; Event != End; ++Event) {
+            Copy[Event & (TRACE_EVENTS - 1)] = Thread->Events[Event & (TRACE_EVENTS - 1)];
+        }
+
+        // Whatever the owner wrote meanwhile landed on the oldest events,
+        // and it may be halfway through writing event After, whose slot
+        // is that of After - TRACE_EVENTS
+
+        unsigned After = atomic_load_explicit(&Thread->Write, memory_order_acquire);
+        if(After - Begin >= TRACE_EVENTS) Begin = After - TRACE_EVENTS + 1;
+        if(End - Begin > TRACE_EVENTS) Begin = End;
+
+        for(unsigned Event = Begin; Event != End; ++Event) {
+            traceEvent* Zone = &Copy[Event & (TRACE_EVENTS - 1)];
+            if(Zone->Zone >= TRACE_ZONES || Zone->Start < Tracer.StartTicks) continue;
+            double Start = (double)(Zone->Start - Tracer.StartTicks) * NanosPerTick / 1e3;
+            double Duration = (double)(Zone->End - Zone->Start) * NanosPerTick / 1e3;
+            fprintf(File, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    TraceZoneNames[Zone->Zone], Index + 1, Start, Duration);
+        }
+    }
+
+    fprintf(File, "\n]}\n");
+    free(Copy);
+    return fclose(File) == 0;
+}
+
+#else
+
+#define TRACE_START(Start)
+#define TRACE_ZONE(Zone, Start)
+
+void TraceInit(uint64_t Nanos) {
+    (void)Nanos;
+}
+
+void TraceThread(char* Name) {
+    (void)Name;
+}
+
+int TraceWrite(char* Path, uint64_t Nanos) {
+    (void)Path;
+    (void)Nanos;
+    return 0;
+}
+
+#endif